@@ -0,0 +1,39 @@
+#include "PerfCounters.h"
+#include <cstdlib>
+#include <new>
+
+//  Global operator new and delete that count every allocation into
+//  CounterHeapAllocations of the calling thread, so the per frame counters
+//  (and the lander_allocs benchmark) show code that allocates in a loop.
+//  Memory still comes from malloc.
+//
+#ifdef LANDER_COUNT_ALLOCS_ENABLED
+
+static void* countedAlloc(size_t size)
+{
+	PerfCounters::add(CounterHeapAllocations);
+	void *p = malloc(size > 0 ? size : 1);
+	if (p == NULL) throw std::bad_alloc();
+	return p;
+}
+
+void* operator new(size_t size) { return countedAlloc(size); }
+void* operator new[](size_t size) { return countedAlloc(size); }
+void* operator new(size_t size, const std::nothrow_t &) noexcept
+{
+	PerfCounters::add(CounterHeapAllocations);
+	return malloc(size > 0 ? size : 1);
+}
+void* operator new[](size_t size, const std::nothrow_t &) noexcept
+{
+	PerfCounters::add(CounterHeapAllocations);
+	return malloc(size > 0 ? size : 1);
+}
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+void operator delete[](void *p, size_t) noexcept { free(p); }
+void operator delete(void *p, const std::nothrow_t &) noexcept { free(p); }
+void operator delete[](void *p, const std::nothrow_t &) noexcept { free(p); }
+
+#endif
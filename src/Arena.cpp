@@ -0,0 +1,104 @@
+#include "Arena.h"
+
+Arena::Arena(size_t blockSize) : blockSize(blockSize)
+{
+}
+
+Arena::~Arena()
+{
+	for (int i = 0; i < blocks.size(); i++)
+		delete[] blocks[i].data;
+}
+
+void* Arena::allocate(size_t bytes, size_t align)
+{
+	if (!blocks.empty())
+	{
+		const Block & b = blocks[current];
+		uintptr_t start = ((uintptr_t)b.data + offset + align - 1) & ~(uintptr_t)(align - 1);
+		if (start + bytes <= (uintptr_t)b.data + b.size)
+		{
+			offset = start + bytes - (uintptr_t)b.data;
+			return (void*)start;
+		}
+	}
+	nextBlock(bytes, align);
+	return allocate(bytes, align);
+}
+
+//  move on to the block after the current one, replacing it if it is too
+//  small for this request
+//
+void Arena::nextBlock(size_t bytes, size_t align)
+{
+	size_t need = bytes + align;
+	int next = blocks.empty() ? 0 : current + 1;
+	if (next < blocks.size() && blocks[next].size < need)
+	{
+		delete[] blocks[next].data;
+		blocks.erase(blocks.begin() + next);
+	}
+	if (next >= blocks.size() || blocks[next].size < need)
+	{
+		Block b;
+		b.size = max(blockSize, need);
+		b.data = new char[b.size];
+		blocks.insert(blocks.begin() + next, b);
+	}
+	current = next;
+	offset = 0;
+}
+
+Arena::Marker Arena::mark() const
+{
+	Marker m;
+	m.block = current;
+	m.offset = offset;
+	return m;
+}
+
+void Arena::release(const Marker & m)
+{
+	current = m.block;
+	offset = m.offset;
+}
+
+//  give everything back, merging the blocks a busy pass needed into one
+//
+void Arena::reset()
+{
+	if (blocks.size() > 1)
+	{
+		size_t total = capacity();
+		for (int i = 0; i < blocks.size(); i++)
+			delete[] blocks[i].data;
+		blocks.resize(1);
+		blocks[0].size = total;
+		blocks[0].data = new char[total];
+	}
+	current = 0;
+	offset = 0;
+}
+
+size_t Arena::used() const
+{
+	if (blocks.empty()) return 0;
+	size_t n = offset;
+	for (int i = 0; i < current; i++)
+		n += blocks[i].size;
+	return n;
+}
+
+size_t Arena::capacity() const
+{
+	size_t n = 0;
+	for (int i = 0; i < blocks.size(); i++)
+		n += blocks[i].size;
+	return n;
+}
+
+Arena & Arena::frame()
+{
+	static Arena arena(256 * 1024);
+	return arena;
+}
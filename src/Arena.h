@@ -0,0 +1,79 @@
+#pragma once
+#include "ofMain.h"
+
+//  Linear (bump) allocator for short-lived buffers.  allocate() hands out
+//  the next bytes of the current block and nothing is freed on its own;
+//  reset() takes everything back at once, and release() everything since a
+//  mark(), for recursive users like the octree build.  When a block runs
+//  out another one is started, and the next reset() merges them into one
+//  block of the total size, so a loop that asks for the same amounts every
+//  time stops reaching the heap after its first pass.
+//
+//  Arena::frame() is the game's frame arena, reset by ofApp at the end of
+//  every frame: anything taken from it must not outlive the frame.  An
+//  arena is not thread safe, use one per thread or per job.
+//
+class Arena
+{
+public:
+	struct Marker
+	{
+		int block = 0;
+		size_t offset = 0;
+	};
+
+	Arena(size_t blockSize = 64 * 1024);
+	~Arena();
+	Arena(const Arena &) = delete;
+	Arena & operator=(const Arena &) = delete;
+
+	void* allocate(size_t bytes, size_t align = 16);
+	template <class T> T* allocate(size_t n) { return (T*)allocate(n * sizeof(T), alignof(T)); }
+
+	Marker mark() const;
+	void release(const Marker & m);
+	void reset();
+
+	size_t used() const;       // bytes handed out since the last reset
+	size_t capacity() const;   // bytes held in blocks
+
+	static Arena & frame();
+
+private:
+	struct Block
+	{
+		char *data;
+		size_t size;
+	};
+
+	void nextBlock(size_t bytes, size_t align);
+
+	vector<Block> blocks;
+	int current = 0;
+	size_t offset = 0;
+	size_t blockSize;
+};
+
+//  std allocator over an Arena, deallocate does nothing; the memory goes
+//  back with the arena's reset
+//
+//      ArenaVector<ofVec3f> sizes(n, ofVec3f(20), Arena::frame());
+//
+template <class T>
+struct ArenaAllocator
+{
+	typedef T value_type;
+
+	ArenaAllocator(Arena & a) : arena(&a) {}
+	template <class U> ArenaAllocator(const ArenaAllocator<U> & o) : arena(o.arena) {}
+
+	T* allocate(size_t n) { return arena->allocate<T>(n); }
+	void deallocate(T *, size_t) {}
+
+	template <class U> bool operator==(const ArenaAllocator<U> & o) const { return arena == o.arena; }
+	template <class U> bool operator!=(const ArenaAllocator<U> & o) const { return arena != o.arena; }
+
+	Arena *arena;
+};
+
+template <class T> using ArenaVector = vector<T, ArenaAllocator<T> >;
@@ -0,0 +1,220 @@
+#include "BatchSim.h"
+#include "Benchmark.h"
+#include "MeshCache.h"
+#include "Parallel.h"
+#include <array>
+#include <chrono>
+#include <iomanip>
+#include <random>
+
+static glm::vec2 parseRange(const string & s)
+{
+	vector<string> parts = ofSplitString(s, ",", true, true);
+	if (parts.size() == 1) return glm::vec2(ofToFloat(parts[0]), ofToFloat(parts[0]));
+	return glm::vec2(ofToFloat(parts[0]), ofToFloat(parts[1]));
+}
+
+int BatchSim::main(const vector<string> & args)
+{
+	if (args.size() < 2)
+	{
+		cout << "usage: --batch episodes [--controller hover|random|mixed] [--threads n] [--terrain path | --synthetic vertices]" << endl;
+		return 2;
+	}
+	BatchSim batch;
+	int numEpisodes = ofToInt(args[1]);
+	int numThreads = 0;
+	int numLevels = 13;
+	int synthetic = 0;
+	string terrainPath = "geo/Moon500.obj";
+	string sitesPath;
+	for (int i = 2; i + 1 < args.size(); i += 2)
+	{
+		if (args[i] == "--controller") batch.controllers = args[i + 1];
+		else if (args[i] == "--threads") numThreads = ofToInt(args[i + 1]);
+		else if (args[i] == "--terrain") terrainPath = args[i + 1];
+		else if (args[i] == "--synthetic") synthetic = ofToInt(args[i + 1]);
+		else if (args[i] == "--levels") numLevels = ofToInt(args[i + 1]);
+		else if (args[i] == "--gravity") batch.gravityRange = parseRange(args[i + 1]);
+		else if (args[i] == "--magnitude") batch.magnitudeRange = parseRange(args[i + 1]);
+		else if (args[i] == "--restitution") batch.restitutionRange = parseRange(args[i + 1]);
+		else if (args[i] == "--max-ticks") batch.maxTicks = ofToInt(args[i + 1]);
+		else if (args[i] == "--seed") batch.seed = ofToInt(args[i + 1]);
+		else if (args[i] == "--dt") batch.dt = ofToFloat(args[i + 1]);
+		else if (args[i] == "--collision") batch.continuous = args[i + 1] == "sweep";
+		else if (args[i] == "--sites") sitesPath = args[i + 1];
+		else
+		{
+			cout << "unknown batch option " << args[i] << endl;
+			return 2;
+		}
+	}
+
+	LandingSites sites;
+	if (!sitesPath.empty())
+	{
+		if (!sites.load(ofToDataPath(sitesPath))) return 2;
+		batch.sites = &sites;
+	}
+
+	Octree tree;
+	MeshCache terrain;
+	if (synthetic > 0)
+		tree.create(Benchmark::makeTerrain(synthetic), numLevels);
+	else if (terrain.openObj(ofToDataPath(terrainPath)))
+		tree.create(terrain.view, numLevels);
+	else
+		return 2;
+
+	if (numThreads <= 0) numThreads = Parallel::hardwareThreads();
+	chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+	batch.run(tree, numEpisodes, numThreads);
+	double seconds = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+
+	cout << numEpisodes << " episodes on " << numThreads << " threads" << endl;
+	batch.report(seconds);
+	return 0;
+}
+
+void BatchSim::run(const Octree & tree, int numEpisodes, int numThreads)
+{
+	results.assign(numEpisodes, EpisodeResult());
+	Parallel::forEach(numEpisodes, [&](int i, int thread) {
+		results[i] = runEpisode(tree, i);
+	}, numThreads, 16);
+}
+
+//  fly toward the target pad at a speed proportional to the distance, hold
+//  some height until above it, then descend slowly
+//
+static void hoverControl(const LanderSim & sim, const glm::vec3 & pad, LanderInput & input)
+{
+	const Particle & lander = sim.lander();
+	glm::vec3 to = pad - lander.position;
+	float horizontal = sqrt(to.x * to.x + to.z * to.z);
+	float wantX = max(-6.0f, min(6.0f, to.x * .5f));
+	float wantZ = max(-6.0f, min(6.0f, to.z * .5f));
+	input.right = lander.velocity.x < wantX - .2;
+	input.left = lander.velocity.x > wantX + .2;
+	input.back = lander.velocity.z < wantZ - .2;
+	input.forward = lander.velocity.z > wantZ + .2;
+
+	float height = lander.position.y - pad.y;
+	float wantVy;
+	if (horizontal > 2)
+		wantVy = height < 15 ? 1 : -1;
+	else
+		wantVy = -max(1.0f, min(4.0f, height * .25f));
+	input.thrust = lander.velocity.y < wantVy;
+}
+
+EpisodeResult BatchSim::runEpisode(const Octree & tree, int index) const
+{
+	// every episode has its own generator, so results don't depend on which
+	// thread ran them or in what order
+	//
+	mt19937 rng(seed * 1000003u + index);
+	uniform_real_distribution<float> unit(0, 1);
+	auto sample = [&](const glm::vec2 & range) { return range.x + (range.y - range.x) * unit(rng); };
+
+	LanderSim sim;
+	sim.setTerrain(&tree);
+	sim.setSites(sites);
+	sim.gravity = sample(gravityRange);
+	sim.magnitude = sample(magnitudeRange);
+	sim.restitution = sample(restitutionRange);
+	sim.continuous = continuous;
+	sim.startingPosition += glm::vec3((unit(rng) * 2 - 1) * startJitter, 0, (unit(rng) * 2 - 1) * startJitter);
+	sim.reset();
+
+	EpisodeResult result;
+	if (controllers == "random") result.controller = RandomController;
+	else if (controllers == "hover") result.controller = HoverController;
+	else result.controller = (index & 1) ? RandomController : HoverController;
+
+	glm::vec3 target = sites->pads[rng() % sites->numPads()].position;
+
+	LanderInput input;
+	int tick = 0;
+	for (; tick < maxTicks && !sim.bEnded; tick++)
+	{
+		if (result.controller == HoverController)
+			hoverControl(sim, target, input);
+		else if (tick % 15 == 0)
+		{
+			input.thrust = unit(rng) < .6;
+			input.forward = unit(rng) < .15;
+			input.left = unit(rng) < .15;
+			input.back = unit(rng) < .15;
+			input.right = unit(rng) < .15;
+		}
+		sim.step(input, dt);
+	}
+
+	result.status = sim.status;
+	for (int p = 0; p < sim.padFeet.size(); p++)
+	{
+		if (sim.padFeet[p] > result.feet)
+		{
+			result.pad = p;
+			result.feet = sim.padFeet[p];
+		}
+	}
+	result.bounces = sim.bounces;
+	result.ticks = tick;
+	return result;
+}
+
+void BatchSim::report(double seconds) const
+{
+	int64_t ticks = 0;
+	int landed = 0, crashed = 0, timedOut = 0, bounced = 0;
+	vector<array<int, 5> > feet(sites->numPads(), array<int, 5>());
+	int byController[2][3] = {};
+	for (int i = 0; i < results.size(); i++)
+	{
+		const EpisodeResult & r = results[i];
+		ticks += r.ticks;
+		if (r.bounces > 0) bounced++;
+		byController[r.controller][r.status]++;
+		if (r.status == LanderLanded)
+		{
+			landed++;
+			if (r.pad >= 0) feet[r.pad][min(r.feet, 4)]++;
+		}
+		else if (r.status == LanderCrashed) crashed++;
+		else timedOut++;
+	}
+
+	double n = max((double)results.size(), 1.0);
+	cout << fixed << setprecision(1);
+	cout << "time " << seconds * 1000 << " ms, " << results.size() / seconds << " episodes/sec, "
+		<< ticks / seconds << " ticks/sec" << endl;
+	cout << "landed    " << setw(8) << landed << setw(8) << 100 * landed / n << "%" << endl;
+	cout << "crashed   " << setw(8) << crashed << setw(8) << 100 * crashed / n << "%" << endl;
+	cout << "timed out " << setw(8) << timedOut << setw(8) << 100 * timedOut / n << "%" << endl;
+	cout << "bounced   " << setw(8) << bounced << setw(8) << 100 * bounced / n << "%  (at least once)" << endl;
+
+	cout << "landed feet per pad   1 foot  2 feet  3 feet  4 feet" << endl;
+	for (int p = 0; p < feet.size(); p++)
+	{
+		// with many pads only the ones that were landed on
+		//
+		if (feet.size() > 3 && feet[p][1] + feet[p][2] + feet[p][3] + feet[p][4] == 0) continue;
+		cout << "  " << left << setw(18) << sites->pads[p].name << right;
+		for (int f = 1; f <= 4; f++)
+			cout << setw(8) << feet[p][f];
+		cout << endl;
+	}
+
+	const char* controllerNames[2] = { "hover", "random" };
+	for (int c = 0; c < 2; c++)
+	{
+		int total = byController[c][0] + byController[c][1] + byController[c][2];
+		if (total == 0) continue;
+		cout << controllerNames[c] << " controller: " << total << " episodes, landed " << 100.0 * byController[c][LanderLanded] / total
+			<< "%, crashed " << 100.0 * byController[c][LanderCrashed] / total << "%, timed out "
+			<< 100.0 * byController[c][LanderFlying] / total << "%" << endl;
+	}
+	cout << defaultfloat;
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include "ofMain.h"
+#include "LanderSim.h"
+
+//  Monte Carlo batch of independent lander episodes run in parallel on all
+//  cores against one shared, read-only Octree.  Each episode samples its
+//  gravity, thrust magnitude, restitution and start position from the given
+//  ranges and is flown by a scripted or random controller.  Started from
+//  main() with
+//
+//      --batch 10000 [--controller hover|random|mixed] [--threads n]
+//                    [--terrain geo/Moon500.obj | --synthetic 250000] [--levels 13]
+//                    [--gravity 1,5] [--magnitude 2,20] [--restitution .1,1]
+//                    [--max-ticks 3600] [--seed 1] [--dt 0.0167]
+//                    [--collision point|sweep] [--sites landing_sites.txt]
+//
+typedef enum { HoverController, RandomController } ControllerType;
+
+struct EpisodeResult
+{
+	LanderStatus status = LanderFlying;  // flying = timed out
+	int pad = -1;           // pad with the most feet on it, if landed
+	int feet = 0;
+	int bounces = 0;
+	int ticks = 0;
+	ControllerType controller = HoverController;
+};
+
+class BatchSim
+{
+public:
+	static int main(const vector<string> & args);
+
+	void run(const Octree & tree, int numEpisodes, int numThreads);
+	EpisodeResult runEpisode(const Octree & tree, int index) const;
+	void report(double seconds) const;
+
+	string controllers = "mixed";
+	unsigned int seed = 1;
+	int maxTicks = 3600;
+	float dt = 1.0 / 60;
+	bool continuous = false;     // --collision sweep
+	const LandingSites *sites = &LandingSites::defaults();
+	glm::vec2 gravityRange = glm::vec2(1, 5);
+	glm::vec2 magnitudeRange = glm::vec2(2, 20);
+	glm::vec2 restitutionRange = glm::vec2(.1, 1);
+	float startJitter = 30;
+
+	vector<EpisodeResult> results;
+};
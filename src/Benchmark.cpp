@@ -0,0 +1,1668 @@
+#include "Benchmark.h"
+#include "Arena.h"
+#include "CompactOctree.h"
+#include "GridForce.h"
+#include "LanderBatch.h"
+#include "LandingSites.h"
+#include "MeshWeld.h"
+#include "ObjLoader.h"
+#include "OctreeBuilder.h"
+#include "Parallel.h"
+#include "ParticleEmitter.h"
+#include "ParticleWorld.h"
+#include "PerfCounters.h"
+#include "RayPackets.h"
+#include "SimSnapshot.h"
+#include "SpatialTree.h"
+#include <chrono>
+#include <iomanip>
+#include <random>
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+// results the optimizer can't throw away
+//
+static volatile int64_t benchSink = 0;
+
+static double secondsSince(chrono::steady_clock::time_point t0)
+{
+	return chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+}
+
+//  CPU time of the calling thread (microseconds), which leaves out the
+//  time the OS spends running something else in the middle of a call.
+//  Windows only counts it in scheduler ticks, so there it is wall time.
+//
+static double threadMicros()
+{
+#ifdef _WIN32
+	return chrono::duration<double, micro>(chrono::steady_clock::now().time_since_epoch()).count();
+#else
+	timespec t;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t);
+	return t.tv_sec * 1e6 + t.tv_nsec / 1e3;
+#endif
+}
+
+static vector<int> parseSizes(const string & s)
+{
+	vector<int> sizes;
+	vector<string> parts = ofSplitString(s, ",", true, true);
+	for (int i = 0; i < parts.size(); i++)
+		sizes.push_back(ofToInt(parts[i]));
+	return sizes;
+}
+
+int Benchmark::main(const vector<string> & args)
+{
+	if (args.size() > 0 && args[0] == "--bench-compare")
+	{
+		if (args.size() < 3)
+		{
+			cout << "usage: --bench-compare base.json new.json [--threshold 0.1]" << endl;
+			return 2;
+		}
+		double threshold = 0.1;
+		for (int i = 3; i + 1 < args.size(); i++)
+			if (args[i] == "--threshold") threshold = ofToFloat(args[i + 1]);
+		return compare(args[1], args[2], threshold);
+	}
+
+	Benchmark bench;
+	string out = "bench.json";
+	for (int i = 1; i + 1 < args.size(); i += 2)
+	{
+		if (args[i] == "--out") out = args[i + 1];
+		else if (args[i] == "--sizes") bench.sizes = parseSizes(args[i + 1]);
+		else if (args[i] == "--levels") bench.numLevels = ofToInt(args[i + 1]);
+		else if (args[i] == "--filter") bench.filter = args[i + 1];
+		else if (args[i] == "--moon") bench.moonPath = args[i + 1];
+		else
+		{
+			cout << "unknown benchmark option " << args[i] << endl;
+			return 2;
+		}
+	}
+	bench.run();
+	return bench.write(out) && !bench.failed ? 0 : 1;
+}
+
+//  height-map terrain with about numVertices vertices on a square grid,
+//  rolling hills plus some seeded noise, roughly the extent of Moon500
+//
+ofMesh Benchmark::makeTerrain(int numVertices, unsigned int seed)
+{
+	int side = max(2, (int)ceil(sqrt((double)numVertices)));
+	float extent = 400;
+	float step = extent / (side - 1);
+	mt19937 rng(seed);
+	uniform_real_distribution<float> noise(-.5, .5);
+
+	ofMesh mesh;
+	vector<float> height(side * side);
+	for (int z = 0; z < side; z++)
+	{
+		for (int x = 0; x < side; x++)
+		{
+			float fx = x * step - extent / 2;
+			float fz = z * step - extent / 2;
+			height[z * side + x] = 12 * sin(fx * .03) * cos(fz * .025) + 4 * sin(fx * .11 + fz * .07) + noise(rng);
+		}
+	}
+	mesh.getVertices().reserve(side * side);
+	mesh.getNormals().reserve(side * side);
+	for (int z = 0; z < side; z++)
+	{
+		for (int x = 0; x < side; x++)
+		{
+			float hl = height[z * side + max(x - 1, 0)];
+			float hr = height[z * side + min(x + 1, side - 1)];
+			float hd = height[max(z - 1, 0) * side + x];
+			float hu = height[min(z + 1, side - 1) * side + x];
+			mesh.addVertex(glm::vec3(x * step - extent / 2, height[z * side + x], z * step - extent / 2));
+			mesh.addNormal(glm::normalize(glm::vec3(hl - hr, 2 * step, hd - hu)));
+		}
+	}
+	mesh.getIndices().reserve((side - 1) * (side - 1) * 6);
+	for (int z = 0; z + 1 < side; z++)
+	{
+		for (int x = 0; x + 1 < side; x++)
+		{
+			int i = z * side + x;
+			mesh.addIndex(i);
+			mesh.addIndex(i + side);
+			mesh.addIndex(i + 1);
+			mesh.addIndex(i + 1);
+			mesh.addIndex(i + side);
+			mesh.addIndex(i + side + 1);
+		}
+	}
+	return mesh;
+}
+
+int Benchmark::countNodes(const TreeNode & node)
+{
+	int n = 1;
+	for (int i = 0; i < node.children.size(); i++)
+		n += countNodes(node.children[i]);
+	return n;
+}
+
+//  heap used by the nodes and their point lists
+//
+size_t Benchmark::treeBytes(const TreeNode & node)
+{
+	size_t bytes = sizeof(TreeNode) + node.points.capacity() * sizeof(int);
+	for (int i = 0; i < node.children.size(); i++)
+		bytes += treeBytes(node.children[i]);
+	return bytes;
+}
+
+BenchResult Benchmark::measure(const string & name, const string & params, function<void()> op,
+	int64_t opsPerCall, double minSeconds, int64_t maxCalls)
+{
+	BenchResult r;
+	r.name = name;
+	r.params = params;
+
+	int64_t calls = 0;
+	double elapsed = 0;
+	chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+	do
+	{
+		op();
+		calls++;
+		elapsed = secondsSince(t0);
+	} while (elapsed < minSeconds && calls < maxCalls);
+
+	r.iterations = calls * opsPerCall;
+	r.nsPerOp = elapsed * 1e9 / r.iterations;
+	return r;
+}
+
+void Benchmark::add(const BenchResult & r)
+{
+	results.push_back(r);
+	cout << left << setw(24) << r.name << setw(48) << r.params << right << setw(14) << fixed << setprecision(1) << r.nsPerOp << " ns/op";
+	for (int i = 0; i < r.extra.size(); i++)
+		cout << "  " << r.extra[i].first << "=" << r.extra[i].second;
+	cout << defaultfloat << endl;
+}
+
+bool Benchmark::selected(const string & name) const
+{
+	return filter.empty() || name.find(filter) != string::npos;
+}
+
+void Benchmark::run()
+{
+	for (int i = 0; i < sizes.size(); i++)
+	{
+		ofMesh mesh = makeTerrain(sizes[i]);
+		runTerrain("synthetic", mesh);
+	}
+
+	string moon = ofToDataPath(moonPath);
+	if (ofFile::doesFileExist(moon))
+	{
+		ofMesh mesh;
+		if (ObjLoader::load(moon, mesh))
+		{
+			runTerrain("moon500", mesh);
+			runWeld("moon500", mesh);
+		}
+	}
+	else cout << "skipping Moon500 fixture, " << moon << " not found" << endl;
+
+	runParticles();
+	runParticleSort();
+	runParticleWorld();
+	runForceGrid();
+	runEmitter();
+	runLanders();
+	runSweep();
+	runCursor();
+	runRayPackets();
+	runAllocs();
+	runSnapshot();
+	runLandingSites();
+}
+
+//  octree build, ray and point queries over one terrain mesh
+//
+void Benchmark::runTerrain(const string & label, const ofMesh & mesh)
+{
+	string params = label + " vertices=" + to_string(mesh.getNumVertices()) + " levels=" + to_string(numLevels);
+
+	Octree tree;
+	bool built = false;
+	if (selected("octree_build"))
+	{
+		BenchResult r = measure("octree_build", params, [&]() {
+			tree = Octree();
+			tree.create(mesh, numLevels);
+		}, 1, 1.0, 5);
+		r.extra.push_back(make_pair("nodes", (double)countNodes(tree.root)));
+		add(r);
+		built = true;
+	}
+	runUpdate(params, mesh);
+	runSlicedBuild(params, mesh);
+	bool compact = selected("compact_build") || selected("compact_ray_down") || selected("compact_point_surface");
+	bool spatial = selected("spatial_build") || selected("spatial_point") || selected("spatial_nearest") ||
+		selected("spatial_height");
+	if (!selected("octree_ray_down") && !selected("octree_ray_random") &&
+		!selected("octree_point_surface") && !selected("octree_point_random") && !compact && !spatial) return;
+	if (!built) tree.create(mesh, numLevels);
+
+	// query sets, seeded so every run asks the same questions
+	//
+	const int numQueries = 10000;
+	mt19937 rng(7);
+	Box bounds = tree.root.box;
+	uniform_real_distribution<float> ux(bounds.min().x, bounds.max().x);
+	uniform_real_distribution<float> uy(bounds.min().y, bounds.max().y);
+	uniform_real_distribution<float> uz(bounds.min().z, bounds.max().z);
+	uniform_real_distribution<float> unit(-1, 1);
+	uniform_int_distribution<int> uv(0, (int)mesh.getNumVertices() - 1);
+
+	vector<glm::vec3> origins(numQueries), dirs(numQueries), surface(numQueries), inBox(numQueries);
+	for (int i = 0; i < numQueries; i++)
+	{
+		origins[i] = glm::vec3(ux(rng), bounds.max().y + 10, uz(rng));
+		dirs[i] = glm::normalize(glm::vec3(unit(rng) * .5, -1, unit(rng) * .5));
+		surface[i] = mesh.getVertex(uv(rng)) + glm::vec3(unit(rng), unit(rng), unit(rng)) * .05f;
+		inBox[i] = glm::vec3(ux(rng), uy(rng), uz(rng));
+	}
+
+	if (selected("octree_ray_down"))
+	{
+		add(measure("octree_ray_down", params, [&]() {
+			for (int i = 0; i < numQueries; i++)
+			{
+				const TreeNode *node = NULL;
+				benchSink += tree.intersect(origins[i], glm::vec3(0, -1, 0), tree.root, node);
+			}
+		}, numQueries));
+	}
+	if (selected("octree_ray_random"))
+	{
+		add(measure("octree_ray_random", params, [&]() {
+			for (int i = 0; i < numQueries; i++)
+			{
+				const TreeNode *node = NULL;
+				benchSink += tree.intersect(origins[i], dirs[i], tree.root, node);
+			}
+		}, numQueries));
+	}
+	if (selected("octree_point_surface"))
+	{
+		add(measure("octree_point_surface", params, [&]() {
+			for (int i = 0; i < numQueries; i++)
+			{
+				glm::vec3 norm = glm::vec3(10000, 10000, 10000);
+				benchSink += tree.intersect(surface[i], tree.root, &norm);
+			}
+		}, numQueries));
+	}
+	if (selected("octree_point_random"))
+	{
+		add(measure("octree_point_random", params, [&]() {
+			for (int i = 0; i < numQueries; i++)
+			{
+				glm::vec3 norm = glm::vec3(10000, 10000, 10000);
+				benchSink += tree.intersect(inBox[i], tree.root, &norm);
+			}
+		}, numQueries));
+	}
+	if (compact) runCompact(params, mesh, tree, origins, surface);
+	if (spatial) runSpatial(params, mesh, tree, surface, inBox);
+}
+
+//  The SpatialTree instances against the Octree: the octree build and
+//  point query (spatial_build, spatial_point, the same work as octree_build
+//  and octree_point_surface), the exact nearest vertex, and the ground
+//  below a point from the vertices of the xz quadtree's leaf against
+//  Octree::heightBelow.  The nearest vertex in 3D and in xz is checked
+//  against a linear scan.
+//
+void Benchmark::runSpatial(const string & params, const ofMesh & mesh, const Octree & tree,
+	const vector<glm::vec3> & surface, const vector<glm::vec3> & inBox)
+{
+	int numQueries = (int)surface.size();
+	int n = (int)mesh.getNumVertices();
+	const glm::vec3 *v = &mesh.getVertices()[0];
+
+	TerrainOctree octree;
+	if (selected("spatial_build"))
+	{
+		BenchResult build = measure("spatial_build", params, [&]() {
+			octree.build(VertexPoints(v, n));
+		}, 1, 1.0, 5);
+		build.extra.push_back(make_pair("nodes", (double)octree.nodes.size()));
+		build.extra.push_back(make_pair("bytes_per_vertex", (double)octree.bytes() / n));
+		add(build);
+	}
+	else octree.build(VertexPoints(v, n));
+
+	// same leaf search as Octree::intersect(point), matching answers have
+	// the same distance to the nearest vertex of the leaf (Octree returns
+	// it as the length of a scaled normal, so only to rounding)
+	//
+	if (selected("spatial_point"))
+	{
+		BenchResult point = measure("spatial_point", params, [&]() {
+			for (int i = 0; i < numQueries; i++)
+				benchSink += octree.nearestInLeaf(&surface[i].x);
+		}, numQueries);
+		int same = 0;
+		for (int i = 0; i < numQueries; i++)
+		{
+			glm::vec3 norm = glm::vec3(10000, 10000, 10000);
+			bool hit = tree.intersect(surface[i], tree.root, &norm);
+			int nearest = octree.nearestInLeaf(&surface[i].x);
+			if (hit != (nearest >= 0)) continue;
+			if (!hit || fabs(glm::length(norm) - glm::length(surface[i] - v[nearest])) < 1e-4f) same++;
+		}
+		point.extra.push_back(make_pair("matches_octree", (double)same / numQueries));
+		add(point);
+	}
+
+	if (selected("spatial_nearest"))
+	{
+		add(measure("spatial_nearest", params, [&]() {
+			for (int i = 0; i < numQueries; i++)
+				benchSink += octree.nearest(&surface[i].x);
+		}, numQueries));
+	}
+
+	TerrainQuadtree quadtree;
+	quadtree.build(XZPoints(v, n));
+	if (selected("spatial_height"))
+	{
+		BenchResult height = measure("spatial_height", params, [&]() {
+			for (int i = 0; i < numQueries; i++)
+			{
+				glm::vec2 p(inBox[i].x, inBox[i].z);
+				int nearest = quadtree.nearestInLeaf(&p.x);
+				benchSink += nearest >= 0 ? (int64_t)(inBox[i].y - v[nearest].y) : 0;
+			}
+		}, numQueries);
+		BenchResult below = measure("spatial_height", params + " tree=octree", [&]() {
+			for (int i = 0; i < numQueries; i++)
+				benchSink += (int64_t)tree.heightBelow(inBox[i]);
+		}, numQueries);
+		height.params += " tree=quadtree";
+		height.extra.push_back(make_pair("quadtree_bytes_per_vertex", (double)quadtree.bytes() / n));
+		add(height);
+		add(below);
+	}
+
+	// linear scans, fewer of them on the big meshes
+	//
+	int checks = max(1, min(numQueries, 200000000 / max(n, 1)));
+	bool exact = true;
+	for (int i = 0; i < checks && exact; i++)
+	{
+		const glm::vec3 & p = i % 2 ? inBox[i] : surface[i];
+		int best3 = -1, best2 = -1;
+		float d3 = numeric_limits<float>::max(), d2 = d3;
+		for (int k = 0; k < n; k++)
+		{
+			glm::vec3 d = v[k] - p;
+			float dd3 = d.x * d.x + d.y * d.y + d.z * d.z;
+			float dd2 = d.x * d.x + d.z * d.z;
+			if (dd3 < d3) { d3 = dd3; best3 = k; }
+			if (dd2 < d2) { d2 = dd2; best2 = k; }
+		}
+		glm::vec2 xz(p.x, p.z);
+		exact = octree.nearest(&p.x) == best3 && quadtree.nearest(&xz.x) == best2;
+	}
+	if (!exact)
+	{
+		cout << "spatial_nearest: the nearest vertex differs from a linear scan" << endl;
+		failed = true;
+	}
+}
+
+//  CompactOctree against the Octree it encodes: memory per vertex, the ray
+//  and point queries, and whether every query gives the same answer
+//
+void Benchmark::runCompact(const string & params, const ofMesh & mesh, const Octree & tree,
+	const vector<glm::vec3> & origins, const vector<glm::vec3> & surface)
+{
+	int numQueries = (int)origins.size();
+	CompactOctree compact;
+	BenchResult build;
+	if (selected("compact_build"))
+	{
+		build = measure("compact_build", params, [&]() {
+			compact.create(mesh, numLevels);
+		}, 1, 1.0, 5);
+	}
+	else compact.create(mesh, numLevels);
+
+	bool same = true;
+	for (int i = 0; i < numQueries; i++)
+	{
+		TreeNode node;
+		node.box = Box(glm::vec3(-1000, -1000, -1000), glm::vec3(-1000, -1000, -1000));
+		Box leaf = node.box;
+		bool hit = tree.intersect(origins[i], glm::vec3(0, -1, 0), tree.root, &node);
+		same = same && hit == compact.intersect(origins[i], glm::vec3(0, -1, 0), leaf) &&
+			node.box.min() == leaf.min() && node.box.max() == leaf.max();
+
+		glm::vec3 norm = glm::vec3(10000, 10000, 10000), compactNorm = norm;
+		hit = tree.intersect(surface[i], tree.root, &norm);
+		same = same && hit == compact.intersect(surface[i], &compactNorm) && norm == compactNorm;
+	}
+	if (!same)
+	{
+		cout << "compact_build: queries differ from the Octree" << endl;
+		failed = true;
+	}
+
+	double n = (double)mesh.getNumVertices();
+	build.extra.push_back(make_pair("bytes_per_vertex", compact.bytes() / n));
+	build.extra.push_back(make_pair("octree_bytes_per_vertex", treeBytes(tree.root) / n));
+	build.extra.push_back(make_pair("matches_octree", same ? 1.0 : 0.0));
+	if (selected("compact_build")) add(build);
+
+	if (selected("compact_ray_down"))
+	{
+		add(measure("compact_ray_down", params, [&]() {
+			for (int i = 0; i < numQueries; i++)
+			{
+				Box leaf(glm::vec3(-1000, -1000, -1000), glm::vec3(-1000, -1000, -1000));
+				benchSink += compact.intersect(origins[i], glm::vec3(0, -1, 0), leaf);
+			}
+		}, numQueries));
+	}
+	if (selected("compact_point_surface"))
+	{
+		add(measure("compact_point_surface", params, [&]() {
+			for (int i = 0; i < numQueries; i++)
+			{
+				glm::vec3 norm = glm::vec3(10000, 10000, 10000);
+				benchSink += compact.intersect(surface[i], &norm);
+			}
+		}, numQueries));
+	}
+}
+
+//  dig a crater with Octree::moveVertices and fill it back in, per moved
+//  vertex, then check the dug tree against a fresh build over the same root
+//  box
+//
+void Benchmark::runUpdate(const string & params, const ofMesh & mesh)
+{
+	if (!selected("octree_update")) return;
+
+	Octree tree;
+	tree.create(mesh, numLevels);
+	Box bounds = tree.root.box;
+	glm::vec3 center = bounds.center();
+	float radius = 8;
+	float depth = 3;
+
+	vector<int> indices, crater;
+	tree.pointsInBox(Box(center - glm::vec3(radius, 1e6, radius), center + glm::vec3(radius, 1e6, radius)), indices);
+	vector<glm::vec3> dug, original;
+	for (int k = 0; k < indices.size(); k++)
+	{
+		glm::vec3 v = tree.vertex(indices[k]);
+		float d2 = (v.x - center.x) * (v.x - center.x) + (v.z - center.z) * (v.z - center.z);
+		if (d2 >= radius * radius) continue;
+		crater.push_back(indices[k]);
+		original.push_back(v);
+		v.y = max(v.y - depth * (1 - d2 / (radius * radius)), bounds.min().y);
+		dug.push_back(v);
+	}
+	if (crater.empty()) return;
+
+	BenchResult r = measure("octree_update", params + " moved=" + to_string(crater.size()), [&]() {
+		tree.moveVertices(crater, dug);
+		tree.moveVertices(crater, original);
+	}, 2 * (int64_t)crater.size());
+
+	tree.moveVertices(crater, dug);
+	MeshView view;
+	view.vertices = tree.mesh.getVertices().data();
+	view.numVertices = tree.numVertices;
+	view.hasBounds = true;
+	view.bounds = tree.root.box;
+	Octree fresh;
+	fresh.create(view, numLevels);
+	bool same = Octree::sameTree(tree.root, fresh.root);
+	if (!same)
+	{
+		cout << "octree_update: updated tree doesn't match a fresh build" << endl;
+		failed = true;
+	}
+	r.extra.push_back(make_pair("matches_fresh_build", same ? 1.0 : 0.0));
+	add(r);
+}
+
+//  the same build spread over OctreeBuilder::step calls, how many calls it
+//  takes and how far the longest one goes over its budget, on the clock
+//  (max_call_us) and in time spent on the thread (max_thread_us), which
+//  fails the run if slices overrun it.  The swap that ends each build is
+//  one of those slices; swap_us is its longest and inline_free_us what
+//  freeing the replaced tree in the frame instead would have cost.
+//
+void Benchmark::runSlicedBuild(const string & params, const ofMesh & mesh)
+{
+	if (!selected("octree_sliced_build")) return;
+
+	Octree full;
+	full.create(mesh, numLevels);
+	// thread time leaves out the OS running other work in the middle of a
+	// slice, but interrupts are still charged to it, now and then a
+	// millisecond or more on a busy machine, sometimes twice in a row.  A
+	// build fails when more than two slices, plus one in a thousand, go
+	// that far over their budget.
+	//
+	const double slack = 1000;
+	int budgets[] = { 500, 2000 };
+	for (int budget : budgets)
+	{
+		OctreeBuilder builder;
+		unique_ptr<Octree> tree;
+		double longestCall = 0, longestThread = 0, longestSwap = 0;
+		int slices = 0, overruns = 0;
+		auto timeSlice = [&](double t0) {
+			double t = threadMicros() - t0;
+			longestThread = max(longestThread, t);
+			slices++;
+			if (t > budget + slack) overruns++;
+		};
+		BenchResult r = measure("octree_sliced_build", params + " budget_us=" + to_string(budget), [&]() {
+			builder.start(mesh, numLevels);
+			for (;;)
+			{
+				double t0 = threadMicros();
+				bool done = builder.step(budget);
+				timeSlice(t0);
+				if (done) break;
+			}
+
+			// the swap is the build's last frame, it frees the previous
+			// repetition's tree
+			//
+			chrono::steady_clock::time_point s0 = chrono::steady_clock::now();
+			double t0 = threadMicros();
+			builder.swap(tree);
+			timeSlice(t0);
+			longestSwap = max(longestSwap, secondsSince(s0) * 1e6);
+			longestCall = max(longestCall, builder.longestCallMicros);
+		}, 1, 1.0, 5);
+		bool same = tree && Octree::sameTree(tree->root, full.root);
+
+		// what the swap would cost if the old tree were freed in the frame
+		//
+		chrono::steady_clock::time_point f0 = chrono::steady_clock::now();
+		tree.reset();
+		double inlineFree = secondsSince(f0) * 1e6;
+		if (!same)
+		{
+			cout << "octree_sliced_build: sliced tree doesn't match a full build" << endl;
+			failed = true;
+		}
+		if (overruns > 2 + slices / 1000)
+		{
+			cout << "octree_sliced_build: " << overruns << " of " << slices << " slices ran over " << budget << " us by more than "
+				<< (int)slack << " us, the longest for " << (int)longestThread << " us" << endl;
+			failed = true;
+		}
+		r.extra.push_back(make_pair("calls", (double)builder.calls));
+		r.extra.push_back(make_pair("max_call_us", longestCall));
+		r.extra.push_back(make_pair("max_thread_us", longestThread));
+		r.extra.push_back(make_pair("overruns", (double)overruns));
+		r.extra.push_back(make_pair("swap_us", longestSwap));
+		r.extra.push_back(make_pair("inline_free_us", inlineFree));
+		r.extra.push_back(make_pair("matches_full_build", same ? 1.0 : 0.0));
+		add(r);
+	}
+}
+
+//  weld the face corners of a mesh and run the terrain cases again on the
+//  result (runTerrain picks the ones the filter names), mesh_weld reports
+//  what it saved
+//
+void Benchmark::runWeld(const string & label, const ofMesh & mesh)
+{
+	ofMesh welded;
+	vector<int> remap;
+	if (selected("mesh_weld"))
+	{
+		BenchResult r = measure("mesh_weld", label + " vertices=" + to_string(mesh.getNumVertices()), [&]() {
+			MeshWeld::weld(mesh, MeshWeld::defaultTolerance(), welded, remap);
+		}, 1, 1.0, 5);
+
+		Octree before, after;
+		before.create(mesh, numLevels);
+		after.create(welded, numLevels);
+		size_t bytesBefore = treeBytes(before.root) + mesh.getNumVertices() * 2 * sizeof(glm::vec3);
+		size_t bytesAfter = treeBytes(after.root) + welded.getNumVertices() * 2 * sizeof(glm::vec3);
+		r.extra.push_back(make_pair("welded_vertices", (double)welded.getNumVertices()));
+		r.extra.push_back(make_pair("tree_mb_before", bytesBefore / 1048576.0));
+		r.extra.push_back(make_pair("tree_mb_after", bytesAfter / 1048576.0));
+		add(r);
+	}
+	else MeshWeld::weld(mesh, MeshWeld::defaultTolerance(), welded, remap);
+
+	runTerrain(label + "-welded", welded);
+}
+
+//  ParticleSystem::update at several particle counts and force sets
+//
+void Benchmark::runParticles()
+{
+	if (!selected("particles_update")) return;
+
+	int counts[] = { 1000, 10000, 100000 };
+	const char* forceSets[] = { "gravity", "gravity+turbulence", "gravity+turbulence+cyclic" };
+	for (int c = 0; c < 3; c++)
+	{
+		for (int f = 0; f < 3; f++)
+		{
+			GravityForce gravity(glm::vec3(0, -2.5, 0));
+			TurbulenceForce turbulence(glm::vec3(-90, -90, -90), glm::vec3(90, 90, 90));
+			CyclicForce cyclic(2);
+
+			ParticleSystem sys;
+			sys.addForce(&gravity);
+			if (f >= 1) sys.addForce(&turbulence);
+			if (f >= 2) sys.addForce(&cyclic);
+			for (int i = 0; i < counts[c]; i++)
+			{
+				Particle p;
+				p.lifespan = 1e9;
+				p.position = glm::vec3(ofRandom(-50, 50), ofRandom(0, 50), ofRandom(-50, 50));
+				sys.add(p);
+			}
+
+			string params = "particles=" + to_string(counts[c]) + " forces=" + forceSets[f];
+			BenchResult r = measure("particles_update", params, [&]() {
+				sys.update(1.0 / 60);
+			}, counts[c]);
+			add(r);
+		}
+	}
+}
+
+//  many small systems updated one by one and as views of one ParticleWorld,
+//  with the same particles and deterministic forces, so both must end in
+//  the same place
+//
+void Benchmark::runParticleWorld()
+{
+	if (!selected("particles_world")) return;
+
+	int shapes[][2] = { { 1000, 100 }, { 100, 1000 }, { 10, 10000 } };
+	for (int c = 0; c < 3; c++)
+	{
+		int numSystems = shapes[c][0], perSystem = shapes[c][1];
+		vector<unique_ptr<GravityForce> > gravity;
+		vector<unique_ptr<CyclicForce> > cyclic;
+		vector<ParticleSystem> separate(numSystems);
+		ParticleWorld world;
+		mt19937 rng(23);
+		uniform_real_distribution<float> unit(-50, 50);
+		for (int s = 0; s < numSystems; s++)
+		{
+			gravity.push_back(unique_ptr<GravityForce>(new GravityForce(glm::vec3(0, -2.5 - s % 7, 0))));
+			cyclic.push_back(unique_ptr<CyclicForce>(new CyclicForce(1 + s % 3)));
+			ParticleSystem *view = world.createSystem();
+			for (ParticleSystem *sys : { &separate[s], view })
+			{
+				sys->addForce(gravity[s].get());
+				sys->addForce(cyclic[s].get());
+			}
+			for (int i = 0; i < perSystem; i++)
+			{
+				Particle p;
+				p.lifespan = 1e9;
+				p.position = glm::vec3(unit(rng), unit(rng) + 50, unit(rng));
+				separate[s].add(p);
+				view->add(p);
+			}
+		}
+
+		string params = "systems=" + to_string(numSystems) + " per_system=" + to_string(perSystem);
+		BenchResult a = measure("particles_world", params + " mode=separate", [&]() {
+			for (int s = 0; s < numSystems; s++)
+				separate[s].update(1.0 / 60);
+		}, numSystems * perSystem, 0.5, 50);
+		add(a);
+		BenchResult b = measure("particles_world", params + " mode=world", [&]() {
+			world.update(1.0 / 60);
+		}, numSystems * perSystem, 0.5, 50);
+
+		// run both to the same number of steps, then compare
+		//
+		int64_t stepsA = a.iterations / (numSystems * perSystem), stepsB = b.iterations / (numSystems * perSystem);
+		for (int64_t i = stepsB; i < stepsA; i++) world.update(1.0 / 60);
+		for (int64_t i = stepsA; i < stepsB; i++)
+			for (int s = 0; s < numSystems; s++)
+				separate[s].update(1.0 / 60);
+		bool same = world.size() == numSystems * perSystem;
+		for (int s = 0; s < numSystems && same; s++)
+		{
+			ParticleSystem & view = *world.systems[s];
+			same = view.size() == separate[s].size();
+			for (int i = 0; i < perSystem && same; i++)
+				same = view[i].position == separate[s].particles[i].position && world.positions[world.ranges[s].offset + i] == view[i].position;
+		}
+		if (!same)
+		{
+			cout << "particles_world: world update doesn't match separate systems" << endl;
+			failed = true;
+		}
+		b.extra.push_back(make_pair("speedup", a.nsPerOp / b.nsPerOp));
+		b.extra.push_back(make_pair("matches_separate", same ? 1.0 : 0.0));
+		add(b);
+	}
+}
+
+//  a cheap (CyclicForce) and an expensive (curl noise) field evaluated per
+//  particle and sampled from a GridForce baked from it; error is the mean
+//  distance of the grid's force from the exact one, relative to the mean
+//  exact force.  Sampling a node must give the node's value.
+//
+void Benchmark::runForceGrid()
+{
+	if (!selected("force_grid")) return;
+
+	const int numParticles = 100000;
+	Box bounds(glm::vec3(-50, 0, -50), glm::vec3(50, 50, 50));
+	mt19937 rng(29);
+	uniform_real_distribution<float> ux(-50, 50), uy(0, 50);
+	vector<Particle> particles(numParticles);
+	for (int i = 0; i < numParticles; i++)
+		particles[i].position = glm::vec3(ux(rng), uy(rng), ux(rng));
+
+	CyclicForce cyclic(2);
+	GridForce::Field curl = [](const glm::vec3 & p, float time) { return GridForce::curlNoise(p, .05, time) * 20; };
+	const char* names[] = { "cyclic", "curl" };
+	for (int f = 0; f < 2; f++)
+	{
+		function<void(Particle &)> exact;
+		if (f == 0) exact = [&](Particle & p) { cyclic.updateForce(&p); };
+		else exact = [&](Particle & p) { p.forces += curl(p.position, 0); };
+
+		GridForce grid;
+		chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+		if (f == 0) grid.bake(bounds, 32, 16, 32, &cyclic);
+		else grid.bake(bounds, 32, 16, 32, curl);
+		double bakeMs = secondsSince(t0) * 1e3;
+
+		string params = string("field=") + names[f] + " particles=" + to_string(numParticles);
+		add(measure("force_grid", params + " mode=exact", [&]() {
+			for (int i = 0; i < numParticles; i++)
+			{
+				particles[i].forces = glm::vec3(0, 0, 0);
+				exact(particles[i]);
+			}
+		}, numParticles));
+		BenchResult r = measure("force_grid", params + " mode=grid", [&]() {
+			for (int i = 0; i < numParticles; i++)
+			{
+				particles[i].forces = glm::vec3(0, 0, 0);
+				grid.updateForce(&particles[i]);
+			}
+		}, numParticles);
+
+		double error = 0, magnitude = 0;
+		for (int i = 0; i < numParticles; i++)
+		{
+			Particle p = particles[i];
+			p.forces = glm::vec3(0, 0, 0);
+			exact(p);
+			error += glm::length(grid.sample(p.position) - p.forces);
+			magnitude += glm::length(p.forces);
+		}
+		bool nodesExact = true;
+		for (int z = 0; z < grid.dims[2]; z += 3)
+			for (int y = 0; y < grid.dims[1]; y += 3)
+				for (int x = 0; x < grid.dims[0]; x += 3)
+					if (glm::length(grid.sample(grid.nodePosition(x, y, z)) - grid.node(x, y, z)) > 1e-4 * (1 + glm::length(grid.node(x, y, z))))
+						nodesExact = false;
+		if (!nodesExact)
+		{
+			cout << "force_grid: sampling a node doesn't give its value" << endl;
+			failed = true;
+		}
+		r.extra.push_back(make_pair("bake_ms", bakeMs));
+		r.extra.push_back(make_pair("kbytes", grid.bytes() / 1024.0));
+		r.extra.push_back(make_pair("error_pct", magnitude > 0 ? 100 * error / magnitude : 0));
+		add(r);
+	}
+}
+
+//  ParticleSystem::sort at 100k and 1M particles in each mode (timed with
+//  copying the particles back to spawn order first), then a
+//  terrain collision pass (one Octree point query per particle) over the
+//  particles in spawn order and in Morton order
+//
+void Benchmark::runParticleSort()
+{
+	if (!selected("particles_sort") && !selected("particles_collide")) return;
+
+	ofMesh mesh = makeTerrain(250000);
+	Octree tree;
+	tree.create(mesh, numLevels);
+	int threads = Parallel::hardwareThreads();
+
+	int counts[] = { 100000, 1000000 };
+	for (int c = 0; c < 2; c++)
+	{
+		// particles scattered just above the terrain in random order, the
+		// way many emitters would leave them
+		//
+		mt19937 rng(19);
+		uniform_real_distribution<float> unit(-1, 1);
+		uniform_int_distribution<int> uv(0, (int)mesh.getNumVertices() - 1);
+		ParticleSystem sys;
+		sys.particles.resize(counts[c]);
+		for (int i = 0; i < counts[c]; i++)
+			sys.particles[i].position = mesh.getVertex(uv(rng)) + glm::vec3(unit(rng), unit(rng) * .5, unit(rng));
+		vector<Particle> spawnOrder = sys.particles;
+		string params = "particles=" + to_string(counts[c]);
+
+		if (selected("particles_sort"))
+		{
+			ParticleSortMode modes[] = { SortMorton, SortDepth };
+			const char* modeNames[] = { "morton", "depth" };
+			for (int m = 0; m < 2; m++)
+			{
+				for (int t = 0; t < (threads > 1 ? 2 : 1); t++)
+				{
+					sys.sortMode = modes[m];
+					sys.sortThreads = t == 0 ? 1 : threads;
+					sys.setSortCamera(glm::vec3(0, 150, 300), glm::normalize(glm::vec3(0, -.5, -1)));
+					add(measure("particles_sort", params + " mode=" + modeNames[m] + " threads=" + to_string(sys.sortThreads), [&]() {
+						sys.particles = spawnOrder;
+						sys.sort();
+					}, counts[c], 0.5, 20));
+				}
+			}
+		}
+
+		if (selected("particles_collide"))
+		{
+			int hits[2] = { 0, 0 };
+			for (int order = 0; order < 2; order++)
+			{
+				sys.particles = spawnOrder;
+				if (order == 1)
+				{
+					sys.sortMode = SortMorton;
+					sys.sortThreads = 1;
+					sys.sort();
+				}
+				BenchResult r = measure("particles_collide", params + (order ? " order=morton" : " order=spawn"), [&]() {
+					hits[order] = 0;
+					for (int i = 0; i < sys.particles.size(); i++)
+					{
+						glm::vec3 norm = glm::vec3(10000, 10000, 10000);
+						hits[order] += tree.intersect(sys.particles[i].position, tree.root, &norm);
+					}
+				}, counts[c], 0.5, 20);
+				r.extra.push_back(make_pair("hits", (double)hits[order]));
+				add(r);
+			}
+			if (hits[0] != hits[1])
+			{
+				cout << "particles_collide: sorting changed the number of hits" << endl;
+				failed = true;
+			}
+		}
+	}
+}
+
+//  particles spawned per second by each emitter type
+//
+void Benchmark::runEmitter()
+{
+	if (!selected("emitter_spawn")) return;
+
+	EmitterType types[] = { DirectionalEmitter, RadialEmitter };
+	const char* names[] = { "directional", "radial" };
+	const int batch = 10000;
+	for (int t = 0; t < 2; t++)
+	{
+		ParticleEmitter emitter;
+		emitter.setEmitterType(types[t]);
+		emitter.sys->particles.reserve(batch);
+		BenchResult r = measure("emitter_spawn", string("type=") + names[t], [&]() {
+			emitter.sys->particles.clear();
+			for (int i = 0; i < batch; i++)
+				emitter.spawn(0);
+		}, batch);
+		r.extra.push_back(make_pair("spawns_per_sec", 1e9 / r.nsPerOp));
+		add(r);
+	}
+}
+
+//  one foot's motion over a large step (dt 1/15 at 20 units/s) tested
+//  against the terrain by point tests at n substeps and by Octree::sweep.
+//  Every substep hit is also a sweep hit, missed counts the motions the
+//  substeps step through.
+//
+void Benchmark::runSweep()
+{
+	if (!selected("lander_sweep")) return;
+
+	const int numSegments = 10000;
+	ofMesh mesh = makeTerrain(250000);
+	Octree tree;
+	tree.create(mesh, numLevels);
+	string params = "synthetic vertices=" + to_string(mesh.getNumVertices()) + " step=1.33";
+
+	mt19937 rng(13);
+	uniform_real_distribution<float> unit(-1, 1);
+	uniform_int_distribution<int> uv(0, (int)mesh.getNumVertices() - 1);
+	vector<glm::vec3> from(numSegments), to(numSegments);
+	for (int i = 0; i < numSegments; i++)
+	{
+		from[i] = mesh.getVertex(uv(rng)) + glm::vec3(unit(rng), 0.85 + unit(rng) * .65, unit(rng));
+		to[i] = from[i] + glm::normalize(glm::vec3(unit(rng) * .5, -1, unit(rng) * .5)) * (20.0f / 15);
+	}
+
+	int sweepHits = 0;
+	BenchResult r = measure("lander_sweep", params + " api=sweep", [&]() {
+		sweepHits = 0;
+		for (int i = 0; i < numSegments; i++)
+		{
+			SweepHit hit;
+			sweepHits += tree.sweep(from[i], to[i], 0, hit);
+		}
+	}, numSegments);
+	r.extra.push_back(make_pair("hits", (double)sweepHits));
+	add(r);
+
+	int substeps[] = { 1, 4, 16 };
+	for (int s = 0; s < 3; s++)
+	{
+		int n = substeps[s];
+		int hits = 0;
+		r = measure("lander_sweep", params + " api=substeps n=" + to_string(n), [&]() {
+			hits = 0;
+			for (int i = 0; i < numSegments; i++)
+			{
+				for (int k = 1; k <= n; k++)
+				{
+					glm::vec3 norm = glm::vec3(10000, 10000, 10000);
+					if (tree.intersect(glm::mix(from[i], to[i], (float)k / n), tree.root, &norm))
+					{
+						hits++;
+						break;
+					}
+				}
+			}
+		}, numSegments);
+		r.extra.push_back(make_pair("hits", (double)hits));
+		r.extra.push_back(make_pair("missed", (double)(sweepHits - hits)));
+		add(r);
+	}
+}
+
+//  the feet of a lander drifting down onto the terrain, looked up from the
+//  root every frame and through one OctreeCursor per foot.  Both must give
+//  the same hits and normals; nodes_per_frame is the octree nodes visited
+//  for both feet.
+//
+void Benchmark::runCursor()
+{
+	if (!selected("octree_cursor")) return;
+
+	ofMesh mesh = makeTerrain(250000);
+	Octree tree;
+	tree.create(mesh, numLevels);
+
+	// swept so it comes to rest on the terrain instead of falling between
+	// the leaves of the point test
+	//
+	LanderSim sim;
+	sim.setTerrain(&tree);
+	sim.continuous = true;
+	sim.startingPosition = glm::vec3(0, tree.root.box.max().y + 5, 0);
+	sim.reset();
+	sim.lander().velocity = glm::vec3(2, 0, 1);
+	vector<glm::vec3> frames;
+	for (int i = 0; i < 3000 && !sim.bEnded; i++)
+	{
+		sim.step(LanderInput(), 1.0 / 60);
+		frames.push_back(sim.lander().position);
+	}
+
+	glm::vec3 feet[2] = { glm::vec3(2.8, 0, 0), glm::vec3(0, 0, 2.8) };
+	string params = "synthetic vertices=" + to_string(mesh.getNumVertices()) + " frames=" + to_string(frames.size());
+	vector<glm::vec3> norms[2];
+	int hits[2] = { 0, 0 };
+	double nodesPerFrame[2] = { 0, 0 };
+	for (int mode = 0; mode < 2; mode++)
+	{
+		OctreeCursor cursors[2];
+		norms[mode].assign(frames.size() * 2, glm::vec3(0, 0, 0));
+		BenchResult r = measure("octree_cursor", params + (mode ? " mode=cursor" : " mode=root"), [&]() {
+			PerfCounters::endFrame();
+			hits[mode] = 0;
+			for (int f = 0; f < frames.size(); f++)
+			{
+				for (int k = 0; k < 2; k++)
+				{
+					glm::vec3 norm = glm::vec3(10000, 10000, 10000);
+					if (mode == 0) hits[mode] += tree.intersect(frames[f] + feet[k], tree.root, &norm);
+					else hits[mode] += tree.intersect(frames[f] + feet[k], &norm, cursors[k]);
+					norms[mode][f * 2 + k] = norm;
+				}
+			}
+			PerfCounters::endFrame();
+			nodesPerFrame[mode] = (double)PerfCounters::lastFrame(CounterOctreeNodesVisited) / frames.size();
+		}, frames.size(), 0.5, 200);
+		r.extra.push_back(make_pair("nodes_per_frame", nodesPerFrame[mode]));
+		r.extra.push_back(make_pair("hits", (double)hits[mode]));
+		add(r);
+	}
+	if (hits[0] != hits[1] || norms[0] != norms[1])
+	{
+		cout << "octree_cursor: cursor queries don't match queries from the root" << endl;
+		failed = true;
+	}
+}
+
+//  per tick snapshots of a lander and a particle world with turbulence,
+//  saved, pushed into a RewindBuffer and restored.  Rewinding 100 ticks
+//  and stepping forward again with the same input must give the same
+//  bytes as the first time, random forces and particle ages included.
+//
+void Benchmark::runSnapshot()
+{
+	if (!selected("snapshot_save") && !selected("snapshot_restore") && !selected("rewind_push")) return;
+
+	Octree tree;
+	tree.create(makeTerrain(10000), numLevels);
+	int counts[] = { 10, 1000 };
+	for (int c = 0; c < 2; c++)
+	{
+		LanderSim sim;
+		sim.setTerrain(&tree);
+		sim.startingPosition = glm::vec3(0, 100, 0);
+		sim.reset();
+		ParticleWorld world;
+		GravityForce gravity(glm::vec3(0, -2.5, 0));
+		TurbulenceForce turbulence(glm::vec3(-90, -90, -90), glm::vec3(90, 90, 90));
+		turbulence.random = &sim.random;
+		ParticleSystem *sys = world.createSystem();
+		sys->addForce(&gravity);
+		sys->addForce(&turbulence);
+		SimSnapshot snapshot;
+		snapshot.sim = &sim;
+		snapshot.world = &world;
+		uint64_t clock = 0;
+		snapshot.clock = [&]() { return clock; };
+
+		// a steady count of particles that never expire by the clock,
+		// one spawned and the oldest removed each tick.  The snapshot's
+		// clock steps 16 ms a tick and keeps going after a rewind, as the
+		// wall clock does, so birth times match only if they are restored
+		// as ages.
+		//
+		auto tick = [&](int i) {
+			clock += 16;
+			LanderInput input;
+			input.thrust = (i & 1) == 0;
+			input.left = (i & 8) != 0;
+			sim.step(input, 1.0 / 60);
+			Particle p;
+			p.lifespan = -1;
+			p.birthtime = clock;
+			p.position = sim.lander().position;
+			sys->add(p);
+			world.update(1.0 / 60);
+			if (sys->size() > counts[c]) sys->remove(0);
+		};
+		for (int i = 0; i < counts[c]; i++) tick(i);
+
+		const int ticks = 600;
+		RewindBuffer rewind;
+		rewind.setCapacity(ticks, 60);
+		vector<vector<uint8_t> > states(ticks);
+		for (int i = 0; i < ticks; i++)
+		{
+			tick(i);
+			snapshot.save(states[i]);
+		}
+		string params = "particles=" + to_string(counts[c]);
+
+		vector<uint8_t> scratch;
+		if (selected("snapshot_save"))
+			add(measure("snapshot_save", params, [&]() { snapshot.save(scratch); }, 1, 0.25));
+		int next = 0;
+		BenchResult push;
+		if (selected("rewind_push"))
+		{
+			push = measure("rewind_push", params + " keyframe=60", [&]() {
+				rewind.push(states[next]);
+				next = (next + 1) % ticks;
+			}, 1, 0.25);
+		}
+
+		// a fresh pass so the ring holds the run in order, then check the
+		// round trip of every tick
+		//
+		rewind.clear();
+		for (int i = 0; i < ticks; i++) rewind.push(states[i]);
+		bool same = rewind.available() == ticks - 1;
+		for (int back = 0; back < ticks && same; back++)
+			same = rewind.get(back, scratch) && scratch == states[ticks - 1 - back];
+		push.extra.push_back(make_pair("bytes_per_tick", (double)rewind.bytes() / ticks));
+		push.extra.push_back(make_pair("raw_bytes", (double)states[ticks - 1].size()));
+		if (selected("rewind_push")) add(push);
+
+		if (selected("snapshot_restore"))
+			add(measure("snapshot_restore", params, [&]() { snapshot.restore(states[ticks - 1]); }, 1, 0.25));
+
+		// rewind 100 ticks and run them again
+		//
+		same = same && snapshot.restore(states[ticks - 101]);
+		for (int i = ticks - 100; i < ticks && same; i++)
+		{
+			tick(i);
+			snapshot.save(scratch);
+			same = scratch == states[i];
+		}
+		if (!same)
+		{
+			cout << "snapshot: rewound run doesn't match the original" << endl;
+			failed = true;
+		}
+	}
+}
+
+//  A radar sweep, 64x64 rays in a 30 degree cone from a point above the
+//  terrain, and as many scattered rays with random origins and directions
+//  (incoherent packets).  Each set is traced one ray at a time through
+//  Octree::intersect and RayPackets::traceSingle, then in packets on one
+//  thread and on every core.  The packets must find the same first hit
+//  as traceSingle.
+//
+void Benchmark::runRayPackets()
+{
+	if (!selected("ray_packets")) return;
+
+	ofMesh mesh = makeTerrain(250000);
+	Octree tree;
+	tree.create(mesh, numLevels);
+	Box bounds = tree.root.box;
+	glm::vec3 eye = bounds.center();
+	eye.y = bounds.max().y + 20;
+
+	const int numRays = 64 * 64;
+	vector<glm::vec3> radar;
+	RayPackets::cone(glm::vec3(0, -1, 0), 30, 64, 64, radar);
+	mt19937 rng(11);
+	uniform_real_distribution<float> ux(bounds.min().x, bounds.max().x);
+	uniform_real_distribution<float> uz(bounds.min().z, bounds.max().z);
+	uniform_real_distribution<float> unit(-1, 1);
+	vector<glm::vec3> scatteredOrigins(numRays), scattered(numRays);
+	for (int i = 0; i < numRays; i++)
+	{
+		scatteredOrigins[i] = glm::vec3(ux(rng), bounds.max().y + 10, uz(rng));
+		scattered[i] = glm::normalize(glm::vec3(unit(rng), -1, unit(rng)));
+	}
+
+	int threads = Parallel::hardwareThreads();
+	string base = "synthetic vertices=" + to_string(mesh.getNumVertices()) + " rays=" + to_string(numRays);
+	for (int set = 0; set < 2; set++)
+	{
+		vector<glm::vec3> origins = set == 0 ? vector<glm::vec3>(numRays, eye) : scatteredOrigins;
+		const vector<glm::vec3> & dirs = set == 0 ? radar : scattered;
+		string params = base + (set == 0 ? " set=radar" : " set=scattered");
+		vector<RayHit> single(numRays), packed(numRays);
+
+		auto report = [&](BenchResult r, int cores) {
+			r.extra.push_back(make_pair("rays_per_sec_per_core", 1e9 / r.nsPerOp / cores));
+			add(r);
+		};
+		report(measure("ray_packets", params + " mode=octree", [&]() {
+			for (int i = 0; i < numRays; i++)
+			{
+				const TreeNode *node = NULL;
+				benchSink += tree.intersect(origins[i], dirs[i], tree.root, node);
+			}
+		}, numRays), 1);
+		report(measure("ray_packets", params + " mode=single", [&]() {
+			for (int i = 0; i < numRays; i++)
+				single[i] = RayPackets::traceSingle(tree, origins[i], dirs[i]);
+		}, numRays), 1);
+		report(measure("ray_packets", params + " mode=packet threads=1", [&]() {
+			RayPackets::trace(tree, &origins[0], &dirs[0], numRays, &packed[0]);
+		}, numRays), 1);
+
+		bool same = true;
+		for (int i = 0; i < numRays; i++)
+			same = same && packed[i].hit() == single[i].hit() && packed[i].t == single[i].t;
+		if (threads > 1)
+		{
+			report(measure("ray_packets", params + " mode=packet threads=" + to_string(threads), [&]() {
+				RayPackets::trace(tree, &origins[0], &dirs[0], numRays, &packed[0], 1e30f, threads);
+			}, numRays), threads);
+			for (int i = 0; i < numRays; i++)
+				same = same && packed[i].hit() == single[i].hit() && packed[i].t == single[i].t;
+		}
+		if (!same)
+		{
+			cout << "ray_packets: packets and single rays find different hits" << endl;
+			failed = true;
+		}
+	}
+}
+
+//  Heap allocations once things have warmed up.  lander_allocs steps
+//  LanderSim with every thruster toggling so the input path runs;
+//  frame_allocs runs the simulation side of a game frame (steps, rewind
+//  snapshots, the exhaust emitter and its world, the vbo buffers from the
+//  frame arena).  Either one allocating fails the run.  octree_build_allocs
+//  only reports the allocations of a build.  Needs the counting operator
+//  new (LANDER_COUNT_ALLOCS_ENABLED).
+//
+void Benchmark::runAllocs()
+{
+	if (!selected("lander_allocs") && !selected("frame_allocs") && !selected("octree_build_allocs")) return;
+#ifndef LANDER_COUNT_ALLOCS_ENABLED
+	cout << "skipping allocation counts, build with LANDER_COUNT_ALLOCS to count allocations" << endl;
+#else
+	ofMesh terrain = makeTerrain(10000);
+	Octree tree;
+	tree.create(terrain, numLevels);
+
+	if (selected("octree_build_allocs"))
+	{
+		int64_t allocs = 0;
+		BenchResult r = measure("octree_build_allocs", "vertices=" + to_string(terrain.getNumVertices()), [&]() {
+			PerfCounters::endFrame();
+			Octree built;
+			built.create(terrain, numLevels);
+			PerfCounters::endFrame();
+			allocs = PerfCounters::lastFrame(CounterHeapAllocations);
+		}, 1, 0, 1);
+		r.extra.push_back(make_pair("allocs", (double)allocs));
+		r.extra.push_back(make_pair("nodes", (double)countNodes(tree.root)));
+		add(r);
+	}
+	if (selected("frame_allocs")) runFrameAllocs(tree);
+
+	for (int c = 0; c < 2 && selected("lander_allocs"); c++)
+	{
+		LanderSim sim;
+		sim.setTerrain(&tree);
+		sim.continuous = c == 1;
+		sim.startingPosition = glm::vec3(0, 100, 0);
+		sim.reset();
+
+		// thrust every other step holds height against the default gravity
+		//
+		const int warmup = 60;
+		const int steps = 600;
+		int64_t allocs = 0;
+		BenchResult r = measure("lander_allocs", string("collision=") + (c ? "sweep" : "point"), [&]() {
+			for (int i = 0; i < warmup + steps; i++)
+			{
+				if (i == warmup) PerfCounters::endFrame();
+				LanderInput input;
+				input.thrust = (i & 1) == 0;
+				input.forward = (i & 2) != 0;
+				input.back = (i & 2) == 0;
+				input.left = (i & 4) != 0;
+				input.right = (i & 4) == 0;
+				sim.step(input, 1.0 / 60);
+			}
+			PerfCounters::endFrame();
+			allocs = PerfCounters::lastFrame(CounterHeapAllocations);
+		}, warmup + steps, 0, 1);
+
+		r.extra.push_back(make_pair("allocs_per_step", (double)allocs / steps));
+		r.extra.push_back(make_pair("height", sim.dist));
+		add(r);
+		if (allocs > 0 || sim.bEnded)
+		{
+			cout << "lander_allocs: " << allocs << " allocations in " << steps << " steps" << (sim.bEnded ? ", the lander touched down" : "") << endl;
+			failed = true;
+		}
+	}
+#endif
+}
+
+void Benchmark::runFrameAllocs(const Octree & tree)
+{
+	LanderSim sim;
+	sim.setTerrain(&tree);
+	sim.startingPosition = glm::vec3(0, 100, 0);
+	sim.reset();
+	ParticleWorld world;
+	ParticleEmitter emitter(&world);
+	TurbulenceForce turbulence(glm::vec3(-90, -90, -90), glm::vec3(90, 90, 90));
+	turbulence.random = &sim.random;
+	emitter.sys->addForce(&turbulence);
+	emitter.random = &sim.random;
+	emitter.velocity = glm::vec3(0, -15, 0);
+	emitter.lifespan = -1;
+	SimSnapshot snapshot;
+	snapshot.sim = &sim;
+	snapshot.world = &world;
+	snapshot.emitters.push_back(&emitter);
+	RewindBuffer rewind;
+	rewind.setCapacity(10 * 60, 60);
+	vector<uint8_t> state;
+
+	// one particle spawned and the oldest removed each tick, so the count
+	// holds steady without waiting on the clock; warm up past the rewind
+	// buffer's length so every slot has been filled once
+	//
+	const int warmup = 1200;
+	const int frames = 600;
+	const int particles = 100;
+	int64_t allocs = 0;
+	BenchResult r = measure("frame_allocs", "particles=" + to_string(particles), [&]() {
+		for (int i = 0; i < warmup + frames; i++)
+		{
+			if (i == warmup) PerfCounters::endFrame();
+			LanderInput input;
+			input.thrust = (i & 1) == 0;
+			input.left = (i & 8) != 0;
+			sim.step(input, 1.0 / 60);
+			snapshot.save(state);
+			rewind.push(state);
+
+			emitter.setPosition(sim.lander().position);
+			emitter.spawn(ofGetElapsedTimeMillis());
+			emitter.update(1.0 / 60);
+			world.update(1.0 / 60);
+			if (emitter.sys->size() > particles) emitter.sys->remove(0);
+
+			ArenaVector<ofVec3f> sizes(world.size(), ofVec3f(20), Arena::frame());
+			benchSink += sizes.size();
+			Arena::frame().reset();
+		}
+		PerfCounters::endFrame();
+		allocs = PerfCounters::lastFrame(CounterHeapAllocations);
+	}, warmup + frames, 0, 1);
+
+	r.extra.push_back(make_pair("allocs_per_frame", (double)allocs / frames));
+	r.extra.push_back(make_pair("frame_arena_bytes", (double)Arena::frame().capacity()));
+	add(r);
+	if (allocs > 0)
+	{
+		cout << "frame_allocs: " << allocs << " allocations in " << frames << " frames" << endl;
+		failed = true;
+	}
+}
+
+//  scoring the feet of many landers against 1000 pads through the grid and
+//  against every pad, both must count the same feet on every pad
+//
+void Benchmark::runLandingSites()
+{
+	if (!selected("landing_score")) return;
+
+	const int numPads = 1000;
+	const int numLanders = 100000;
+	mt19937 rng(17);
+	uniform_real_distribution<float> unit(-1, 1);
+
+	LandingSites sites;
+	for (int i = 0; i < numPads; i++)
+	{
+		LandingPad pad;
+		pad.name = "pad" + to_string(i);
+		pad.position = glm::vec3(unit(rng) * 200, unit(rng) * 20, unit(rng) * 200);
+		pad.radius = 6;
+		sites.add(pad);
+	}
+	sites.build();
+
+	// half the landers over a pad, half anywhere
+	//
+	vector<glm::vec3> feet(numLanders * 4);
+	for (int i = 0; i < numLanders; i++)
+	{
+		glm::vec3 p = glm::vec3(unit(rng) * 200, unit(rng) * 20, unit(rng) * 200);
+		if (i & 1) p = sites.pads[rng() % numPads].position + glm::vec3(unit(rng) * 6, 1 + unit(rng) * .5, unit(rng) * 6);
+		for (int k = 0; k < 4; k++)
+			feet[i * 4 + k] = p + LandingSites::feet[k];
+	}
+
+	string params = "pads=" + to_string(numPads) + " landers=" + to_string(numLanders);
+	vector<int> gridFeet(numPads), linearFeet(numPads);
+	int gridHits = 0, linearHits = 0;
+	BenchResult grid = measure("landing_score", params + " api=grid", [&]() {
+		fill(gridFeet.begin(), gridFeet.end(), 0);
+		gridHits = sites.score(feet.data(), (int)feet.size(), gridFeet.data());
+	}, numLanders);
+	BenchResult linear = measure("landing_score", params + " api=linear", [&]() {
+		fill(linearFeet.begin(), linearFeet.end(), 0);
+		linearHits = sites.scoreLinear(feet.data(), (int)feet.size(), linearFeet.data());
+	}, numLanders, 0.25, 3);
+
+	bool same = gridHits == linearHits && gridFeet == linearFeet;
+	if (!same)
+	{
+		cout << "landing_score: grid and linear scoring differ" << endl;
+		failed = true;
+	}
+	grid.extra.push_back(make_pair("speedup", linear.nsPerOp / grid.nsPerOp));
+	grid.extra.push_back(make_pair("hits", (double)gridHits));
+	grid.extra.push_back(make_pair("matches_linear", same ? 1.0 : 0.0));
+	add(linear);
+	add(grid);
+}
+
+//  1024 landers stepped as separate LanderSims and as one LanderBatch, same
+//  terrain, start positions and input stream
+//
+void Benchmark::runLanders()
+{
+	if (!selected("lander_step")) return;
+
+	const int numLanders = 1024;
+	const int numPatterns = 64;
+	const float dt = 1.0 / 60;
+	ofMesh mesh = makeTerrain(250000);
+	Octree tree;
+	tree.create(mesh, numLevels);
+
+	mt19937 rng(11);
+	uniform_real_distribution<float> unit(0, 1);
+	vector<glm::vec3> starts(numLanders);
+	for (int i = 0; i < numLanders; i++)
+		starts[i] = glm::vec3(unit(rng) * 120 - 60, 20 + unit(rng) * 10, unit(rng) * 120 - 60);
+	vector<LanderInput> inputs(numPatterns * numLanders);
+	for (int i = 0; i < inputs.size(); i++)
+	{
+		inputs[i].thrust = unit(rng) < .4;
+		inputs[i].forward = unit(rng) < .1;
+		inputs[i].left = unit(rng) < .1;
+		inputs[i].back = unit(rng) < .1;
+		inputs[i].right = unit(rng) < .1;
+	}
+
+	string params = "landers=" + to_string(numLanders) + " vertices=" + to_string(mesh.getNumVertices());
+
+	vector<LanderSim> sims(numLanders);
+	auto resetSims = [&]() {
+		for (int i = 0; i < numLanders; i++)
+		{
+			sims[i].setTerrain(&tree);
+			sims[i].startingPosition = starts[i];
+			sims[i].reset();
+		}
+	};
+	auto stepSims = [&](int tick) {
+		const LanderInput *in = &inputs[(tick % numPatterns) * numLanders];
+		for (int i = 0; i < numLanders; i++)
+		{
+			if (sims[i].bEnded) sims[i].reset();
+			sims[i].step(in[i], dt);
+		}
+	};
+
+	LanderBatch batch;
+	vector<float> obs(numLanders * LanderBatch::ObsSize), rewards(numLanders);
+	vector<unsigned char> dones(numLanders);
+	auto resetBatch = [&]() {
+		batch.resize(numLanders);
+		batch.setTerrain(&tree);
+		for (int i = 0; i < numLanders; i++)
+			batch.reset(i, starts[i]);
+	};
+	auto stepBatch = [&](int tick) {
+		// ended landers go back to their own start, like the LanderSims above
+		//
+		for (int i = 0; i < numLanders; i++)
+			if (batch.status[i] != LanderFlying) batch.reset(i, starts[i]);
+		batch.step(&inputs[(tick % numPatterns) * numLanders], dt, obs.data(), rewards.data(), dones.data());
+	};
+
+	// both must fly the same trajectories before their speed means anything
+	//
+	resetSims();
+	resetBatch();
+	float maxError = 0, maxHeightError = 0;
+	for (int t = 0; t < 600; t++)
+	{
+		stepSims(t);
+		stepBatch(t);
+	}
+	for (int i = 0; i < numLanders; i++)
+	{
+		maxError = max(maxError, glm::length(sims[i].lander().position - batch.position(i)));
+		maxHeightError = max(maxHeightError, abs(sims[i].dist - batch.height[i]));
+	}
+
+	int tick = 0;
+	resetSims();
+	BenchResult single = measure("lander_step", params + " api=single", [&]() { stepSims(tick++); }, numLanders);
+	add(single);
+
+	tick = 0;
+	resetBatch();
+	BenchResult r = measure("lander_step", params + " api=batch", [&]() { stepBatch(tick++); }, numLanders);
+	r.extra.push_back(make_pair("speedup", single.nsPerOp / r.nsPerOp));
+	r.extra.push_back(make_pair("max_error", (double)maxError));
+	r.extra.push_back(make_pair("max_height_error", (double)maxHeightError));
+	add(r);
+	if (r.nsPerOp >= single.nsPerOp)
+	{
+		cout << "lander_step: the batch is no faster than separate LanderSims" << endl;
+		failed = true;
+	}
+
+	tick = 0;
+	resetBatch();
+	batch.numThreads = 0;
+	r = measure("lander_step", params + " api=batch threads=" + to_string(Parallel::hardwareThreads()), [&]() { stepBatch(tick++); }, numLanders);
+	r.extra.push_back(make_pair("speedup", single.nsPerOp / r.nsPerOp));
+	add(r);
+}
+
+bool Benchmark::write(const string & path)
+{
+	ofstream out(path);
+	if (!out)
+	{
+		cout << "can't write benchmark results to " << path << endl;
+		return false;
+	}
+	out << "{" << endl;
+	out << "  \"version\": 1," << endl;
+	out << "  \"results\": [" << endl;
+	for (int i = 0; i < results.size(); i++)
+	{
+		const BenchResult & r = results[i];
+		out << "    {\"name\": \"" << r.name << "\", \"params\": \"" << r.params << "\", \"iterations\": " << r.iterations
+			<< ", \"ns_per_op\": " << setprecision(12) << r.nsPerOp << ", \"ops_per_sec\": " << 1e9 / r.nsPerOp;
+		for (int k = 0; k < r.extra.size(); k++)
+			out << ", \"" << r.extra[k].first << "\": " << r.extra[k].second;
+		out << "}" << (i + 1 < results.size() ? "," : "") << endl;
+	}
+	out << "  ]" << endl;
+	out << "}" << endl;
+	cout << "wrote " << results.size() << " results to " << path << endl;
+	return true;
+}
+
+//  value of "key" in a single line result object written by write()
+//
+static string jsonField(const string & line, const string & key)
+{
+	string tag = "\"" + key + "\": ";
+	size_t p = line.find(tag);
+	if (p == string::npos) return "";
+	p += tag.size();
+	if (line[p] == '"')
+	{
+		size_t e = line.find('"', p + 1);
+		return line.substr(p + 1, e - p - 1);
+	}
+	size_t e = line.find_first_of(",}", p);
+	return line.substr(p, e - p);
+}
+
+static bool readResults(const string & path, vector<pair<string, double> > & results)
+{
+	ifstream in(path);
+	if (!in)
+	{
+		cout << "can't read " << path << endl;
+		return false;
+	}
+	string line;
+	while (getline(in, line))
+	{
+		string name = jsonField(line, "name");
+		if (name.empty()) continue;
+		results.push_back(make_pair(name + " " + jsonField(line, "params"), atof(jsonField(line, "ns_per_op").c_str())));
+	}
+	return true;
+}
+
+//  compare two result files, anything slower than threshold (0.1 = 10%) is
+//  flagged as a regression and makes the exit code non zero
+//
+int Benchmark::compare(const string & basePath, const string & newPath, double threshold)
+{
+	vector<pair<string, double> > base, current;
+	if (!readResults(basePath, base) || !readResults(newPath, current)) return 2;
+
+	int regressions = 0;
+	for (int i = 0; i < current.size(); i++)
+	{
+		int k = 0;
+		while (k < base.size() && base[k].first != current[i].first) k++;
+		if (k == base.size())
+		{
+			cout << left << setw(64) << current[i].first << "  new" << endl;
+			continue;
+		}
+		double ratio = current[i].second / base[k].second;
+		string flag = "";
+		if (ratio > 1 + threshold)
+		{
+			flag = "  REGRESSION";
+			regressions++;
+		}
+		else if (ratio < 1 - threshold) flag = "  improved";
+		cout << left << setw(64) << current[i].first << right << fixed << setprecision(1)
+			<< setw(14) << base[k].second << setw(14) << current[i].second
+			<< setprecision(2) << setw(8) << ratio << "x" << flag << defaultfloat << endl;
+	}
+	cout << regressions << " regression(s) over " << threshold * 100 << "%" << endl;
+	return regressions > 0 ? 1 : 0;
+}
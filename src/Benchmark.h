@@ -0,0 +1,73 @@
+#pragma once
+#include "ofMain.h"
+#include "Octree.h"
+
+//  Headless benchmark suite for the octree, collision and particle hot
+//  paths.  Started from main() when the app is run with
+//
+//      --bench [--out bench.json] [--sizes 10000,100000,1000000,10000000]
+//              [--levels 13] [--filter name] [--moon geo/Moon500.obj]
+//      --bench-compare base.json new.json [--threshold 0.1]
+//
+//  Results are written as JSON, one result object per line, so two runs can
+//  be diffed by the compare mode.
+//
+struct BenchResult
+{
+	string name;
+	string params;
+	int64_t iterations = 0;
+	double nsPerOp = 0;
+	vector<pair<string, double> > extra;
+};
+
+class Benchmark
+{
+public:
+	static int main(const vector<string> & args);
+	static int compare(const string & basePath, const string & newPath, double threshold);
+	static ofMesh makeTerrain(int numVertices, unsigned int seed = 1);
+	static int countNodes(const TreeNode & node);
+	static size_t treeBytes(const TreeNode & node);
+
+	void run();
+	bool write(const string & path);
+
+	// fixtures
+	//
+	void runTerrain(const string & label, const ofMesh & mesh);
+	void runUpdate(const string & params, const ofMesh & mesh);
+	void runSlicedBuild(const string & params, const ofMesh & mesh);
+	void runCompact(const string & params, const ofMesh & mesh, const Octree & tree,
+		const vector<glm::vec3> & origins, const vector<glm::vec3> & surface);
+	void runSpatial(const string & params, const ofMesh & mesh, const Octree & tree,
+		const vector<glm::vec3> & surface, const vector<glm::vec3> & inBox);
+	void runWeld(const string & label, const ofMesh & mesh);
+	void runParticles();
+	void runParticleSort();
+	void runParticleWorld();
+	void runForceGrid();
+	void runEmitter();
+	void runLanders();
+	void runSweep();
+	void runCursor();
+	void runRayPackets();
+	void runAllocs();
+	void runFrameAllocs(const Octree & tree);
+	void runSnapshot();
+	void runLandingSites();
+
+	// time op() until at least minSeconds have passed, op performs opsPerCall operations
+	//
+	BenchResult measure(const string & name, const string & params, function<void()> op,
+		int64_t opsPerCall = 1, double minSeconds = 0.25, int64_t maxCalls = 1 << 30);
+	void add(const BenchResult & r);
+	bool selected(const string & name) const;
+
+	vector<int> sizes = { 10000, 100000, 1000000, 10000000 };
+	int numLevels = 13;
+	string filter;
+	string moonPath = "geo/Moon500.obj";
+	vector<BenchResult> results;
+	bool failed = false;     // a correctness check failed, main returns 1
+};
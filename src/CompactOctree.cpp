@@ -0,0 +1,287 @@
+#include "CompactOctree.h"
+#include "Octree.h"
+#include "Profiler.h"
+
+//  Octree::subDivideBox8 worked out per octant: the boxes are made by
+//  shifting the first one by half the size, and the same additions are
+//  done here, including shifting octant 3 back in x
+//
+Box CompactOctree::childBox(const Box & b, int k)
+{
+	glm::vec3 min = b.parameters[0];
+	glm::vec3 max = b.parameters[1];
+	glm::vec3 center = (max - min) / 2 + min;
+	float xdist = (max.x - min.x) / 2;
+	float ydist = (max.y - min.y) / 2;
+	float zdist = (max.z - min.z) / 2;
+
+	int floor = k & 3;
+	if (floor == 1 || floor == 2 || floor == 3)
+	{
+		min.x += xdist;
+		center.x += xdist;
+	}
+	if (floor == 2 || floor == 3)
+	{
+		min.z += zdist;
+		center.z += zdist;
+	}
+	if (floor == 3)
+	{
+		min.x += -xdist;
+		center.x += -xdist;
+	}
+	if (k >= 4)
+	{
+		min.y += ydist;
+		center.y += ydist;
+	}
+	return Box(min, center);
+}
+
+static_assert(sizeof(CompactOctree::Node) == 8, "compact octree node layout");
+
+static inline bool inside(const Box & b, const glm::vec3 & p)
+{
+	return ((p.x >= b.parameters[0].x && p.x <= b.parameters[1].x) &&
+		(p.y >= b.parameters[0].y && p.y <= b.parameters[1].y) &&
+		(p.z >= b.parameters[0].z && p.z <= b.parameters[1].z));
+}
+
+void CompactOctree::create(const ofMesh & mesh, int numLevels)
+{
+	MeshView view;
+	view.vertices = mesh.getVertices().data();
+	view.normals = mesh.getNumNormals() == mesh.getNumVertices() ? mesh.getNormals().data() : NULL;
+	view.numVertices = (int)mesh.getNumVertices();
+	create(view, numLevels);
+}
+
+void CompactOctree::create(const MeshView & view, int numLevels)
+{
+	PROFILE_SCOPE("CompactOctree::create");
+
+	vertices = view.vertices;
+	normals = view.normals;
+	numVertices = view.numVertices;
+	levels = numLevels;
+	box = view.hasBounds ? view.bounds : Octree::meshBounds(view.vertices, view.numVertices);
+
+	nodes.assign(1, Node());
+	pointData.clear();
+	vector<int> points(numVertices);
+	for (int i = 0; i < numVertices; i++)
+		points[i] = i;
+	build(0, box, points, 1);
+	nodes.shrink_to_fit();
+	pointData.shrink_to_fit();
+}
+
+//  same splitting rules as Octree::subdivide, a node below the root with
+//  one point or at the last level is a leaf
+//
+void CompactOctree::build(uint32_t index, const Box & b, const vector<int> & points, int level)
+{
+	bool leaf = level >= levels || (index != 0 && points.size() <= 1);
+	if (!leaf)
+	{
+		vector<int> childPoints[8];
+		uint8_t mask = 0;
+		int numChildren = 0;
+		for (int k = 0; k < 8; k++)
+		{
+			Box c = childBox(b, k);
+			for (int i = 0; i < points.size(); i++)
+				if (inside(c, vertices[points[i]])) childPoints[k].push_back(points[i]);
+			if (childPoints[k].empty()) continue;
+			mask |= 1 << k;
+			numChildren++;
+		}
+		if (mask != 0 || index != 0)
+		{
+			uint32_t first = (uint32_t)nodes.size();
+			nodes[index].first = first;
+			nodes[index].childMask = mask;
+			nodes.resize(first + numChildren);
+			uint32_t c = first;
+			for (int k = 0; k < 8; k++)
+			{
+				if (!(mask & (1 << k))) continue;
+				build(c++, childBox(b, k), childPoints[k], level + 1);
+			}
+			return;
+		}
+	}
+
+	// leaf: first index, then deltas if they all fit in 16 bits
+	//
+	Node & node = nodes[index];
+	if (points.size() == 1)
+	{
+		node.first = points[0];
+		node.count = 1;
+		return;
+	}
+	node.first = (uint32_t)pointData.size();
+	node.count = (uint16_t)min(points.size(), (size_t)0xFFFF);
+	if (points.empty()) return;
+	if (node.count == 0xFFFF)
+	{
+		pointData.push_back(points.size() & 0xFFFF);
+		pointData.push_back(points.size() >> 16);
+	}
+	for (int i = 1; i < points.size() && !node.wide; i++)
+		if (points[i] - points[i - 1] > 0xFFFF) node.wide = 1;
+	pointData.push_back(points[0] & 0xFFFF);
+	pointData.push_back(points[0] >> 16);
+	for (int i = 1; i < points.size(); i++)
+	{
+		if (node.wide)
+		{
+			pointData.push_back(points[i] & 0xFFFF);
+			pointData.push_back(points[i] >> 16);
+		}
+		else pointData.push_back(points[i] - points[i - 1]);
+	}
+}
+
+static_assert(sizeof(CompactOctreeHeader) == 48, "compact octree header layout");
+
+bool CompactOctree::write(const string & path) const
+{
+	ofstream out(path, ios::binary);
+	if (!out)
+	{
+		cout << "can't write octree " << path << endl;
+		return false;
+	}
+
+	CompactOctreeHeader h;
+	h.levels = levels;
+	h.numVertices = numVertices;
+	h.numNodes = (uint32_t)nodes.size();
+	h.numPointData = (uint32_t)pointData.size();
+	for (int k = 0; k < 3; k++)
+	{
+		h.boxMin[k] = box.min()[k];
+		h.boxMax[k] = box.max()[k];
+	}
+	out.write((const char*)&h, sizeof(h));
+	out.write((const char*)nodes.data(), nodes.size() * sizeof(Node));
+	out.write((const char*)pointData.data(), pointData.size() * sizeof(uint16_t));
+	return out.good();
+}
+
+//  the nodes saved by write(), over view's vertices, which must be the ones
+//  the tree was built on
+//
+bool CompactOctree::read(const string & path, const MeshView & view)
+{
+	ifstream in(path, ios::binary);
+	CompactOctreeHeader h;
+	if (!in.read((char*)&h, sizeof(h)) || memcmp(h.magic, "LLOC", 4) != 0 ||
+		h.version != CompactOctreeHeader().version || h.numVertices != view.numVertices || h.numNodes == 0)
+	{
+		cout << path << " is not an octree of this mesh or is out of date" << endl;
+		return false;
+	}
+	nodes.resize(h.numNodes);
+	pointData.resize(h.numPointData);
+	in.read((char*)nodes.data(), nodes.size() * sizeof(Node));
+	in.read((char*)pointData.data(), pointData.size() * sizeof(uint16_t));
+	if (!in)
+	{
+		cout << path << " is truncated" << endl;
+		nodes.clear();
+		pointData.clear();
+		return false;
+	}
+
+	vertices = view.vertices;
+	normals = view.normals;
+	numVertices = view.numVertices;
+	levels = h.levels;
+	box = Box(glm::vec3(h.boxMin[0], h.boxMin[1], h.boxMin[2]), glm::vec3(h.boxMax[0], h.boxMax[1], h.boxMax[2]));
+	return true;
+}
+
+size_t CompactOctree::bytes() const
+{
+	return sizeof(*this) + nodes.capacity() * sizeof(Node) + pointData.capacity() * sizeof(uint16_t);
+}
+
+bool CompactOctree::intersect(const glm::vec3 & point, glm::vec3 *norm) const
+{
+	return intersect(0, box, point, norm);
+}
+
+bool CompactOctree::intersect(uint32_t index, const Box & b, const glm::vec3 & point, glm::vec3 *norm) const
+{
+	if (!inside(b, point)) return false;
+
+	const Node & node = nodes[index];
+	if (node.childMask == 0)
+	{
+		// nearest point of the leaf and its normal
+		//
+		uint32_t count = node.count;
+		const uint16_t *data = count > 1 ? &pointData[node.first] : NULL;
+		if (count == 0xFFFF)
+		{
+			count = data[0] | ((uint32_t)data[1] << 16);
+			data += 2;
+		}
+		uint32_t v = node.first;
+		int index = -1;
+		float dist = 999999;
+		for (uint32_t i = 0; i < count; i++)
+		{
+			if (count == 1) v = node.first;
+			else if (i == 0 || node.wide) v = data[2 * i] | ((uint32_t)data[2 * i + 1] << 16);
+			else v += data[i + 1];
+			float d = glm::length(point - vertices[v]);
+			if (d < dist)
+			{
+				index = v;
+				dist = d;
+			}
+		}
+		if (dist < glm::length(*norm))
+			*norm = glm::normalize(normals ? normals[index] : glm::vec3(0, 1, 0)) * dist;
+		return true;
+	}
+
+	uint32_t c = node.first;
+	for (int k = 0; k < 8; k++)
+	{
+		if (!(node.childMask & (1 << k))) continue;
+		if (intersect(c++, childBox(b, k), point, norm)) return true;
+	}
+	return false;
+}
+
+bool CompactOctree::intersect(const glm::vec3 & point, const glm::vec3 & dir, Box & leafRtn) const
+{
+	return intersect(0, box, point, dir, leafRtn);
+}
+
+bool CompactOctree::intersect(uint32_t index, const Box & b, const glm::vec3 & point, const glm::vec3 & dir, Box & leafRtn) const
+{
+	if (!b.intersect(point, dir, -1000, 1000)) return false;
+
+	const Node & node = nodes[index];
+	if (node.childMask == 0)
+	{
+		if (glm::length(leafRtn.center() - point) > glm::length(b.center() - point))
+			leafRtn = b;
+		return true;
+	}
+
+	uint32_t c = node.first;
+	for (int k = 0; k < 8; k++)
+	{
+		if (!(node.childMask & (1 << k))) continue;
+		if (intersect(c++, childBox(b, k), point, dir, leafRtn)) return true;
+	}
+	return false;
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include "ofMain.h"
+#include "box.h"
+#include "MeshCache.h"
+
+//  Read only octree with the same subdivision and query results as Octree
+//  in a fraction of the memory:
+//
+//  - no boxes are stored, a child's box is worked out from its parent's
+//    and its octant while descending, with the same arithmetic as
+//    Octree::subDivideBox8 so the boxes are bit for bit the same
+//  - the children of a node are contiguous in one node array, found by
+//    the index of the first and a mask of the octants that exist
+//  - only leaves keep vertex indices.  A leaf with one point holds it in
+//    the node, bigger ones point at the first index followed by 16 bit
+//    deltas (or full 32 bit indices when a gap is too wide)
+//
+//  The vertex data is the caller's and must outlive the tree.  write()
+//  saves the nodes so a tree can be read back later over the same vertices
+//  without building it again.
+//
+struct CompactOctreeHeader
+{
+	char magic[4] = { 'L', 'L', 'O', 'C' };
+	uint32_t version = 1;
+	uint32_t levels = 0;
+	uint32_t numVertices = 0;     // of the mesh it was built on
+	uint32_t numNodes = 0;
+	uint32_t numPointData = 0;
+	float boxMin[3] = { 0, 0, 0 };
+	float boxMax[3] = { 0, 0, 0 };
+};
+
+class CompactOctree
+{
+public:
+	struct Node
+	{
+		uint32_t first = 0;      // first child, the point of a one point leaf, or its first pointData entry
+		uint16_t count = 0;      // points in a leaf, 0xFFFF: the count is in pointData before the points
+		uint8_t childMask = 0;   // bit k set if octant k has a child, 0 for a leaf
+		uint8_t wide = 0;        // leaf indices stored as 32 bits
+	};
+
+	void create(const MeshView & view, int numLevels);
+	void create(const ofMesh & mesh, int numLevels);
+	bool write(const string & path) const;
+	bool read(const string & path, const MeshView & view);
+
+	// same results as Octree::intersect(point, root, norm) and the leaf box
+	// Octree::intersect(point, dir, root, &leaf) leaves in leaf
+	//
+	bool intersect(const glm::vec3 & point, glm::vec3 *norm) const;
+	bool intersect(const glm::vec3 & point, const glm::vec3 & dir, Box & leafRtn) const;
+
+	size_t bytes() const;
+	static Box childBox(const Box & box, int octant);
+
+	Box box;                    // root bounds
+	vector<Node> nodes;         // nodes[0] is the root
+	vector<uint16_t> pointData;
+	const glm::vec3 *vertices = NULL;
+	const glm::vec3 *normals = NULL;
+	int numVertices = 0;
+	int levels = 0;
+
+private:
+	void build(uint32_t index, const Box & b, const vector<int> & points, int level);
+	bool intersect(uint32_t index, const Box & b, const glm::vec3 & point, glm::vec3 *norm) const;
+	bool intersect(uint32_t index, const Box & b, const glm::vec3 & point, const glm::vec3 & dir, Box & leafRtn) const;
+};
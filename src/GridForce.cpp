@@ -0,0 +1,164 @@
+#include "GridForce.h"
+#include "Profiler.h"
+#ifdef GRID_FORCE_SSE
+#include <emmintrin.h>
+#endif
+
+void GridForce::bake(const Box & bounds, int nx, int ny, int nz, Field field, float time)
+{
+	PROFILE_SCOPE("GridForce::bake");
+
+	this->bounds = bounds;
+	this->field = field;
+	dims[0] = max(nx, 2);
+	dims[1] = max(ny, 2);
+	dims[2] = max(nz, 2);
+	origin = bounds.min();
+	cellSize = (bounds.max() - bounds.min()) / glm::vec3(dims[0] - 1, dims[1] - 1, dims[2] - 1);
+	invCellSize = glm::vec3(cellSize.x > 0 ? 1 / cellSize.x : 0, cellSize.y > 0 ? 1 / cellSize.y : 0,
+		cellSize.z > 0 ? 1 / cellSize.z : 0);
+	cells.assign((size_t)dims[0] * dims[1] * dims[2] * 4, 0);
+	evaluate(time);
+}
+
+//  the force a unit mass particle at rest feels at each node
+//
+void GridForce::bake(const Box & bounds, int nx, int ny, int nz, ParticleForce *force)
+{
+	bake(bounds, nx, ny, nz, [force](const glm::vec3 & p, float time) {
+		Particle probe;
+		probe.position = p;
+		probe.mass = 1;
+		force->updateForce(&probe);
+		return probe.forces;
+	});
+}
+
+//  bake the field again at time if refreshInterval has passed since the
+//  last bake, true if it did
+//
+bool GridForce::refresh(float time)
+{
+	if (refreshInterval <= 0 || !field || time - bakedAt < refreshInterval) return false;
+	PROFILE_SCOPE("GridForce::refresh");
+	evaluate(time);
+	return true;
+}
+
+void GridForce::evaluate(float time)
+{
+	bakedAt = time;
+	for (int z = 0; z < dims[2]; z++)
+	{
+		for (int y = 0; y < dims[1]; y++)
+		{
+			for (int x = 0; x < dims[0]; x++)
+			{
+				glm::vec3 f = field(nodePosition(x, y, z), time);
+				float *c = &cells[(((size_t)z * dims[1] + y) * dims[0] + x) * 4];
+				c[0] = f.x;
+				c[1] = f.y;
+				c[2] = f.z;
+			}
+		}
+	}
+}
+
+glm::vec3 GridForce::nodePosition(int x, int y, int z) const
+{
+	return origin + cellSize * glm::vec3(x, y, z);
+}
+
+glm::vec3 GridForce::node(int x, int y, int z) const
+{
+	const float *c = &cells[(((size_t)z * dims[1] + y) * dims[0] + x) * 4];
+	return glm::vec3(c[0], c[1], c[2]);
+}
+
+//  Trilinear blend of the 8 nodes of the cell p is in.  The cell and the
+//  fractions are found per axis (clamped to the grid), then the SSE path
+//  blends the 4 wide node vectors along x, y and z with 7 lerps.
+//
+glm::vec3 GridForce::sample(const glm::vec3 & p) const
+{
+	if (cells.empty()) return glm::vec3(0, 0, 0);
+
+	size_t dx = 4, dy = (size_t)dims[0] * 4, dz = (size_t)dims[0] * dims[1] * 4;
+
+#ifdef GRID_FORCE_SSE
+	__m128 f = _mm_mul_ps(_mm_sub_ps(_mm_set_ps(0, p.z, p.y, p.x), _mm_set_ps(0, origin.z, origin.y, origin.x)),
+		_mm_set_ps(0, invCellSize.z, invCellSize.y, invCellSize.x));
+	f = _mm_min_ps(_mm_max_ps(f, _mm_setzero_ps()), _mm_set_ps(0, dims[2] - 1, dims[1] - 1, dims[0] - 1));
+	__m128i cell = _mm_cvttps_epi32(_mm_min_ps(f, _mm_set_ps(0, dims[2] - 2, dims[1] - 2, dims[0] - 2)));
+	__m128 t = _mm_sub_ps(f, _mm_cvtepi32_ps(cell));
+	int i[4];
+	_mm_storeu_si128((__m128i *)i, cell);
+	const float *c = &cells[i[2] * dz + i[1] * dy + i[0] * dx];
+
+	__m128 tx = _mm_shuffle_ps(t, t, _MM_SHUFFLE(0, 0, 0, 0));
+	__m128 ty = _mm_shuffle_ps(t, t, _MM_SHUFFLE(1, 1, 1, 1));
+	__m128 tz = _mm_shuffle_ps(t, t, _MM_SHUFFLE(2, 2, 2, 2));
+	__m128 c000 = _mm_loadu_ps(c), c100 = _mm_loadu_ps(c + dx);
+	__m128 c010 = _mm_loadu_ps(c + dy), c110 = _mm_loadu_ps(c + dy + dx);
+	__m128 c001 = _mm_loadu_ps(c + dz), c101 = _mm_loadu_ps(c + dz + dx);
+	__m128 c011 = _mm_loadu_ps(c + dz + dy), c111 = _mm_loadu_ps(c + dz + dy + dx);
+	__m128 x00 = _mm_add_ps(c000, _mm_mul_ps(_mm_sub_ps(c100, c000), tx));
+	__m128 x10 = _mm_add_ps(c010, _mm_mul_ps(_mm_sub_ps(c110, c010), tx));
+	__m128 x01 = _mm_add_ps(c001, _mm_mul_ps(_mm_sub_ps(c101, c001), tx));
+	__m128 x11 = _mm_add_ps(c011, _mm_mul_ps(_mm_sub_ps(c111, c011), tx));
+	__m128 y0 = _mm_add_ps(x00, _mm_mul_ps(_mm_sub_ps(x10, x00), ty));
+	__m128 y1 = _mm_add_ps(x01, _mm_mul_ps(_mm_sub_ps(x11, x01), ty));
+	__m128 r = _mm_add_ps(y0, _mm_mul_ps(_mm_sub_ps(y1, y0), tz));
+	float out[4];
+	_mm_storeu_ps(out, r);
+	return glm::vec3(out[0], out[1], out[2]);
+#else
+	int i[3];
+	float t[3];
+	for (int a = 0; a < 3; a++)
+	{
+		float f = (p[a] - origin[a]) * invCellSize[a];
+		f = min(max(f, 0.0f), (float)(dims[a] - 1));
+		i[a] = min((int)f, dims[a] - 2);
+		t[a] = f - i[a];
+	}
+	const float *c = &cells[i[2] * dz + i[1] * dy + i[0] * dx];
+
+	float out[3];
+	for (int k = 0; k < 3; k++)
+	{
+		float x00 = c[k] + (c[dx + k] - c[k]) * t[0];
+		float x10 = c[dy + k] + (c[dy + dx + k] - c[dy + k]) * t[0];
+		float x01 = c[dz + k] + (c[dz + dx + k] - c[dz + k]) * t[0];
+		float x11 = c[dz + dy + k] + (c[dz + dy + dx + k] - c[dz + dy + k]) * t[0];
+		float y0 = x00 + (x10 - x00) * t[1];
+		float y1 = x01 + (x11 - x01) * t[1];
+		out[k] = y0 + (y1 - y0) * t[2];
+	}
+	return glm::vec3(out[0], out[1], out[2]);
+#endif
+}
+
+void GridForce::updateForce(Particle * particle)
+{
+	particle->forces += sample(particle->position);
+}
+
+//  Divergence free noise: the curl of three noise potentials, by central
+//  differences (18 noise lookups).  Particles swirl in it without bunching
+//  up.  time moves through the 4th noise dimension.
+//
+glm::vec3 GridForce::curlNoise(const glm::vec3 & p, float frequency, float time)
+{
+	const float e = .1;
+	glm::vec3 q = p * frequency;
+	auto potential = [time](const glm::vec3 & v) {
+		return glm::vec3(ofSignedNoise(v.x, v.y, v.z, time),
+			ofSignedNoise(v.y + 31.4, v.z - 12.9, v.x + 7.3, time),
+			ofSignedNoise(v.z - 23.1, v.x + 17.7, v.y - 5.1, time));
+	};
+	glm::vec3 dx = potential(q + glm::vec3(e, 0, 0)) - potential(q - glm::vec3(e, 0, 0));
+	glm::vec3 dy = potential(q + glm::vec3(0, e, 0)) - potential(q - glm::vec3(0, e, 0));
+	glm::vec3 dz = potential(q + glm::vec3(0, 0, e)) - potential(q - glm::vec3(0, 0, e));
+	return glm::vec3(dy.z - dz.y, dz.x - dx.z, dx.y - dy.x) / (2 * e);
+}
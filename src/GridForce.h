@@ -0,0 +1,59 @@
+#pragma once
+
+#include "ofMain.h"
+#include "ParticleSystem.h"
+#include "box.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GRID_FORCE_SSE 1
+#endif
+
+//  A force field baked into a 3D grid.  bake() evaluates a field function
+//  at every grid node once, and particles then take the trilinear blend
+//  of the 8 nodes around them (one SSE lerp per pair of nodes, the vectors
+//  are stored 4 floats wide), so the cost per particle is the same for any
+//  field.  Outside the bounds the nearest node on the edge applies.  A
+//  field of time is baked again by refresh() once refreshInterval has
+//  passed, instead of every frame:
+//
+//      GridForce wind;
+//      wind.bake(bounds, 32, 16, 32, [](const glm::vec3 & p, float t) {
+//          return GridForce::curlNoise(p, .05, t) * 20; });
+//      wind.refreshInterval = .25;
+//      sys->addForce(&wind);
+//      ...
+//      wind.refresh(ofGetElapsedTimef());     // once a frame
+//
+//  Baking a ParticleForce probes it with a particle of mass 1, so forces
+//  proportional to mass (gravity) are baked per unit mass.
+//
+class GridForce : public ParticleForce
+{
+public:
+	typedef function<glm::vec3(const glm::vec3 & position, float time)> Field;
+
+	void bake(const Box & bounds, int nx, int ny, int nz, Field field, float time = 0);
+	void bake(const Box & bounds, int nx, int ny, int nz, ParticleForce *force);
+	bool refresh(float time);
+	glm::vec3 sample(const glm::vec3 & p) const;
+	glm::vec3 node(int x, int y, int z) const;
+	glm::vec3 nodePosition(int x, int y, int z) const;
+	void updateForce(Particle *);
+	size_t bytes() const { return cells.size() * sizeof(float); }
+
+	static glm::vec3 curlNoise(const glm::vec3 & p, float frequency, float time = 0);
+
+	float refreshInterval = 0;     // sec, 0 = baked once
+	float bakedAt = 0;
+	int dims[3] = { 0, 0, 0 };
+	Box bounds;
+
+private:
+	void evaluate(float time);
+
+	Field field;
+	glm::vec3 origin;
+	glm::vec3 cellSize;
+	glm::vec3 invCellSize;
+	vector<float> cells;           // x, y, z, 0 per node, x fastest
+};
@@ -0,0 +1,31 @@
+#include "HeadlessTools.h"
+#include "Benchmark.h"
+#include "InputRecorder.h"
+#include "BatchSim.h"
+#include "MeshCache.h"
+#include "TiledTerrain.h"
+
+bool HeadlessTools::handles(const vector<string> & args)
+{
+	static const char *modes[] = { "--bench", "--bench-compare", "--replay", "--batch", "--mesh-load", "--tiles" };
+	for (int i = 0; i < sizeof(modes) / sizeof(modes[0]); i++)
+		if (args.size() > 0 && args[0] == modes[i]) return true;
+	return false;
+}
+
+int HeadlessTools::main(const vector<string> & args)
+{
+	if (args.size() > 0 && (args[0] == "--bench" || args[0] == "--bench-compare"))
+		return Benchmark::main(args);
+	if (args.size() > 0 && args[0] == "--replay")
+		return InputReplay::main(args);
+	if (args.size() > 0 && args[0] == "--batch")
+		return BatchSim::main(args);
+	if (args.size() > 0 && args[0] == "--mesh-load")
+		return MeshCache::main(args);
+	if (args.size() > 0 && args[0] == "--tiles")
+		return TiledTerrain::main(args);
+
+	cout << "usage: --bench | --bench-compare | --replay | --batch | --mesh-load | --tiles ..." << endl;
+	return 2;
+}
@@ -0,0 +1,15 @@
+#pragma once
+#include "ofMain.h"
+
+//  The command line modes that run without a window: --bench,
+//  --bench-compare, --replay, --batch, --mesh-load and --tiles.  The app's
+//  main() hands them over here before it opens one, and the landertools
+//  executable (CMakeLists.txt) runs nothing else, linked against the
+//  landersim library instead of the app.
+//
+class HeadlessTools
+{
+public:
+	static bool handles(const vector<string> & args);
+	static int main(const vector<string> & args);
+};
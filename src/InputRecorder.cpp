@@ -0,0 +1,212 @@
+#include "InputRecorder.h"
+#include "MeshCache.h"
+#include <chrono>
+
+static const unsigned char TickThrust = 1 << 0;
+static const unsigned char TickForward = 1 << 1;
+static const unsigned char TickLeft = 1 << 2;
+static const unsigned char TickBack = 1 << 3;
+static const unsigned char TickRight = 1 << 4;
+static const unsigned char TickSliders = 1 << 5;   // three floats follow
+
+//  FNV-1a over the vertex positions, a recording is only valid against the
+//  terrain it was made on
+//
+uint64_t InputRecorder::terrainHash(const glm::vec3 *vertices, int numVertices)
+{
+	uint64_t h = 14695981039346656037ULL;
+	const unsigned char* bytes = (const unsigned char*)vertices;
+	size_t size = numVertices * sizeof(glm::vec3);
+	for (size_t i = 0; i < size; i++)
+	{
+		h ^= bytes[i];
+		h *= 1099511628211ULL;
+	}
+	return h;
+}
+
+bool InputRecorder::start(const string & path, const LanderSim & sim, float dt, int numLevels, const Octree & terrain)
+{
+	out.open(path, ios::binary);
+	if (!out.is_open())
+	{
+		cout << "can't record to " << path << endl;
+		return false;
+	}
+	header = RecordingHeader();
+	header.dt = dt;
+	header.numLevels = numLevels;
+	header.terrainVertices = (uint32_t)terrain.numVertices;
+	header.terrainHash = terrainHash(terrain.numVertices > 0 ? &terrain.vertex(0) : NULL, terrain.numVertices);
+	header.startingPosition = sim.startingPosition;
+	header.startScore = sim.score;
+	out.write((const char*)&header, sizeof(header));
+
+	// force the sliders into the first tick
+	//
+	gravity = magnitude = restitution = -1;
+	cout << "recording input to " << path << endl;
+	return true;
+}
+
+//  call once per tick with the input about to be passed to sim.step()
+//
+void InputRecorder::record(const LanderInput & input, const LanderSim & sim)
+{
+	if (!recording()) return;
+
+	unsigned char bits = 0;
+	if (input.thrust) bits |= TickThrust;
+	if (input.forward) bits |= TickForward;
+	if (input.left) bits |= TickLeft;
+	if (input.back) bits |= TickBack;
+	if (input.right) bits |= TickRight;
+
+	bool changed = sim.gravity != gravity || sim.magnitude != magnitude || sim.restitution != restitution;
+	if (changed) bits |= TickSliders;
+	out.put(bits);
+	if (changed)
+	{
+		gravity = sim.gravity;
+		magnitude = sim.magnitude;
+		restitution = sim.restitution;
+		out.write((const char*)&gravity, sizeof(float));
+		out.write((const char*)&magnitude, sizeof(float));
+		out.write((const char*)&restitution, sizeof(float));
+	}
+	header.tickCount++;
+}
+
+//  finish the file, the header is rewritten with the tick count and the
+//  hash of the state the run ended in
+//
+bool InputRecorder::stop(const LanderSim & sim)
+{
+	if (!recording()) return false;
+	header.finalHash = sim.stateHash();
+	out.seekp(0);
+	out.write((const char*)&header, sizeof(header));
+	out.close();
+	cout << "recorded " << header.tickCount << " ticks, final state " << hex << header.finalHash << dec << endl;
+	return true;
+}
+
+bool InputReplay::load(const string & path)
+{
+	ticks.clear();
+	cursor = 0;
+	ofBuffer buffer = ofBufferFromFile(path, true);
+	if (buffer.size() < sizeof(RecordingHeader))
+	{
+		cout << "no recording in " << path << endl;
+		return false;
+	}
+	const char* data = buffer.getData();
+	memcpy(&header, data, sizeof(header));
+	if (memcmp(header.magic, "LLIR", 4) != 0 || header.version != 1)
+	{
+		cout << path << " is not an input recording" << endl;
+		return false;
+	}
+
+	size_t pos = sizeof(header);
+	RecordedTick tick;
+	tick.gravity = tick.magnitude = tick.restitution = 0;
+	ticks.reserve(header.tickCount);
+	while (pos < buffer.size() && ticks.size() < header.tickCount)
+	{
+		unsigned char bits = data[pos++];
+		tick.input.thrust = (bits & TickThrust) != 0;
+		tick.input.forward = (bits & TickForward) != 0;
+		tick.input.left = (bits & TickLeft) != 0;
+		tick.input.back = (bits & TickBack) != 0;
+		tick.input.right = (bits & TickRight) != 0;
+		if (bits & TickSliders)
+		{
+			if (pos + 3 * sizeof(float) > buffer.size()) break;
+			memcpy(&tick.gravity, data + pos, sizeof(float));
+			memcpy(&tick.magnitude, data + pos + 4, sizeof(float));
+			memcpy(&tick.restitution, data + pos + 8, sizeof(float));
+			pos += 3 * sizeof(float);
+		}
+		ticks.push_back(tick);
+	}
+	if (ticks.size() != header.tickCount)
+	{
+		cout << path << " is truncated, " << ticks.size() << " of " << header.tickCount << " ticks" << endl;
+		return false;
+	}
+	return true;
+}
+
+//  put the simulation in the state the recording started from
+//
+void InputReplay::begin(LanderSim & sim)
+{
+	cursor = 0;
+	sim.startingPosition = header.startingPosition;
+	sim.score = header.startScore;
+	sim.reset();
+}
+
+//  input and sliders for the next tick, false once the recording is used up
+//
+bool InputReplay::next(LanderInput & input, LanderSim & sim)
+{
+	if (done()) return false;
+	const RecordedTick & tick = ticks[cursor++];
+	input = tick.input;
+	sim.gravity = tick.gravity;
+	sim.magnitude = tick.magnitude;
+	sim.restitution = tick.restitution;
+	return true;
+}
+
+bool InputReplay::check(const LanderSim & sim) const
+{
+	uint64_t h = sim.stateHash();
+	if (h == header.finalHash)
+		cout << "replay matches recording (" << hex << h << dec << ")" << endl;
+	else
+		cout << "replay DIVERGED, state " << hex << h << " expected " << header.finalHash << dec << endl;
+	return h == header.finalHash;
+}
+
+int InputReplay::main(const vector<string> & args)
+{
+	if (args.size() < 2)
+	{
+		cout << "usage: --replay file.rec [--terrain geo/Moon500.obj]" << endl;
+		return 2;
+	}
+	string terrainPath = "geo/Moon500.obj";
+	for (int i = 2; i + 1 < args.size(); i++)
+		if (args[i] == "--terrain") terrainPath = args[i + 1];
+
+	InputReplay replay;
+	if (!replay.load(args[1])) return 2;
+
+	MeshCache terrain;
+	if (!terrain.openObj(ofToDataPath(terrainPath))) return 2;
+	const MeshView & mesh = terrain.view;
+	if (mesh.numVertices != replay.header.terrainVertices || InputRecorder::terrainHash(mesh.vertices, mesh.numVertices) != replay.header.terrainHash)
+		cout << "warning: terrain differs from the one the recording was made on" << endl;
+
+	Octree tree;
+	tree.create(mesh, replay.header.numLevels);
+	LanderSim sim;
+	sim.setTerrain(&tree);
+	LandingSites sites;
+	if (sites.load(ofToDataPath("landing_sites.txt")))
+		sim.setSites(&sites);
+	replay.begin(sim);
+
+	chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+	LanderInput input;
+	while (replay.next(input, sim))
+		sim.step(input, replay.header.dt);
+	double seconds = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+
+	cout << replay.ticks.size() << " ticks in " << seconds * 1000 << " ms (" << replay.ticks.size() / seconds << " ticks/sec)" << endl;
+	return replay.check(sim) ? 0 : 1;
+}
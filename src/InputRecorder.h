@@ -0,0 +1,69 @@
+#pragma once
+#include "ofMain.h"
+#include "LanderSim.h"
+
+//  Recording of the inputs and slider values fed to LanderSim, one entry per
+//  fixed simulation tick (the tick number is the timestamp).  Replaying a
+//  recording against the same terrain reproduces the run exactly, and the
+//  final state hash stored at the end of the recording checks that it did.
+//
+//  File layout (little endian): RecordingHeader, then one byte per tick with
+//  the thruster bits, followed by gravity, magnitude and restitution as three
+//  floats on the ticks where the sliders changed.
+//
+struct RecordingHeader
+{
+	char magic[4] = { 'L', 'L', 'I', 'R' };
+	uint32_t version = 1;
+	float dt = 0;
+	int32_t numLevels = 0;
+	uint32_t terrainVertices = 0;
+	uint64_t terrainHash = 0;
+	glm::vec3 startingPosition;
+	int32_t startScore = 0;
+	uint32_t tickCount = 0;
+	uint64_t finalHash = 0;
+};
+
+struct RecordedTick
+{
+	LanderInput input;
+	float gravity;
+	float magnitude;
+	float restitution;
+};
+
+class InputRecorder
+{
+public:
+	static uint64_t terrainHash(const glm::vec3 *vertices, int numVertices);
+
+	bool start(const string & path, const LanderSim & sim, float dt, int numLevels, const Octree & terrain);
+	void record(const LanderInput & input, const LanderSim & sim);
+	bool stop(const LanderSim & sim);
+	bool recording() const { return out.is_open(); }
+
+private:
+	ofstream out;
+	RecordingHeader header;
+	float gravity, magnitude, restitution;
+};
+
+class InputReplay
+{
+public:
+	bool load(const string & path);
+	void begin(LanderSim & sim);
+	bool next(LanderInput & input, LanderSim & sim);
+	bool done() const { return cursor >= ticks.size(); }
+	bool check(const LanderSim & sim) const;
+	bool active = false;
+
+	// headless, unthrottled replay:  --replay file.rec [--terrain geo/Moon500.obj]
+	//
+	static int main(const vector<string> & args);
+
+	RecordingHeader header;
+	vector<RecordedTick> ticks;
+	size_t cursor = 0;
+};
@@ -0,0 +1,218 @@
+#include "LanderBatch.h"
+#include "Parallel.h"
+#include "Profiler.h"
+#include "PerfCounters.h"
+
+void LanderBatch::resize(int n)
+{
+	px.assign(n, 0); py.assign(n, 0); pz.assign(n, 0);
+	vx.assign(n, 0); vy.assign(n, 0); vz.assign(n, 0);
+	fx.assign(n, 0); fy.assign(n, 0); fz.assign(n, 0);
+	height.assign(n, 0);
+	status.assign(n, LanderFlying);
+	padFeet.assign(n * sites->numPads(), 0);
+	bounces.assign(n, 0);
+	cursors.assign(n * 2, OctreeCursor());
+	columns.assign(n, Column());
+	resetAll();
+}
+
+void LanderBatch::reset(int i, const glm::vec3 & start)
+{
+	px[i] = start.x; py[i] = start.y; pz[i] = start.z;
+	vx[i] = vy[i] = vz[i] = 0;
+	fx[i] = fy[i] = fz[i] = 0;
+	height[i] = 0;
+	status[i] = LanderFlying;
+	fill(padFeet.begin() + i * sites->numPads(), padFeet.begin() + (i + 1) * sites->numPads(), 0);
+	bounces[i] = 0;
+}
+
+void LanderBatch::resetAll()
+{
+	for (int i = 0; i < size(); i++)
+		reset(i);
+}
+
+void LanderBatch::observe(int i, float *obs) const
+{
+	obs[0] = px[i]; obs[1] = py[i]; obs[2] = pz[i];
+	obs[3] = vx[i]; obs[4] = vy[i]; obs[5] = vz[i];
+	obs[6] = height[i];
+}
+
+void LanderBatch::step(const LanderInput *inputs, float dt, float *obs, float *rewards, unsigned char *dones)
+{
+	PROFILE_SCOPE("LanderBatch::step");
+
+	// landers are independent, so big batches are split across threads in
+	// chunks large enough to keep the scheduling cost out of the way
+	//
+	const int chunk = 256;
+	int n = size();
+	int numChunks = (n + chunk - 1) / chunk;
+	if (numThreads == 1 || numChunks <= 1)
+	{
+		stepRange(0, n, inputs, dt, obs, rewards, dones);
+		return;
+	}
+	Parallel::forEach(numChunks, [&](int c, int thread) {
+		stepRange(c * chunk, min(n, (c + 1) * chunk), inputs, dt, obs, rewards, dones);
+	}, numThreads);
+}
+
+void LanderBatch::stepRange(int begin, int end, const LanderInput *inputs, float dt, float *obs, float *rewards, unsigned char *dones)
+{
+	for (int i = begin; i < end; i++)
+	{
+		float reward = 0;
+		bool ended = false;
+		if (status[i] == LanderFlying && tree != NULL)
+		{
+			// thrust as LanderSim adds it, one impulse per key on top of
+			// whatever is still pending from steps spent on the ground
+			//
+			const LanderInput & in = inputs[i];
+			if (in.thrust) fy[i] += magnitude;
+			if (in.forward) fz[i] -= magnitude;
+			if (in.left) fx[i] -= magnitude;
+			if (in.back) fz[i] += magnitude;
+			if (in.right) fx[i] += magnitude;
+
+			// where the lander would be after this step, integration moves
+			// the position with the old velocity so the forces don't matter
+			//
+			glm::vec3 next(px[i] + vx[i] * dt, py[i] + vy[i] * dt, pz[i] + vz[i] * dt);
+
+			// LanderSim probes each of these two leg points twice
+			//
+			glm::vec3 collDist = glm::vec3(10000, 10000, 10000);
+			if (probe(i, 0, next + glm::vec3(2.8, 0, 0), collDist) || probe(i, 1, next + glm::vec3(0, 0, 2.8), collDist))
+			{
+				glm::vec3 v(vx[i], vy[i], vz[i]);
+				if (glm::length(v) > crashSpeed)
+				{
+					status[i] = LanderCrashed;
+					reward = -crashPenalty;
+					ended = true;
+				}
+				else
+				{
+					int feetCount = sites->scoreFeet(next, &padFeet[i * sites->numPads()]);
+					if (feetCount > 0)
+					{
+						status[i] = LanderLanded;
+						reward = feetCount;
+						ended = true;
+					}
+					else
+					{
+						glm::vec3 n = glm::normalize(collDist);
+						glm::vec3 impulse = (restitution) * (glm::dot(-1 * v, n)) * n;
+						vx[i] = impulse.x; vy[i] = impulse.y; vz[i] = impulse.z;
+						bounces[i]++;
+					}
+				}
+			}
+			else
+			{
+				// gravity then the pending thrust, integrated as Particle::integrate
+				//
+				float ax = 0 + fx[i];
+				float ay = -1 * gravity + fy[i];
+				float az = 0 + fz[i];
+				px[i] = next.x; py[i] = next.y; pz[i] = next.z;
+				vx[i] = (vx[i] + ax * dt) * damping;
+				vy[i] = (vy[i] + ay * dt) * damping;
+				vz[i] = (vz[i] + az * dt) * damping;
+				fx[i] = fy[i] = fz[i] = 0;
+				height[i] = heightBelow(i, next);
+			}
+		}
+
+		if (rewards) rewards[i] = reward;
+		if (dones) dones[i] = ended;
+		if (ended && autoReset) reset(i);
+		if (obs) observe(i, obs + i * ObsSize);
+	}
+}
+
+bool LanderBatch::probe(int i, int leg, const glm::vec3 & p, glm::vec3 & collDist)
+{
+	return tree->intersect(p, &collDist, cursors[i * 2 + leg]);
+}
+
+//  the search of Octree::heightBelow, returning the leaf: the first one in
+//  child order whose column holds p
+//
+static const TreeNode *leafBelow(const TreeNode & node, const glm::vec3 & p)
+{
+	const glm::vec3 & lo = node.box.parameters[0];
+	const glm::vec3 & hi = node.box.parameters[1];
+	if (!(p.x > lo.x && p.x < hi.x && p.z >= lo.z && p.z <= hi.z &&
+		-(hi.y - p.y) < 1000 && -(lo.y - p.y) > -1000)) return NULL;
+	if (node.children.size() == 0) return &node;
+	for (int i = 0; i < node.children.size(); i++)
+	{
+		const TreeNode *leaf = leafBelow(node.children[i], p);
+		if (leaf) return leaf;
+	}
+	return NULL;
+}
+
+//  whether a leaf before leaf in child order has an xz extent that
+//  overlaps the inside of leaf's, the search stops at leaf
+//
+static bool overlappedBefore(const TreeNode & node, const TreeNode & leaf, bool & reached)
+{
+	const Box & a = node.box;
+	const Box & b = leaf.box;
+	if (a.parameters[0].x >= b.parameters[1].x || a.parameters[1].x <= b.parameters[0].x ||
+		a.parameters[0].z >= b.parameters[1].z || a.parameters[1].z <= b.parameters[0].z) return false;
+	if (&node == &leaf)
+	{
+		reached = true;
+		return false;
+	}
+	if (node.children.size() == 0) return true;
+	for (int i = 0; i < node.children.size() && !reached; i++)
+		if (overlappedBefore(node.children[i], leaf, reached)) return true;
+	return false;
+}
+
+//  Octree::heightBelow(p).  The tree's answer is the first leaf in child
+//  order whose column holds p, so while p stays strictly inside the column
+//  of a leaf that no earlier leaf overlaps the answer can't change and the
+//  search is skipped.  That also needs p's height to keep every node
+//  within the search's 1000 unit reach, which holds when it is within that
+//  of the root's bottom and top.
+//
+float LanderBatch::heightBelow(int i, const glm::vec3 & p)
+{
+	const glm::vec3 far(-1000, -1000, -1000);
+	const Box & root = tree->root.box;
+	if (p.y - root.parameters[0].y >= 1000 || p.y - root.parameters[1].y <= -1000)
+		return tree->heightBelow(p);
+
+	Column & c = columns[i];
+	if (c.tree != tree || c.version != tree->version ||
+		!(p.x > c.lo.x && p.x < c.hi.x && p.z > c.lo.y && p.z < c.hi.y))
+	{
+		PerfCounters::add(CounterOctreeQueries);
+		c.tree = tree;
+		c.version = tree->version;
+		c.lo = c.hi = glm::vec2(0, 0);
+		const TreeNode *leaf = leafBelow(tree->root, p);
+		if (!leaf) return 99999;
+		c.center = leaf->box.center();
+		bool reached = false;
+		if (!overlappedBefore(tree->root, *leaf, reached))
+		{
+			c.lo = glm::vec2(leaf->box.parameters[0].x, leaf->box.parameters[0].z);
+			c.hi = glm::vec2(leaf->box.parameters[1].x, leaf->box.parameters[1].z);
+		}
+	}
+	if (glm::length(far - p) > glm::length(c.center - p))
+		return glm::length(p - c.center);
+	return glm::length(p - far);
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include "ofMain.h"
+#include "LanderSim.h"
+
+//  Many landers stepped together for controller training.  The state of all
+//  landers lives in contiguous arrays (structure of arrays) and one step()
+//  applies N inputs, integrates, probes the legs against the terrain and
+//  writes N observations and rewards.  Physics, scoring and bounce are the
+//  same as LanderSim, without its ParticleSystem and per lander force
+//  lists, and the landers can be split over threads.
+//
+//  The terrain queries, which are most of a step, keep per lander state
+//  between steps: a cursor for each probed leg, and the leaf column the
+//  height was last measured in.  A lander that is still over a leaf that
+//  no earlier leaf overlaps gets its height without searching the tree.
+//
+//  Observation per lander (ObsSize floats): position xyz, velocity xyz and
+//  height above the terrain below.  Reward is the landing score (feet on a
+//  pad) on the step the lander lands, -crashPenalty on the step it crashes,
+//  0 otherwise.
+//
+class LanderBatch
+{
+public:
+	static const int ObsSize = 7;
+
+	void resize(int n);
+	int size() const { return (int)px.size(); }
+	void setTerrain(const Octree *t) { tree = t; }
+	void reset(int i) { reset(i, startingPosition); }
+	void reset(int i, const glm::vec3 & start);
+	void resetAll();
+
+	// inputs, rewards and dones hold size() entries, obs holds size() * ObsSize,
+	// any output may be NULL
+	//
+	void step(const LanderInput *inputs, float dt, float *obs, float *rewards, unsigned char *dones = NULL);
+	void observe(int i, float *obs) const;
+	glm::vec3 position(int i) const { return glm::vec3(px[i], py[i], pz[i]); }
+	glm::vec3 velocity(int i) const { return glm::vec3(vx[i], vy[i], vz[i]); }
+
+	// tunables shared by all landers, same meaning as in LanderSim
+	//
+	float gravity = 2.5;
+	float magnitude = 5;
+	float restitution = .5;
+	float crashSpeed = 15;
+	float damping = .9999;
+	float crashPenalty = 10;
+	glm::vec3 startingPosition = glm::vec3(0, 20, 0);
+
+	// landers that land or crash start over within the same step (their
+	// observation is the new start), dones still reports the ending
+	//
+	bool autoReset = false;
+	int numThreads = 1;      // 0 = one per core
+
+	const Octree *tree = NULL;
+	const LandingSites *sites = &LandingSites::defaults();   // set before resize()
+
+	// lander state
+	//
+	vector<float> px, py, pz;
+	vector<float> vx, vy, vz;
+	vector<float> fx, fy, fz;    // thrust carried over from steps that touched the terrain
+	vector<float> height;
+	vector<unsigned char> status;   // LanderStatus
+	vector<int> padFeet;            // sites->numPads() per lander
+	vector<int> bounces;
+
+private:
+	// the leaf Octree::heightBelow found for a lander last, lo and hi are
+	// its xz extent, empty when an earlier leaf overlaps it
+	//
+	struct Column
+	{
+		const Octree *tree = NULL;
+		unsigned int version = 0;
+		glm::vec2 lo, hi;
+		glm::vec3 center;
+	};
+
+	void stepRange(int begin, int end, const LanderInput *inputs, float dt, float *obs, float *rewards, unsigned char *dones);
+	bool probe(int i, int leg, const glm::vec3 & p, glm::vec3 & collDist);
+	float heightBelow(int i, const glm::vec3 & p);
+
+	vector<OctreeCursor> cursors;   // two per lander, one per probed leg
+	vector<Column> columns;
+};
@@ -0,0 +1,212 @@
+#include "LanderSim.h"
+#include "Profiler.h"
+#include "PerfCounters.h"
+
+LanderSim::LanderSim()
+{
+	Particle p;
+	p.lifespan = -1;
+	p.damping = .9999;
+	p.position = startingPosition;
+
+	gravityForce.set(glm::vec3(0, -1 * gravity, 0));
+
+	landerSystem.add(p);
+	landerSystem.addForce(&gravityForce);
+	padFeet.assign(sites->numPads(), 0);
+}
+
+void LanderSim::setSites(const LandingSites *s)
+{
+	sites = s;
+	padFeet.assign(sites->numPads(), 0);
+}
+
+//  put the lander back at the start, the score is kept across restarts.
+//  Thrust queued on the tick the lander hit the terrain was never applied
+//  (step() returns before the update), so it is dropped with any one shot
+//  forces, and a reset sim steps the same as a new one.
+//
+void LanderSim::reset()
+{
+	lander().position = startingPosition;
+	lander().velocity = glm::vec3(0, 0, 0);
+	lander().forces = glm::vec3(0, 0, 0);
+
+	landerSystem.impulses.clear();
+	vector<ParticleForce *> & forces = landerSystem.forces;
+	for (int i = 0; i < forces.size(); i++)
+	{
+		if (forces[i]->applyOnce)
+		{
+			delete forces[i];
+			forces.erase(forces.begin() + i);
+			i--;
+			PerfCounters::add(CounterForcesDeleted);
+		}
+	}
+	landerSystem.reset();
+
+	message = "";
+	status = LanderFlying;
+	padFeet.assign(sites->numPads(), 0);
+	bounces = 0;
+	bEnded = false;
+}
+
+//  FNV-1a hash of the lander state and game flags, two runs that took the
+//  same inputs must end with the same hash
+//
+uint64_t LanderSim::stateHash() const
+{
+	uint64_t h = 14695981039346656037ULL;
+	auto mix = [&h](const void* data, size_t size) {
+		const unsigned char* bytes = (const unsigned char*)data;
+		for (size_t i = 0; i < size; i++)
+		{
+			h ^= bytes[i];
+			h *= 1099511628211ULL;
+		}
+	};
+	mix(&lander().position, sizeof(glm::vec3));
+	mix(&lander().velocity, sizeof(glm::vec3));
+	mix(&score, sizeof(score));
+	mix(&bEnded, sizeof(bEnded));
+	return h;
+}
+
+//  sweep the feet the point test checks from the lander's position to p's.
+//  On contact the lander is moved up to the time of impact and p to where
+//  it touched, so scoring and the bounce happen at the contact.  A foot
+//  that starts the step in contact (after a bounce) is only tested where
+//  it ends up, as the point test does, so it can leave the terrain.
+//
+bool LanderSim::sweepFeet(Particle & p, glm::vec3 & collDist)
+{
+	glm::vec3 feet[2] = { glm::vec3(2.8, 0, 0), glm::vec3(0, 0, 2.8) };
+	float first = 2;
+	for (int k = 0; k < 2; k++)
+	{
+		SweepHit h;
+		if (!tree->sweep(lander().position + feet[k], p.position + feet[k], 0, h) || h.t >= first) continue;
+		if (h.t > 0)
+		{
+			first = h.t;
+			collDist = h.normal;
+		}
+		else
+		{
+			glm::vec3 norm = glm::vec3(10000, 10000, 10000);
+			if (!tree->intersect(p.position + feet[k], &norm, footCursors[k])) continue;
+			first = 0;
+			collDist = norm;
+		}
+	}
+	if (first > 1) return false;
+
+	// the lander stays where it was, as with the point test, when the
+	// contact is at the start
+	//
+	if (first > 0)
+	{
+		p.position = glm::mix(lander().position, p.position, first);
+		lander().position = p.position;
+	}
+	return true;
+}
+
+//  advance the simulation by dt seconds.  Returns true if the lander moved
+//  freely this step, false if it touched the terrain (or the game is over).
+//
+bool LanderSim::step(const LanderInput & input, float dt)
+{
+	PROFILE_SCOPE("LanderSim::step");
+
+	if (bEnded || tree == NULL) return false;
+
+	gravityForce.set(glm::vec3(0, -1 * gravity, 0));
+
+	//add forces control, the same forces ImpulseForce(magnitude, dir) adds
+	if (input.thrust)
+		landerSystem.addImpulse(glm::vec3(0, 1, 0) * magnitude);
+	if (input.forward)
+		landerSystem.addImpulse(glm::vec3(0, 0, -1) * magnitude);
+	if (input.left)
+		landerSystem.addImpulse(glm::vec3(-1, 0, 0) * magnitude);
+	if (input.back)
+		landerSystem.addImpulse(glm::vec3(0, 0, 1) * magnitude);
+	if (input.right)
+		landerSystem.addImpulse(glm::vec3(1, 0, 0) * magnitude);
+
+	//get the location the lander particle would be at if updated
+	Particle p = lander();
+	landerSystem.test(&p, dt);
+
+	//check if any of the lander's feet hit the landing area
+	glm::vec3 collDist = glm::vec3(10000, 10000, 10000);
+
+	bool hit;
+	if (continuous)
+		hit = sweepFeet(p, collDist);
+	else
+		hit = tree->intersect(p.position + glm::vec3(2.8, 0, 0), &collDist, footCursors[0]) ||
+			tree->intersect(p.position + glm::vec3(2.8, 0, 0), &collDist, footCursors[0]) ||
+			tree->intersect(p.position + glm::vec3(0, 0, 2.8), &collDist, footCursors[1]) ||
+			tree->intersect(p.position + glm::vec3(0, 0, 2.8), &collDist, footCursors[1]);
+	if (hit)
+	{
+		if (glm::length(lander().velocity) > crashSpeed)
+		{
+			bEnded = true;
+			status = LanderCrashed;
+			message = "Your ship is broken. Be careful!";
+			score = 0;
+		}
+		else
+		{
+			//if any are, check if they are inside the landing area
+			int feetCount = sites->scoreFeet(p.position, padFeet.data());
+
+			//Getting points with feets landing
+			if (feetCount > 0)
+			{
+				score += feetCount;
+				bEnded = true;
+				status = LanderLanded;
+				switch (feetCount)
+				{
+				case 1:
+					message = "Emm, try harder!";
+					break;
+				case 2:
+					message = "Not bad!";
+					break;
+				case 3:
+					message = "Almost Pecfect, Keep Working!";
+					break;
+				default:
+					message = "Perfect Landing!";
+					break;
+				}
+			}
+			else
+			{
+				//if none of the feet are in the landing zone, bounce the lander
+				glm::vec3 n = glm::normalize(collDist);
+				glm::vec3 impulse = (restitution) * (glm::dot(-1 * lander().velocity, n)) * n;
+
+				lander().velocity = impulse;
+				bounces++;
+			}
+		}
+		return false;
+	}
+
+	//update the particle position
+	landerSystem.update(dt);
+
+	//height above the terrain straight below the lander
+	dist = tree->heightBelow(lander().position);
+
+	return true;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "Octree.h"
+#include "LandingSites.h"
+#include "ParticleSystem.h"
+
+//  Thrusters firing during one simulation step.
+//
+struct LanderInput
+{
+	bool thrust = false;    // main engine (space)
+	bool forward = false;   // -z (up arrow)
+	bool left = false;      // -x (left arrow)
+	bool back = false;      // +z (down arrow)
+	bool right = false;     // +x (right arrow)
+};
+
+typedef enum { LanderFlying, LanderCrashed, LanderLanded } LanderStatus;
+
+//  Headless lander simulation: thrust and gravity, terrain collision through
+//  the Octree, landing zone scoring and bounce.  It has no window, GL or
+//  sound dependencies, so it can be stepped by the app or run on its own.
+//  The terrain is only read, so any number of LanderSims can share one
+//  Octree across threads.
+//
+class LanderSim
+{
+public:
+	LanderSim();
+	LanderSim(const LanderSim &) = delete;            // landerSystem points at gravityForce
+	LanderSim & operator=(const LanderSim &) = delete;
+	void setTerrain(const Octree *t) { tree = t; }
+	void setSites(const LandingSites *s);
+	void reset();
+	bool step(const LanderInput & input, float dt);
+	uint64_t stateHash() const;
+	bool sweepFeet(Particle & p, glm::vec3 & collDist);
+	Particle & lander() { return landerSystem.particles[0]; }
+	const Particle & lander() const { return landerSystem.particles[0]; }
+
+	// tunables, the app copies its sliders in here before each step
+	//
+	float gravity = 2.5;
+	float magnitude = 5;
+	float restitution = .5;
+	float crashSpeed = 15;
+
+	// sweep the feet along the step with Octree::sweep instead of testing
+	// where they end up, so a large dt can't carry them through a ridge.
+	// Off by default, recordings replay with the point test they were made
+	// with.
+	//
+	bool continuous = false;
+
+	glm::vec3 startingPosition = glm::vec3(0, 20, 0);
+
+
+	ParticleSystem landerSystem;
+	GravityForce gravityForce;
+	SimRandom random;    // for the forces and emitters of this simulation, see SimSnapshot
+	const Octree *tree = NULL;
+	OctreeCursor footCursors[2];    // where each foot's last terrain query went
+	const LandingSites *sites = &LandingSites::defaults();
+
+	//state of the game
+	LanderStatus status = LanderFlying;
+	vector<int> padFeet;    // feet on each pad of sites at touchdown
+	int bounces = 0;
+	bool bEnded = false;
+	int score = 0;
+	float dist = 0;
+	string message = "";
+};
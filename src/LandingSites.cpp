@@ -0,0 +1,182 @@
+#include "LandingSites.h"
+
+//  the four feet, the orange pad used to be scored with the last one a unit
+//  higher (0, 0, -2.8), all pads now use the same feet
+//
+const glm::vec3 LandingSites::feet[4] = {
+	glm::vec3(2.8, -1, 0), glm::vec3(-2.8, -1, 0), glm::vec3(0, -1, 2.8), glm::vec3(0, -1, -2.8)
+};
+
+//  built once, on first use, LanderSims on any thread share it
+//
+static LandingSites makeDefaults()
+{
+	LandingSites sites;
+	LandingPad green, yellow, orange;
+	green.name = "green";
+	green.position = glm::vec3(-20, 1, 20);
+	green.color = ofColor(255, 250, 255, 200);
+	yellow.name = "yellow";
+	yellow.position = glm::vec3(120, 33, -73);
+	yellow.color = ofColor(150, 200, 100, 200);
+	orange.name = "orange";
+	orange.position = glm::vec3(40, -6, -10);
+	orange.color = ofColor(200, 100, 50, 200);
+	sites.add(green);
+	sites.add(yellow);
+	sites.add(orange);
+	sites.build();
+	return sites;
+}
+
+const LandingSites & LandingSites::defaults()
+{
+	static const LandingSites sites = makeDefaults();
+	return sites;
+}
+
+bool LandingSites::load(const string & path)
+{
+	ifstream in(path);
+	if (!in)
+	{
+		cout << "LandingSites: " << path << " not found" << endl;
+		return false;
+	}
+
+	pads.clear();
+	string line;
+	int lineNumber = 0;
+	while (getline(in, line))
+	{
+		lineNumber++;
+		size_t start = line.find_first_not_of(" \t\r");
+		if (start == string::npos || line[start] == '#') continue;
+
+		istringstream fields(line);
+		LandingPad pad;
+		int r = 255, g = 255, b = 255, a = 255;
+		if (!(fields >> pad.name >> pad.position.x >> pad.position.y >> pad.position.z >> pad.radius) || pad.radius <= 0)
+		{
+			cout << "LandingSites: " << path << " line " << lineNumber << ": expected name x y z radius [r g b a]" << endl;
+			pads.clear();
+			return false;
+		}
+		fields >> r >> g >> b >> a;
+		pad.color = ofColor(r, g, b, a);
+		pads.push_back(pad);
+	}
+	build();
+	return true;
+}
+
+//  add() doesn't index the pad, call build() once they are all in
+//
+void LandingSites::add(const LandingPad & pad)
+{
+	pads.push_back(pad);
+}
+
+void LandingSites::build()
+{
+	cellStart.clear();
+	cellPads.clear();
+	cols = rows = 0;
+	if (pads.empty()) return;
+
+	glm::vec2 lo(pads[0].position.x, pads[0].position.z), hi = lo;
+	float maxRadius = 0;
+	for (int i = 0; i < pads.size(); i++)
+	{
+		const LandingPad & p = pads[i];
+		lo.x = min(lo.x, p.position.x - p.radius);
+		lo.y = min(lo.y, p.position.z - p.radius);
+		hi.x = max(hi.x, p.position.x + p.radius);
+		hi.y = max(hi.y, p.position.z + p.radius);
+		maxRadius = max(maxRadius, p.radius);
+	}
+	cellSize = 2 * maxRadius;
+	origin = lo;
+	cols = (int)((hi.x - lo.x) / cellSize) + 1;
+	rows = (int)((hi.y - lo.y) / cellSize) + 1;
+
+	// count, prefix sum, fill
+	//
+	cellStart.assign(cols * rows + 1, 0);
+	for (int pass = 0; pass < 2; pass++)
+	{
+		vector<int> fill;
+		if (pass == 1)
+		{
+			for (int c = 0; c < cols * rows; c++) cellStart[c + 1] += cellStart[c];
+			cellPads.resize(cellStart[cols * rows]);
+			fill.assign(cellStart.begin(), cellStart.end() - 1);
+		}
+		for (int i = 0; i < pads.size(); i++)
+		{
+			const LandingPad & p = pads[i];
+			int x0 = (int)((p.position.x - p.radius - origin.x) / cellSize);
+			int x1 = min((int)((p.position.x + p.radius - origin.x) / cellSize), cols - 1);
+			int z0 = (int)((p.position.z - p.radius - origin.y) / cellSize);
+			int z1 = min((int)((p.position.z + p.radius - origin.y) / cellSize), rows - 1);
+			for (int z = z0; z <= z1; z++)
+			{
+				for (int x = x0; x <= x1; x++)
+				{
+					if (pass == 0) cellStart[z * cols + x + 1]++;
+					else cellPads[fill[z * cols + x]++] = i;
+				}
+			}
+		}
+	}
+}
+
+int LandingSites::score(const glm::vec3 *points, int n, int *padFeet) const
+{
+	int hits = 0;
+	for (int i = 0; i < n; i++)
+	{
+		const glm::vec3 & p = points[i];
+		float fx = (p.x - origin.x) / cellSize;
+		float fz = (p.z - origin.y) / cellSize;
+		if (fx < 0 || fz < 0 || fx >= cols || fz >= rows) continue;
+		int c = (int)fz * cols + (int)fx;
+		for (int k = cellStart[c]; k < cellStart[c + 1]; k++)
+		{
+			const LandingPad & pad = pads[cellPads[k]];
+			glm::vec3 d = p - pad.position;
+			if (glm::dot(d, d) < pad.radius * pad.radius)
+			{
+				padFeet[cellPads[k]]++;
+				hits++;
+			}
+		}
+	}
+	return hits;
+}
+
+int LandingSites::scoreFeet(const glm::vec3 & landerPosition, int *padFeet) const
+{
+	glm::vec3 points[4];
+	for (int k = 0; k < 4; k++)
+		points[k] = landerPosition + feet[k];
+	return score(points, 4, padFeet);
+}
+
+int LandingSites::scoreLinear(const glm::vec3 *points, int n, int *padFeet) const
+{
+	int hits = 0;
+	for (int i = 0; i < n; i++)
+	{
+		for (int k = 0; k < pads.size(); k++)
+		{
+			glm::vec3 d = points[i] - pads[k].position;
+			if (glm::dot(d, d) < pads[k].radius * pads[k].radius)
+			{
+				padFeet[k]++;
+				hits++;
+			}
+		}
+	}
+	return hits;
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include "ofMain.h"
+
+struct LandingPad
+{
+	string name;
+	glm::vec3 position;
+	float radius = 6;
+	ofColor color = ofColor::white;
+};
+
+//  Landing pads and the lander's feet scoring against them.  Pads are read
+//  from a text file, one per line,
+//
+//      # name   x    y    z    radius  r   g   b   a
+//      green   -20   1   20    6       255 250 255 200
+//
+//  and indexed in a grid over x and z with cells two pad radii wide, each
+//  cell listing the pads whose footprint overlaps it, so a contact point is
+//  only tested against the few pads of its own cell.  A point scores for
+//  every pad it is inside of (squared distance under radius squared).
+//
+class LandingSites
+{
+public:
+	static const LandingSites & defaults();   // the three pads the game shipped with
+	static const glm::vec3 feet[4];           // foot offsets from the lander position
+
+	bool load(const string & path);
+	void add(const LandingPad & pad);
+	void build();
+	int numPads() const { return (int)pads.size(); }
+
+	// add 1 to padFeet[k] for each point inside pad k, padFeet holds
+	// numPads() counts.  Returns the number of (point, pad) hits.
+	//
+	int score(const glm::vec3 *points, int n, int *padFeet) const;
+	int scoreFeet(const glm::vec3 & landerPosition, int *padFeet) const;
+
+	// the same test against every pad, for checking the grid
+	//
+	int scoreLinear(const glm::vec3 *points, int n, int *padFeet) const;
+
+	vector<LandingPad> pads;
+
+private:
+	float cellSize = 12;
+	glm::vec2 origin = glm::vec2(0, 0);
+	int cols = 0, rows = 0;
+	vector<int> cellStart;   // pads of cell c are cellPads[cellStart[c] .. cellStart[c + 1]]
+	vector<int> cellPads;
+};
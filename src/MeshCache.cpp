@@ -0,0 +1,275 @@
+#include "MeshCache.h"
+#include "MeshWeld.h"
+#include "ObjLoader.h"
+#include "Octree.h"
+#include <chrono>
+#include <iomanip>
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static_assert(sizeof(MeshCacheHeader) == 64, "mesh cache header layout");
+
+string MeshCache::cachePath(const string & objPath)
+{
+	string base = objPath;
+	size_t dot = base.find_last_of('.');
+	if (dot != string::npos && base.find_first_of("/\\", dot) == string::npos)
+		base = base.substr(0, dot);
+	return base + ".llmesh";
+}
+
+bool MeshCache::write(const string & path, const ofMesh & mesh, uint64_t sourceSize)
+{
+	ofstream out(path, ios::binary);
+	if (!out)
+	{
+		cout << "can't write mesh cache " << path << endl;
+		return false;
+	}
+
+	MeshCacheHeader h;
+	h.numVertices = (uint32_t)mesh.getNumVertices();
+	h.numIndices = (uint32_t)mesh.getNumIndices();
+	h.sourceSize = sourceSize;
+	if (mesh.getNumNormals() == mesh.getNumVertices()) h.flags |= HasNormals;
+	if (h.numIndices > 0) h.flags |= HasIndices;
+	if (h.numVertices > 0)
+	{
+		Box bounds = Octree::meshBounds(mesh);
+		for (int k = 0; k < 3; k++)
+		{
+			h.boundsMin[k] = bounds.min()[k];
+			h.boundsMax[k] = bounds.max()[k];
+		}
+		h.flags |= HasBounds;
+	}
+
+	out.write((const char*)&h, sizeof(h));
+	out.write((const char*)mesh.getVertices().data(), h.numVertices * sizeof(glm::vec3));
+	if (h.flags & HasNormals)
+		out.write((const char*)mesh.getNormals().data(), h.numVertices * sizeof(glm::vec3));
+	for (int i = 0; i < h.numIndices; i++)
+	{
+		uint32_t index = mesh.getIndices()[i];
+		out.write((const char*)&index, sizeof(index));
+	}
+	return out.good();
+}
+
+//  the OBJ's face corners are welded back into shared vertices before they
+//  are written, so the octree indexes each surface point once
+//
+bool MeshCache::convert(const string & objPath, const string & cachePath)
+{
+	ofMesh corners, mesh;
+	vector<int> remap;
+	if (!ObjLoader::load(objPath, corners)) return false;
+	MeshWeld::weld(corners, MeshWeld::defaultTolerance(), mesh, remap);
+	if (!write(cachePath, mesh, ofFile(objPath).getSize())) return false;
+	cout << "wrote mesh cache " << cachePath << ", " << corners.getNumVertices() << " corners welded into "
+		<< mesh.getNumVertices() << " vertices" << endl;
+	return true;
+}
+
+bool MeshCache::open(const string & path)
+{
+	close();
+
+#ifdef _WIN32
+	HANDLE f = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (f == INVALID_HANDLE_VALUE) return false;
+	LARGE_INTEGER fileSize;
+	GetFileSizeEx(f, &fileSize);
+	HANDLE m = fileSize.QuadPart > 0 ? CreateFileMappingA(f, NULL, PAGE_READONLY, 0, 0, NULL) : NULL;
+	const void *p = m ? MapViewOfFile(m, FILE_MAP_READ, 0, 0, 0) : NULL;
+	if (p == NULL)
+	{
+		if (m) CloseHandle(m);
+		CloseHandle(f);
+		return false;
+	}
+	file = f;
+	mapping = m;
+	size = (size_t)fileSize.QuadPart;
+#else
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0) return false;
+	struct stat st;
+	void *p = MAP_FAILED;
+	if (fstat(fd, &st) == 0 && st.st_size > 0)
+		p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);        // the mapping keeps the file open
+	if (p == MAP_FAILED) return false;
+	size = st.st_size;
+#endif
+	data = (const char*)p;
+
+	if (size < sizeof(MeshCacheHeader))
+	{
+		close();
+		return false;
+	}
+	memcpy(&header, data, sizeof(header));
+	size_t vertexBytes = (size_t)header.numVertices * sizeof(glm::vec3);
+	size_t expected = sizeof(header) + vertexBytes
+		+ (header.flags & HasNormals ? vertexBytes : 0)
+		+ (size_t)header.numIndices * sizeof(uint32_t);
+	if (memcmp(header.magic, "LLMC", 4) != 0 || header.version != MeshCacheHeader().version || size < expected)
+	{
+		cout << path << " is not a mesh cache or is out of date" << endl;
+		close();
+		return false;
+	}
+
+	const char *cursor = data + sizeof(header);
+	view = MeshView();
+	view.numVertices = header.numVertices;
+	view.numIndices = header.numIndices;
+	view.vertices = (const glm::vec3*)cursor;
+	cursor += vertexBytes;
+	if (header.flags & HasNormals)
+	{
+		view.normals = (const glm::vec3*)cursor;
+		cursor += vertexBytes;
+	}
+	if (header.flags & HasIndices) view.indices = (const uint32_t*)cursor;
+	if (header.flags & HasBounds)
+	{
+		view.hasBounds = true;
+		view.bounds = Box(glm::vec3(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]),
+			glm::vec3(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]));
+	}
+	return true;
+}
+
+//  map the cache for an OBJ, (re)writing it first if it's missing or was
+//  made from a different version of the OBJ
+//
+bool MeshCache::openObj(const string & objPath)
+{
+	string path = cachePath(objPath);
+	if (open(path) && header.sourceSize == ofFile(objPath).getSize())
+		return true;
+	close();
+	return convert(objPath, path) && open(path);
+}
+
+void MeshCache::close()
+{
+	if (data == NULL) return;
+#ifdef _WIN32
+	UnmapViewOfFile(data);
+	CloseHandle((HANDLE)mapping);
+	CloseHandle((HANDLE)file);
+	file = mapping = NULL;
+#else
+	munmap((void*)data, size);
+#endif
+	data = NULL;
+	size = 0;
+	view = MeshView();
+}
+
+void MeshCache::memoryUsage(size_t & current, size_t & peak)
+{
+	current = peak = 0;
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS pmc;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+	{
+		current = pmc.WorkingSetSize;
+		peak = pmc.PeakWorkingSetSize;
+	}
+#else
+	ifstream status("/proc/self/status");
+	string line;
+	while (getline(status, line))
+	{
+		if (line.compare(0, 6, "VmRSS:") == 0) current = (size_t)atoll(line.c_str() + 6) * 1024;
+		if (line.compare(0, 6, "VmHWM:") == 0) peak = (size_t)atoll(line.c_str() + 6) * 1024;
+	}
+#endif
+}
+
+void MeshCache::resetPeakMemory()
+{
+#ifndef _WIN32
+	ofstream clear("/proc/self/clear_refs");
+	clear << "5";
+#endif
+}
+
+static double msSince(chrono::steady_clock::time_point t0)
+{
+	return chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+}
+
+int MeshCache::main(const vector<string> & args)
+{
+	if (args.size() < 2)
+	{
+		cout << "usage: --mesh-load geo/Moon500.obj [--levels 13] [--via cache|obj]" << endl;
+		return 2;
+	}
+	string objPath = ofToDataPath(args[1]);
+	int numLevels = 13;
+	string via = "cache";
+	for (int i = 2; i + 1 < args.size(); i += 2)
+	{
+		if (args[i] == "--levels") numLevels = ofToInt(args[i + 1]);
+		else if (args[i] == "--via") via = args[i + 1];
+	}
+
+	// make sure the cache exists so its one time conversion isn't timed
+	//
+	{
+		MeshCache cache;
+		if (!cache.openObj(objPath)) return 2;
+	}
+
+	// one path per run, freed memory stays with the allocator and would
+	// hide part of the second path's peak
+	//
+	resetPeakMemory();
+	size_t baseline, peak;
+	memoryUsage(baseline, peak);
+	cout << fixed << setprecision(1);
+	if (via == "cache")
+	{
+		chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+		MeshCache cache;
+		cache.open(cachePath(objPath));
+		double loadMs = msSince(t0);
+		Octree tree;
+		tree.create(cache.view, numLevels);
+		double totalMs = msSince(t0);
+		size_t current;
+		memoryUsage(current, peak);
+		cout << "cache: load " << loadMs << " ms, load + octree " << totalMs << " ms, peak +"
+			<< (peak - baseline) / 1048576.0 << " MB" << endl;
+	}
+	else
+	{
+		chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+		ofMesh mesh;
+		ObjLoader::load(objPath, mesh);
+		double loadMs = msSince(t0);
+		Octree tree;
+		tree.create(mesh, numLevels);
+		double totalMs = msSince(t0);
+		size_t current;
+		memoryUsage(current, peak);
+		cout << "obj:   load " << loadMs << " ms, load + octree " << totalMs << " ms, peak +"
+			<< (peak - baseline) / 1048576.0 << " MB" << endl;
+	}
+	cout << defaultfloat;
+	return 0;
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include "ofMain.h"
+#include "box.h"
+
+//  Vertex data owned by someone else (a mapped MeshCache file), read only.
+//
+struct MeshView
+{
+	const glm::vec3 *vertices = NULL;
+	const glm::vec3 *normals = NULL;     // NULL if the mesh has none
+	const uint32_t *indices = NULL;      // NULL if the mesh has none
+	int numVertices = 0;
+	int numIndices = 0;
+	bool hasBounds = false;
+	Box bounds;
+};
+
+//  Binary mesh file, a 64 byte header followed by the positions, normals
+//  and indices exactly as they are used in memory, so opening one is a
+//  file mapping and no parsing.  The first time an OBJ is opened through
+//  openObj() it is read with ObjLoader, welded with MeshWeld and written
+//  next to it as name.llmesh; later runs map that file instead, until the
+//  OBJ changes size.
+//
+//      --mesh-load geo/Moon500.obj [--levels 13] [--via cache|obj]
+//
+//  reports load time and peak memory of either path, run it once for each
+//  to compare.
+//
+struct MeshCacheHeader
+{
+	char magic[4] = { 'L', 'L', 'M', 'C' };
+	uint32_t version = 2;         // 2: vertices are welded
+	uint32_t flags = 0;
+	uint32_t numVertices = 0;
+	uint32_t numIndices = 0;
+	uint32_t reserved0 = 0;
+	uint64_t sourceSize = 0;      // size of the OBJ it was made from
+	float boundsMin[3] = { 0, 0, 0 };
+	float boundsMax[3] = { 0, 0, 0 };
+	uint32_t reserved1[2] = { 0, 0 };
+};
+
+class MeshCache
+{
+public:
+	enum { HasNormals = 1, HasIndices = 2, HasBounds = 4 };
+
+	MeshCache() {}
+	~MeshCache() { close(); }
+	MeshCache(const MeshCache &) = delete;             // owns the mapping
+	MeshCache & operator=(const MeshCache &) = delete;
+
+	static int main(const vector<string> & args);
+	static bool write(const string & path, const ofMesh & mesh, uint64_t sourceSize = 0);
+	static bool convert(const string & objPath, const string & cachePath);
+	static string cachePath(const string & objPath);
+
+	// resident and peak resident bytes of the process, and starting a new
+	// peak (Linux only, elsewhere the peak covers the whole run)
+	//
+	static void memoryUsage(size_t & current, size_t & peak);
+	static void resetPeakMemory();
+
+	bool open(const string & path);
+	bool openObj(const string & objPath);
+	void close();
+	bool isOpen() const { return data != NULL; }
+	size_t bytes() const { return size; }       // of the mapping
+
+	MeshCacheHeader header;
+	MeshView view;
+
+private:
+	const char *data = NULL;
+	size_t size = 0;
+#ifdef _WIN32
+	void *file = NULL;
+	void *mapping = NULL;
+#endif
+};
@@ -0,0 +1,128 @@
+#include "MeshWeld.h"
+#include <unordered_map>
+
+static uint64_t cellKey(int64_t x, int64_t y, int64_t z)
+{
+	// 21 bits per axis is +-1M cells, wrapping further out only costs
+	// extra distance checks
+	//
+	const uint64_t mask = (1 << 21) - 1;
+	return ((uint64_t)x & mask) | (((uint64_t)y & mask) << 21) | (((uint64_t)z & mask) << 42);
+}
+
+//  compute remap for every vertex, returns the number of welded vertices.
+//  The first vertex of each group is kept as its position.
+//
+int MeshWeld::weld(const glm::vec3 *vertices, int numVertices, float tolerance, vector<int> & remap)
+{
+	remap.resize(numVertices);
+	float cell = max(tolerance, 1e-7f);
+	float tol2 = tolerance * tolerance;
+
+	// each grid cell holds a chain of kept vertices through next[]
+	//
+	unordered_map<uint64_t, int> heads;
+	heads.reserve(numVertices);
+	vector<int> kept;
+	vector<int> next;
+	kept.reserve(numVertices);
+	next.reserve(numVertices);
+
+	for (int i = 0; i < numVertices; i++)
+	{
+		const glm::vec3 & v = vertices[i];
+		int64_t cx = (int64_t)floor(v.x / cell);
+		int64_t cy = (int64_t)floor(v.y / cell);
+		int64_t cz = (int64_t)floor(v.z / cell);
+
+		int found = -1;
+		for (int dz = -1; dz <= 1 && found < 0; dz++)
+		{
+			for (int dy = -1; dy <= 1 && found < 0; dy++)
+			{
+				for (int dx = -1; dx <= 1 && found < 0; dx++)
+				{
+					unordered_map<uint64_t, int>::const_iterator it = heads.find(cellKey(cx + dx, cy + dy, cz + dz));
+					if (it == heads.end()) continue;
+					for (int k = it->second; k >= 0; k = next[k])
+					{
+						glm::vec3 d = vertices[kept[k]] - v;
+						if (glm::dot(d, d) <= tol2)
+						{
+							found = k;
+							break;
+						}
+					}
+				}
+			}
+		}
+
+		if (found < 0)
+		{
+			found = (int)kept.size();
+			kept.push_back(i);
+			uint64_t key = cellKey(cx, cy, cz);
+			unordered_map<uint64_t, int>::iterator it = heads.find(key);
+			if (it == heads.end())
+			{
+				next.push_back(-1);
+				heads[key] = found;
+			}
+			else
+			{
+				next.push_back(it->second);
+				it->second = found;
+			}
+		}
+		remap[i] = found;
+	}
+	return (int)kept.size();
+}
+
+//  welded copy of a mesh, triangles that collapse to a line or a point are
+//  dropped
+//
+void MeshWeld::weld(const ofMesh & in, float tolerance, ofMesh & out, vector<int> & remap)
+{
+	int n = (int)in.getNumVertices();
+	int numWelded = weld(in.getVertices().data(), n, tolerance, remap);
+	bool hasNormals = in.getNumNormals() == n;
+
+	vector<glm::vec3> vertices(numWelded);
+	vector<glm::vec3> normals(hasNormals ? numWelded : 0, glm::vec3(0, 0, 0));
+	vector<bool> placed(numWelded, false);
+	for (int i = 0; i < n; i++)
+	{
+		int w = remap[i];
+		if (!placed[w])
+		{
+			vertices[w] = in.getVertices()[i];
+			placed[w] = true;
+		}
+		if (hasNormals) normals[w] += in.getNormals()[i];
+	}
+	for (int i = 0; i < normals.size(); i++)
+	{
+		if (glm::length(normals[i]) > 0)
+			normals[i] = glm::normalize(normals[i]);
+	}
+
+	out.clear();
+	out.addVertices(vertices.data(), numWelded);
+	if (hasNormals) out.addNormals(normals.data(), numWelded);
+
+	// an unindexed mesh is a triangle list in vertex order
+	//
+	const vector<ofIndexType> & indices = in.getIndices();
+	int numCorners = indices.empty() ? n : (int)indices.size();
+	for (int t = 0; t + 2 < numCorners; t += 3)
+	{
+		int a = remap[indices.empty() ? t : indices[t]];
+		int b = remap[indices.empty() ? t + 1 : indices[t + 1]];
+		int c = remap[indices.empty() ? t + 2 : indices[t + 2]];
+		if (a == b || b == c || a == c) continue;
+		out.addIndex(a);
+		out.addIndex(b);
+		out.addIndex(c);
+	}
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include "ofMain.h"
+
+//  Merges vertices that lie within a tolerance of each other, so a mesh
+//  loaded with one vertex per face corner becomes one vertex per point on
+//  the surface before it is indexed by the Octree.  Candidates are found
+//  through a hash grid with cells the size of the tolerance, so only the
+//  27 cells around a vertex are searched.
+//
+//  remap[i] is the welded vertex that input vertex i became; triangles are
+//  rewritten through it and normals of merged vertices are averaged.
+//
+class MeshWeld
+{
+public:
+	static void weld(const ofMesh & in, float tolerance, ofMesh & out, vector<int> & remap);
+	static int weld(const glm::vec3 *vertices, int numVertices, float tolerance, vector<int> & remap);
+
+	static float defaultTolerance() { return 1e-4; }
+};
@@ -0,0 +1,111 @@
+#include "ObjLoader.h"
+
+//  parse one face corner ("v", "v/vt", "v//vn" or "v/vt/vn"), OBJ indices
+//  are 1 based and negative values count back from the end of the list
+//
+static const char* parseCorner(const char* s, int numV, int numN, int & v, int & n)
+{
+	char* end;
+	v = (int)strtol(s, &end, 10);
+	v = v < 0 ? numV + v : v - 1;
+	n = -1;
+	s = end;
+	if (*s == '/')
+	{
+		s++;
+		if (*s != '/')
+		{
+			strtol(s, &end, 10);      // texture coordinate, not used
+			s = end;
+		}
+		if (*s == '/')
+		{
+			s++;
+			n = (int)strtol(s, &end, 10);
+			n = n < 0 ? numN + n : n - 1;
+			s = end;
+		}
+	}
+	return s;
+}
+
+bool ObjLoader::load(const string & path, ofMesh & mesh)
+{
+	ofBuffer buffer = ofBufferFromFile(path, true);
+	if (buffer.size() == 0)
+	{
+		cout << "ObjLoader: " << path << " not found or empty" << endl;
+		return false;
+	}
+
+	vector<glm::vec3> positions;
+	vector<glm::vec3> normals;
+	mesh.clear();
+
+	string text = buffer.getText();
+	const char* s = text.c_str();
+	vector<int> cornerV, cornerN;
+	while (*s)
+	{
+		// one record per line
+		//
+		const char* eol = strchr(s, '\n');
+		if (eol == NULL) eol = s + strlen(s);
+		while (*s == ' ' || *s == '\t') s++;
+
+		if (s[0] == 'v' && s[1] == ' ')
+		{
+			char* end;
+			glm::vec3 p;
+			p.x = strtof(s + 2, &end);
+			p.y = strtof(end, &end);
+			p.z = strtof(end, &end);
+			positions.push_back(p);
+		}
+		else if (s[0] == 'v' && s[1] == 'n' && s[2] == ' ')
+		{
+			char* end;
+			glm::vec3 n;
+			n.x = strtof(s + 3, &end);
+			n.y = strtof(end, &end);
+			n.z = strtof(end, &end);
+			normals.push_back(n);
+		}
+		else if (s[0] == 'f' && s[1] == ' ')
+		{
+			cornerV.clear();
+			cornerN.clear();
+			const char* c = s + 2;
+			while (c < eol)
+			{
+				while (c < eol && (*c == ' ' || *c == '\t' || *c == '\r')) c++;
+				if (c >= eol) break;
+				int v, n;
+				c = parseCorner(c, (int)positions.size(), (int)normals.size(), v, n);
+				if (v < 0 || v >= positions.size())
+				{
+					cout << "ObjLoader: bad vertex index in " << path << endl;
+					return false;
+				}
+				cornerV.push_back(v);
+				cornerN.push_back(n);
+			}
+
+			// triangle fan, one new vertex per corner
+			//
+			for (int i = 1; i + 1 < cornerV.size(); i++)
+			{
+				int tri[3] = { 0, i, i + 1 };
+				for (int k = 0; k < 3; k++)
+				{
+					mesh.addIndex(mesh.getNumVertices());
+					mesh.addVertex(positions[cornerV[tri[k]]]);
+					int n = cornerN[tri[k]];
+					mesh.addNormal(n >= 0 && n < normals.size() ? normals[n] : glm::vec3(0, 1, 0));
+				}
+			}
+		}
+		s = *eol ? eol + 1 : eol;
+	}
+	return mesh.getNumVertices() > 0;
+}
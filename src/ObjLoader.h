@@ -0,0 +1,13 @@
+#pragma once
+#include "ofMain.h"
+
+//  Minimal Wavefront OBJ reader (v, vn and f records only) for headless
+//  tools that run without a GL context.  Polygons are triangulated as fans
+//  and every face corner becomes its own vertex, which is the same layout
+//  ofxAssimpModelLoader hands to the app.
+//
+class ObjLoader
+{
+public:
+	static bool load(const string & path, ofMesh & mesh);
+};
@@ -1,52 +1,27 @@
 #include "Octree.h"
- 
-
-// draw Octree (recursively)
-//
-void Octree::draw(TreeNode & node, int numLevels, int level) {
-	if (level >= numLevels) return;
-	drawBox(node.box);
-	level++;
-	for (int i = 0; i < node.children.size(); i++) {
-		draw(node.children[i], numLevels, level);
-	}
-}
+#include "Profiler.h"
+#include "PerfCounters.h"
+#include "Arena.h"
+#include <atomic>
 
-// draw only leaf Nodes
+//  source of Octree::version, unique across trees so a cursor can't take a
+//  new tree at an old one's address for the old tree
 //
-void Octree::drawLeafNodes(TreeNode & node) 
-{
-	if (node.children.size() == 0)
-		drawBox(node.box);
-	else
-		for (int i = 0; i < node.children.size(); i++)
-			drawLeafNodes(node.children[i]);
-}
-
-
-//draw a box from a "Box" class  
-//
-void Octree::drawBox(const Box &box) {
-	glm::vec3 min = box.parameters[0];
-	glm::vec3 max = box.parameters[1];
-	glm::vec3 size = max - min;
-	glm::vec3 center = size / 2 + min;
-	ofVec3f p = ofVec3f(center.x, center.y, center.z);
-	float w = size.x;
-	float h = size.y;
-	float d = size.z;
-	ofDrawBox(p, w, h, d);
-}
+static atomic<unsigned int> treeVersions(0);
+ 
 
 // return a Mesh Bounding Box for the entire Mesh
 //
 Box Octree::meshBounds(const ofMesh & mesh) {
-	int n = mesh.getNumVertices();
-	ofVec3f v = mesh.getVertex(0);
+	return meshBounds(mesh.getVertices().data(), mesh.getNumVertices());
+}
+
+Box Octree::meshBounds(const glm::vec3 *vertices, int n) {
+	ofVec3f v = vertices[0];
 	ofVec3f max = v;
 	ofVec3f min = v;
 	for (int i = 1; i < n; i++) {
-		ofVec3f v = mesh.getVertex(i);
+		ofVec3f v = vertices[i];
 
 		if (v.x > max.x) max.x = v.x;
 		else if (v.x < min.x) min.x = v.x;
@@ -71,7 +46,7 @@ int Octree::getMeshPointsInBox(const vector<int>& points, Box & box, vector<int>
 
 	for (int i = 0; i < points.size(); i++)
 	{
-		if (box.inside(this->mesh.getVertex(points[i])))
+		if (box.inside(vertex(points[i])))
 		{
 			pointsRtn.push_back(points[i]);
 			count++;
@@ -81,11 +56,29 @@ int Octree::getMeshPointsInBox(const vector<int>& points, Box & box, vector<int>
 	return count;
 }
 
+//  same, writing into an array of at least points.size() entries
+//
+int Octree::getMeshPointsInBox(const vector<int>& points, Box & box, int *pointsRtn)
+{
+	int count = 0;
 
+	for (int i = 0; i < points.size(); i++)
+	{
+		if (box.inside(vertex(points[i])))
+			pointsRtn[count++] = points[i];
+	}
+
+	return count;
+}
+
+void Octree::subDivideBox8(const Box &box, vector<Box> & boxList) {
+	boxList.resize(8);
+	subDivideBox8(box, &boxList[0]);
+}
 
 //  Subdivide a Box into eight(8) equal size boxes, return them in boxList;
 //
-void Octree::subDivideBox8(const Box &box, vector<Box> & boxList) {
+void Octree::subDivideBox8(const Box &box, Box *boxList) {
 	glm::vec3 min = box.parameters[0];
 	glm::vec3 max = box.parameters[1];
 	glm::vec3 size = max - min;
@@ -103,31 +96,72 @@ void Octree::subDivideBox8(const Box &box, vector<Box> & boxList) {
 	b[2] = Box(b[1].min() + glm::vec3(0, 0, zdist), b[1].max() + glm::vec3(0, 0, zdist));
 	b[3] = Box(b[2].min() + glm::vec3(-xdist, 0, 0), b[2].max() + glm::vec3(-xdist, 0, 0));
 
-	boxList.clear();
-	for (int i = 0; i < 4; i++)
-		boxList.push_back(b[i]);
-
 	// generate second story
 	//
-	for (int i = 4; i < 8; i++) {
+	for (int i = 4; i < 8; i++)
 		b[i] = Box(b[i - 4].min() + h, b[i - 4].max() + h);
-		boxList.push_back(b[i]);
-	}
+
+	for (int i = 0; i < 8; i++)
+		boxList[i] = b[i];
 }
 
 void Octree::create(const ofMesh & mesh, int numLevels) 
 {
+	PROFILE_SCOPE("Octree::create");
+
 	// initialize octree structure
+	setMesh(mesh);
+	build(numLevels);
+}
+
+void Octree::setMesh(const ofMesh & mesh)
+{
 	this->mesh = mesh;
-	// initialize the firt root node (level 0)
-	// it contains all vertex indices from the mesh
-	//
-	int level = 0;
+	vertices = NULL;
+	normals = NULL;
+	numVertices = (int)mesh.getNumVertices();
 	this->root.box = meshBounds(mesh);
-	for (int i = 0; i < mesh.getNumVertices(); i++) 
+}
+
+//  build over vertex data the caller keeps alive (a mapped MeshCache), the
+//  vertices are used in place rather than copied into the tree
+//
+void Octree::create(const MeshView & view, int numLevels)
+{
+	PROFILE_SCOPE("Octree::create");
+
+	setMesh(view);
+	build(numLevels);
+}
+
+void Octree::setMesh(const MeshView & view)
+{
+	mesh.clear();
+	vertices = view.vertices;
+	normals = view.normals;
+	numVertices = view.numVertices;
+	this->root.box = view.hasBounds ? view.bounds : meshBounds(view.vertices, view.numVertices);
+}
+
+// initialize the firt root node (level 0)
+// it contains all vertex indices from the mesh
+//
+void Octree::initRoot(int numLevels)
+{
+	version = ++treeVersions;
+	levels = numLevels;
+	root.children.clear();
+	root.points.resize(numVertices);
+	for (int i = 0; i < numVertices; i++) 
 	{
-		root.points.push_back(i);
+		root.points[i] = i;
 	}
+}
+
+void Octree::build(int numLevels)
+{
+	int level = 0;
+	initRoot(numLevels);
 	float t1 = ofGetElapsedTimeMillis();
 	// recursively buid octree (starting at level 1)
 	//
@@ -137,29 +171,397 @@ void Octree::create(const ofMesh & mesh, int numLevels)
 	cout << "Time to Build Octree: " << t2 - t1 << " milliseconds" << endl;
 }
 
+//  The child boxes and the points found in each come from a build arena,
+//  given back as each call returns, so the heap only sees the nodes'
+//  own lists, each allocated once at its final size.
+//
 void Octree::subdivide(TreeNode & node, int numLevels, int level)
 {
 	if (level >= numLevels) return;
 
-	vector<Box> boxList;
+	Arena arena(node.points.size() * sizeof(int) * 2 + 64 * 1024);
+	subdivide(node, numLevels, level, arena);
+}
+
+void Octree::subdivide(TreeNode & node, int numLevels, int level, Arena & arena)
+{
+	if (level >= numLevels) return;
+
+	Arena::Marker start = arena.mark();
+	Box *boxList = arena.allocate<Box>(8);
+	int *inBox = arena.allocate<int>(node.points.size());
 	subDivideBox8(node.box, boxList);
 	level++;
-	for (int i = 0; i < boxList.size(); i++) 
+	for (int i = 0; i < 8; i++) 
 	{
-		TreeNode child;
-		int count = getMeshPointsInBox(node.points, boxList[i], child.points);
+		int count = getMeshPointsInBox(node.points, boxList[i], inBox);
 		if (count > 0) {
+			node.children.emplace_back();
+			TreeNode & child = node.children.back();
 			child.box = boxList[i];
-			node.children.push_back(child);
+			child.points.assign(inBox, inBox + count);
 			if (count > 1) {
-				subdivide(node.children[node.children.size() - 1], numLevels, level);
+				subdivide(child, numLevels, level, arena);
+			}
+		}
+	}
+	arena.release(start);
+}
+
+//  same inclusive test as Box::inside, which isn't const
+//
+static bool boxContains(const Box & box, const glm::vec3 & p)
+{
+	return ((p.x >= box.parameters[0].x && p.x <= box.parameters[1].x) &&
+		(p.y >= box.parameters[0].y && p.y <= box.parameters[1].y) &&
+		(p.z >= box.parameters[0].z && p.z <= box.parameters[1].z));
+}
+
+//  Move vertices to new positions and update only the nodes along their old
+//  and new paths.  A build is fully determined by the points: every node
+//  holds the sorted indices inside its box, children come in subDivideBox8
+//  order, and a node below the root is split only if it holds more than one
+//  point.  Removing and inserting one index at a time keeps those rules, so
+//  the result is the tree a fresh build over the same root box would give.
+//  Nodes that hold both the old and the new position keep their lists, so a
+//  small move only touches the few small nodes it crosses between, about
+//  the depth of the tree per vertex.
+//
+//  The root box stays as it is.  If a vertex moves outside it the tree is
+//  rebuilt around the new bounds and false is returned.  A tree made from
+//  a MeshView copies the vertices the first time it is changed.
+//
+bool Octree::moveVertices(const vector<int> & indices, const vector<glm::vec3> & positions)
+{
+	PROFILE_SCOPE("Octree::moveVertices");
+
+	version = ++treeVersions;
+	if (vertices)
+	{
+		mesh.clear();
+		mesh.addVertices(vertices, numVertices);
+		if (normals) mesh.addNormals(normals, numVertices);
+		vertices = NULL;
+		normals = NULL;
+	}
+
+	bool inside = true;
+	for (int k = 0; k < indices.size() && inside; k++)
+	{
+		int i = indices[k];
+		glm::vec3 old = vertex(i);
+		mesh.getVertices()[i] = positions[k];
+		if (boxContains(root.box, positions[k]))
+			movePoint(root, i, old, positions[k], 1);
+		else
+			inside = false;
+	}
+	for (int k = 0; k < indices.size() && !inside; k++)
+		mesh.getVertices()[indices[k]] = positions[k];
+	if (!inside)
+	{
+		root.box = meshBounds(mesh);
+		build(levels);
+	}
+	return inside;
+}
+
+//  node holds both positions, its list and children count don't change
+//
+void Octree::movePoint(TreeNode & node, int index, const glm::vec3 & from, const glm::vec3 & to, int level)
+{
+	if (node.children.empty()) return;
+
+	for (int c = 0; c < node.children.size(); c++)
+	{
+		TreeNode & child = node.children[c];
+		if (!boxContains(child.box, from)) continue;
+		if (boxContains(child.box, to))
+		{
+			movePoint(child, index, from, to, level + 1);
+			continue;
+		}
+		removePoint(child, index, from);
+		if (child.points.empty())
+		{
+			node.children.erase(node.children.begin() + c);
+			c--;
+		}
+	}
+	insertChild(node, index, to, level, &from);
+}
+
+void Octree::removePoint(TreeNode & node, int index, const glm::vec3 & p)
+{
+	vector<int>::iterator it = lower_bound(node.points.begin(), node.points.end(), index);
+	if (it == node.points.end() || *it != index) return;
+	node.points.erase(it);
+
+	for (int c = 0; c < node.children.size(); c++)
+	{
+		if (!boxContains(node.children[c].box, p)) continue;
+		removePoint(node.children[c], index, p);
+		if (node.children[c].points.empty())
+		{
+			node.children.erase(node.children.begin() + c);
+			c--;
+		}
+	}
+
+	// a node left with one point is a leaf, the root is always split
+	if (&node != &root && node.points.size() <= 1)
+		node.children.clear();
+}
+
+void Octree::insertPoint(TreeNode & node, int index, const glm::vec3 & p, int level)
+{
+	node.points.insert(lower_bound(node.points.begin(), node.points.end(), index), index);
+
+	if (level >= levels) return;
+	if (&node != &root && node.points.size() == 1) return;
+	if (node.children.empty())
+	{
+		subdivide(node, levels, level);
+		return;
+	}
+	insertChild(node, index, p, level, NULL);
+}
+
+//  add index to the children of node whose boxes hold p, skipping the boxes
+//  that also hold skip (those already have it)
+//
+void Octree::insertChild(TreeNode & node, int index, const glm::vec3 & p, int level, const glm::vec3 *skip)
+{
+	vector<Box> boxList;
+	subDivideBox8(node.box, boxList);
+	for (int k = 0; k < boxList.size(); k++)
+	{
+		if (!boxContains(boxList[k], p)) continue;
+		if (skip && boxContains(boxList[k], *skip)) continue;
+
+		// existing children are the non empty boxes in boxList order
+		int c = 0;
+		for (; c < node.children.size(); c++)
+		{
+			int slot = 0;
+			while (slot < boxList.size() && node.children[c].box.min() != boxList[slot].min()) slot++;
+			if (slot >= k) break;
+		}
+		if (c < node.children.size() && node.children[c].box.min() == boxList[k].min())
+		{
+			insertPoint(node.children[c], index, p, level + 1);
+		}
+		else
+		{
+			TreeNode child;
+			child.box = boxList[k];
+			child.points.push_back(index);
+			node.children.insert(node.children.begin() + c, child);
+		}
+	}
+}
+
+//  indices of the vertices inside box, from the leaves that overlap it
+//
+void Octree::pointsInBox(const Box & box, vector<int> & pointsRtn) const
+{
+	pointsRtn.clear();
+	vector<const TreeNode*> stack(1, &root);
+	while (!stack.empty())
+	{
+		const TreeNode* node = stack.back();
+		stack.pop_back();
+		const Box & b = node->box;
+		if (b.max().x < box.min().x || b.min().x > box.max().x ||
+			b.max().y < box.min().y || b.min().y > box.max().y ||
+			b.max().z < box.min().z || b.min().z > box.max().z) continue;
+		if (node->children.empty())
+		{
+			for (int i = 0; i < node->points.size(); i++)
+				if (boxContains(box, vertex(node->points[i]))) pointsRtn.push_back(node->points[i]);
+		}
+		for (int c = 0; c < node->children.size(); c++)
+			stack.push_back(&node->children[c]);
+	}
+	// points on a shared face are in more than one leaf
+	sort(pointsRtn.begin(), pointsRtn.end());
+	pointsRtn.erase(unique(pointsRtn.begin(), pointsRtn.end()), pointsRtn.end());
+}
+
+bool Octree::sameTree(const TreeNode & a, const TreeNode & b)
+{
+	if (a.box.min() != b.box.min() || a.box.max() != b.box.max()) return false;
+	if (a.points != b.points || a.children.size() != b.children.size()) return false;
+	for (int c = 0; c < a.children.size(); c++)
+		if (!sameTree(a.children[c], b.children[c])) return false;
+	return true;
+}
+
+//  parameter range [tEnter, tExit] of the segment from + t * delta, t in
+//  0..1, that lies in box grown by radius.  Faces are inclusive like
+//  Box::inside, so a point that intersect(point) finds in a leaf is hit
+//  here at the same t.
+//
+static bool segmentBox(const Box & box, float radius, const glm::vec3 & from, const glm::vec3 & delta, float & tEnter, float & tExit)
+{
+	tEnter = 0;
+	tExit = 1;
+	for (int a = 0; a < 3; a++)
+	{
+		float lo = box.parameters[0][a] - radius;
+		float hi = box.parameters[1][a] + radius;
+		if (delta[a] == 0)
+		{
+			if (from[a] < lo || from[a] > hi) return false;
+			continue;
+		}
+		float t0 = (lo - from[a]) / delta[a];
+		float t1 = (hi - from[a]) / delta[a];
+		if (t0 > t1) swap(t0, t1);
+		tEnter = max(tEnter, t0);
+		tExit = min(tExit, t1);
+		if (tEnter > tExit) return false;
+	}
+	return true;
+}
+
+//  Continuous version of intersect(point): the earliest time a sphere moving
+//  from -> to touches a leaf box, or the box grown by radius, so nothing the
+//  point test would find at some position along the motion is stepped over.
+//  Children are visited in the order the segment enters them and skipped
+//  once they start after the best hit.  Returns false if the whole segment
+//  is clear, hit is left unchanged then.
+//
+bool Octree::sweep(const glm::vec3 & from, const glm::vec3 & to, float radius, SweepHit & hit) const
+{
+	PROFILE_SCOPE("Octree::sweep");
+	PerfCounters::add(CounterOctreeQueries);
+
+	float tEnter, tExit;
+	glm::vec3 delta = to - from;
+	if (!segmentBox(root.box, radius, from, delta, tEnter, tExit)) return false;
+
+	SweepHit best;
+	best.t = 2;
+	sweep(root, from, delta, radius, tEnter, best);
+	if (best.t > 1) return false;
+	hit = best;
+	return true;
+}
+
+void Octree::sweep(const TreeNode & node, const glm::vec3 & from, const glm::vec3 & delta, float radius, float tNode, SweepHit & hit) const
+{
+	PerfCounters::add(CounterOctreeNodesVisited);
+
+	if (node.children.size() == 0)
+	{
+		// contact at the entry point, the nearest vertex gives the normal
+		//
+		PerfCounters::add(CounterOctreeLeafPointsTested, node.points.size());
+		glm::vec3 p = from + delta * tNode;
+		int index = -1;
+		float dist = 999999;
+		for (int i = 0; i < node.points.size(); i++)
+		{
+			float d = glm::length(p - vertex(node.points[i]));
+			if (d < dist)
+			{
+				index = node.points[i];
+				dist = d;
 			}
 		}
+		hit.t = tNode;
+		hit.position = p;
+		hit.vertex = index;
+		hit.normal = index >= 0 ? glm::normalize(normal(index)) : glm::vec3(0, 1, 0);
+		return;
+	}
+
+	// at most 8 children, sorted by entry time
+	//
+	int order[8];
+	float enter[8];
+	int n = 0;
+	for (int i = 0; i < node.children.size(); i++)
+	{
+		float t0, t1;
+		if (!segmentBox(node.children[i].box, radius, from, delta, t0, t1) || t0 >= hit.t) continue;
+		int k = n++;
+		for (; k > 0 && enter[k - 1] > t0; k--)
+		{
+			enter[k] = enter[k - 1];
+			order[k] = order[k - 1];
+		}
+		enter[k] = t0;
+		order[k] = i;
 	}
+	for (int k = 0; k < n && enter[k] < hit.t; k++)
+		sweep(node.children[order[k]], from, delta, radius, enter[k], hit);
 }
 
-bool Octree::intersect(glm::vec3 point, glm::vec3 dir, const TreeNode & node, TreeNode* nodeRtn) 
+//  Box::intersect(p, (0, -1, 0), -1000, 1000) worked through for a straight
+//  down ray: the 1/0 slopes on x and z leave a footprint test that is open
+//  in x and closed in z, and only the y interval needs arithmetic
+//
+static inline bool downRayHits(const Box & box, const glm::vec3 & p)
 {
+	const glm::vec3 & lo = box.parameters[0];
+	const glm::vec3 & hi = box.parameters[1];
+	return p.x > lo.x && p.x < hi.x && p.z >= lo.z && p.z <= hi.z &&
+		-(hi.y - p.y) < 1000 && -(lo.y - p.y) > -1000;
+}
+
+//  the leaf Octree::intersect(ray) returns for a downward ray: children are
+//  searched in order and the search stops in the first one that is hit.
+//  Only the leaf center is kept instead of copying the TreeNode.
+//
+static bool firstLeafBelow(const TreeNode & node, const glm::vec3 & p, glm::vec3 & center)
+{
+	if (!downRayHits(node.box, p)) return false;
+	if (node.children.size() == 0)
+	{
+		if (glm::length(center - p) > glm::length(node.box.center() - p))
+			center = node.box.center();
+		return true;
+	}
+	for (int i = 0; i < node.children.size(); i++)
+		if (firstLeafBelow(node.children[i], p, center)) return true;
+	return false;
+}
+
+//  distance from p to the center of the leaf intersect(p, (0, -1, 0)) finds,
+//  99999 if there is none, without copying the leaf
+//
+float Octree::heightBelow(const glm::vec3 & p) const
+{
+	PerfCounters::add(CounterOctreeQueries);
+	glm::vec3 center(-1000, -1000, -1000);
+	if (firstLeafBelow(root, p, center))
+		return glm::length(p - center);
+	return 99999;
+}
+
+//  nearest leaf along the ray, copied into nodeRtn if it is nearer than the
+//  node already there
+//
+bool Octree::intersect(glm::vec3 point, glm::vec3 dir, const TreeNode & node, TreeNode* nodeRtn) const
+{
+	const TreeNode *leaf = NULL;
+	if (!intersect(point, dir, node, leaf)) return false;
+	if (leaf && glm::length(nodeRtn->box.center() - point) > glm::length(leaf->box.center() - point))
+		*nodeRtn = *leaf;
+	return true;
+}
+
+//  same search, pointing nodeRtn at the nearest leaf instead of copying it;
+//  a NULL nodeRtn counts as farther than any leaf
+//
+bool Octree::intersect(const glm::vec3 & point, const glm::vec3 & dir, const TreeNode & node, const TreeNode* & nodeRtn) const
+{
+	PROFILE_SCOPE_IF(&node == &root, "Octree::intersect(ray)");
+	if (&node == &root) PerfCounters::add(CounterOctreeQueries);
+	PerfCounters::add(CounterOctreeNodesVisited);
+
 	//check if ray intersects this node
 	if (node.box.intersect(point, dir, -1000, 1000))
 	{
@@ -167,8 +569,8 @@ bool Octree::intersect(glm::vec3 point, glm::vec3 dir, const TreeNode & node, Tr
 		if (node.children.size() == 0)
 		{
 			//if it is, check if this node is closer than current nodeRtn, save it if so and return true
-			if (glm::length(nodeRtn->box.center() - point) > glm::length(node.box.center() - point))
-				*nodeRtn = node;
+			if (!nodeRtn || glm::length(nodeRtn->box.center() - point) > glm::length(node.box.center() - point))
+				nodeRtn = &node;
 			return true;
 		}
 		else
@@ -188,6 +590,10 @@ bool Octree::intersect(glm::vec3 point, glm::vec3 dir, const TreeNode & node, Tr
 
 bool Octree::intersect(glm::vec3 point, const TreeNode & node, glm::vec3* norm) const
 {
+	PROFILE_SCOPE_IF(&node == &root, "Octree::intersect(point)");
+	if (&node == &root) PerfCounters::add(CounterOctreeQueries);
+	PerfCounters::add(CounterOctreeNodesVisited);
+
 	//check in point is inside current node
 	const glm::vec3 p = point;
 	if ((p.x >= node.box.parameters[0].x && p.x <= node.box.parameters[1].x) &&
@@ -197,19 +603,7 @@ bool Octree::intersect(glm::vec3 point, const TreeNode & node, glm::vec3* norm)
 		//if it does, check if this is a leaf node
 		if (node.children.size() == 0)
 		{
-			int index = -1;
-			float dist = 999999;
-			for (int i = 0; i < node.points.size(); i++)
-			{
-				if (glm::length(point - mesh.getVertex(node.points[i])) < dist)
-				{
-					index = i;
-					dist = glm::length(point - mesh.getVertex(node.points[i]));
-				}
-			}
-
-			if(dist < glm::length(*norm))
-				*norm = glm::normalize(mesh.getNormal(index)) * dist;
+			nearestInLeaf(point, node, norm);
 			return true;
 		}
 		else
@@ -227,4 +621,83 @@ bool Octree::intersect(glm::vec3 point, const TreeNode & node, glm::vec3* norm)
 	return false;
 }
 
+//  the vertex of a leaf nearest point, its normal scaled by the distance
+//  goes into norm if it is nearer than norm's length
+//
+void Octree::nearestInLeaf(const glm::vec3 & point, const TreeNode & node, glm::vec3* norm) const
+{
+	PerfCounters::add(CounterOctreeLeafPointsTested, node.points.size());
+	int index = -1;
+	float dist = 999999;
+	for (int i = 0; i < node.points.size(); i++)
+	{
+		if (glm::length(point - vertex(node.points[i])) < dist)
+		{
+			index = node.points[i];
+			dist = glm::length(point - vertex(node.points[i]));
+		}
+	}
+
+	if(dist < glm::length(*norm))
+		*norm = glm::normalize(normal(index)) * dist;
+}
+
+static bool strictlyInside(const Box & box, const glm::vec3 & p)
+{
+	return ((p.x > box.parameters[0].x && p.x < box.parameters[1].x) &&
+		(p.y > box.parameters[0].y && p.y < box.parameters[1].y) &&
+		(p.z > box.parameters[0].z && p.z < box.parameters[1].z));
+}
+
+//  intersect(point, root, norm) for a probe that moves a little between
+//  calls.  The cursor climbs its path to the deepest node that has point
+//  strictly inside and searches from there.  Sibling boxes only share
+//  faces, so no leaf outside that node can hold the point and the answer
+//  is the one the search from the root gives.  The search records the
+//  path it takes for the next call.
+//
+bool Octree::intersect(const glm::vec3 & point, glm::vec3* norm, OctreeCursor & cursor) const
+{
+	PROFILE_SCOPE("Octree::intersect(cursor)");
+	PerfCounters::add(CounterOctreeQueries);
+
+	if (cursor.tree != this || cursor.version != version || cursor.depth == 0)
+	{
+		cursor.tree = this;
+		cursor.version = version;
+		cursor.depth = 0;
+	}
+	while (cursor.depth > 1 && !strictlyInside(cursor.path[cursor.depth - 1]->box, point))
+		cursor.depth--;
+	if (cursor.depth <= 1)
+	{
+		cursor.depth = 0;
+		return intersect(point, root, norm, cursor, 0);
+	}
+	cursor.depth--;
+	return intersect(point, *cursor.path[cursor.depth], norm, cursor, cursor.depth);
+}
+
+//  the search of intersect(point, node, norm), also extending the cursor's
+//  path by each node on it that has point strictly inside
+//
+bool Octree::intersect(const glm::vec3 & point, const TreeNode & node, glm::vec3* norm, OctreeCursor & cursor, int depth) const
+{
+	PerfCounters::add(CounterOctreeNodesVisited);
+
+	if (!boxContains(node.box, point)) return false;
+	if (cursor.depth == depth && depth < OctreeCursor::MaxDepth && (depth == 0 || strictlyInside(node.box, point)))
+		cursor.path[cursor.depth++] = &node;
+	if (node.children.size() == 0)
+	{
+		nearestInLeaf(point, node, norm);
+		return true;
+	}
+	for (int i = 0; i < node.children.size(); i++)
+	{
+		if (intersect(point, node.children[i], norm, cursor, depth + 1)) return true;
+	}
+	return false;
+}
+
 
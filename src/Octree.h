@@ -1,6 +1,7 @@
 #pragma once
 #include "ofMain.h"
 #include "box.h"
+#include "MeshCache.h"
 
 
 class TreeNode {
@@ -10,21 +11,69 @@ public:
 	vector<TreeNode> children;
 };
 
+//  First contact of a swept sphere, see Octree::sweep().
+//
+struct SweepHit
+{
+	float t = 1;            // time of impact along the segment, 0..1
+	glm::vec3 position;     // sphere center at t
+	glm::vec3 normal;       // normal of the terrain vertex nearest the contact
+	int vertex = -1;
+};
+
+class Octree;
+class Arena;
+
+//  Where one probe (a lander foot) last looked, for Octree::intersect with
+//  a cursor: the nodes from the root down to the deepest one that had the
+//  point strictly inside.  A nearby point climbs from there instead of
+//  descending from the root.  Kept in a fixed array, so it costs no heap
+//  work and can be copied; a rebuilt or changed tree resets it.
+//
+struct OctreeCursor
+{
+	enum { MaxDepth = 24 };
+
+	const Octree *tree = NULL;
+	unsigned int version = 0;
+	const TreeNode *path[MaxDepth];
+	int depth = 0;
+};
+
 class Octree 
 {
 public:
 	
 	void create(const ofMesh & mesh, int numLevels);
+	void create(const MeshView & view, int numLevels);
+	void build(int numLevels);
+	void setMesh(const ofMesh & mesh);
+	void setMesh(const MeshView & view);
+	void initRoot(int numLevels);
+
+	// incremental updates, see moveVertices() in Octree.cpp
+	//
+	bool moveVertices(const vector<int> & indices, const vector<glm::vec3> & positions);
+	void pointsInBox(const Box & box, vector<int> & pointsRtn) const;
+	static bool sameTree(const TreeNode & a, const TreeNode & b);
+
 	void subdivide(TreeNode & node, int numLevels, int level);
-	bool intersect(glm::vec3 point, glm::vec3 dir, const TreeNode & node, TreeNode* nodeRtn);
+	bool intersect(glm::vec3 point, glm::vec3 dir, const TreeNode & node, TreeNode* nodeRtn) const;
+	bool intersect(const glm::vec3 & point, const glm::vec3 & dir, const TreeNode & node, const TreeNode* & nodeRtn) const;
 	bool intersect(glm::vec3 point, const TreeNode & node, glm::vec3* norm) const;
+	bool intersect(const glm::vec3 & point, glm::vec3* norm, OctreeCursor & cursor) const;
+	float heightBelow(const glm::vec3 & p) const;
+	bool sweep(const glm::vec3 & from, const glm::vec3 & to, float radius, SweepHit & hit) const;
 	void draw(TreeNode & node, int numLevels, int level);
 	void draw(int numLevels, int level) { draw(root, numLevels, level); }
 	void drawLeafNodes(TreeNode & node);
 	static void drawBox(const Box &box);
 	static Box meshBounds(const ofMesh &);
+	static Box meshBounds(const glm::vec3 *vertices, int n);
 	int getMeshPointsInBox(const vector<int> & points, Box & box, vector<int> & pointsRtn);
+	int getMeshPointsInBox(const vector<int> & points, Box & box, int *pointsRtn);
 	void subDivideBox8(const Box &b, vector<Box> & boxList);
+	void subDivideBox8(const Box &b, Box *boxList);
 	bool insideBox(glm::vec3 p, Box box)
 	{
 		return ((p.x >= box.parameters[0].x && p.x <= box.parameters[1].x) &&
@@ -32,6 +81,31 @@ public:
 			(p.z >= box.parameters[0].z && p.z <= box.parameters[1].z));
 	}
 
+	// terrain vertices, either the tree's own copy of the mesh or the
+	// caller's data when built from a MeshView
+	//
+	const glm::vec3 & vertex(int i) const { return vertices ? vertices[i] : mesh.getVertices()[i]; }
+	glm::vec3 normal(int i) const
+	{
+		if (vertices) return normals ? normals[i] : glm::vec3(0, 1, 0);
+		return mesh.getNormal(i);
+	}
+
 	ofMesh mesh;
+	const glm::vec3 *vertices = NULL;
+	const glm::vec3 *normals = NULL;
+	int numVertices = 0;
+	int levels = 0;      // numLevels of the last build
+	unsigned int version = 0;   // changes whenever the nodes do, see OctreeCursor
 	TreeNode root;
+
+private:
+	void subdivide(TreeNode & node, int numLevels, int level, Arena & arena);
+	bool intersect(const glm::vec3 & point, const TreeNode & node, glm::vec3* norm, OctreeCursor & cursor, int depth) const;
+	void nearestInLeaf(const glm::vec3 & point, const TreeNode & node, glm::vec3* norm) const;
+	void sweep(const TreeNode & node, const glm::vec3 & from, const glm::vec3 & delta, float radius, float tNode, SweepHit & hit) const;
+	void movePoint(TreeNode & node, int index, const glm::vec3 & from, const glm::vec3 & to, int level);
+	void insertChild(TreeNode & node, int index, const glm::vec3 & p, int level, const glm::vec3 *skip);
+	void removePoint(TreeNode & node, int index, const glm::vec3 & p);
+	void insertPoint(TreeNode & node, int index, const glm::vec3 & p, int level);
 };
\ No newline at end of file
@@ -0,0 +1,168 @@
+#include "OctreeBuilder.h"
+#include "Profiler.h"
+#include "PerfCounters.h"
+#include <chrono>
+
+void OctreeBuilder::start(const MeshView & view, int numLevels)
+{
+	tree.reset(new Octree());
+	tree->setMesh(view);
+	begin(numLevels);
+}
+
+void OctreeBuilder::start(const ofMesh & mesh, int numLevels)
+{
+	tree.reset(new Octree());
+	tree->setMesh(mesh);
+	begin(numLevels);
+}
+
+void OctreeBuilder::begin(int numLevels)
+{
+	tree->initRoot(numLevels);
+	stack.clear();
+	stack.push_back({ &tree->root, 1 });
+	current = NULL;
+	complete = false;
+	calls = 0;
+	longestCallMicros = totalMicros = 0;
+}
+
+//  The work of Octree::subdivide as a loop over an explicit stack.  A node
+//  is split in two passes over its points, in runs of a few hundred points
+//  between looks at the clock, so even the root of a big mesh is spread
+//  over many calls.  The first pass counts the points in each of the 8
+//  boxes, then the children are made with lists of exactly that size and
+//  the second pass fills them, so no list grows (and copies itself) inside
+//  a slice.  A node's children are only stacked once all of them are
+//  filled, so the pointers to them stay valid.
+//
+bool OctreeBuilder::step(int budgetMicros)
+{
+	PROFILE_SCOPE("OctreeBuilder::step");
+	if (tree == NULL) return false;
+	if (complete) return true;
+
+	chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+	chrono::steady_clock::time_point deadline = t0 + chrono::microseconds(budgetMicros);
+	const int run = 512;
+
+	for (;;)
+	{
+		if (current == NULL)
+		{
+			if (stack.empty())
+			{
+				complete = true;
+				break;
+			}
+			Task task = stack.back();
+			stack.pop_back();
+			if (task.level >= tree->levels) continue;
+			current = task.node;
+			currentLevel = task.level;
+			tree->subDivideBox8(current->box, boxes);
+			counting = true;
+			next = 0;
+			for (int b = 0; b < 8; b++)
+				counts[b] = 0;
+		}
+
+		int end = min(next + run, (int)current->points.size());
+		if (counting)
+		{
+			for (; next < end; next++)
+			{
+				glm::vec3 v = tree->vertex(current->points[next]);
+				for (int b = 0; b < 8; b++)
+					if (boxes[b].inside(v)) counts[b]++;
+			}
+		}
+		else
+		{
+			for (; next < end; next++)
+			{
+				int p = current->points[next];
+				glm::vec3 v = tree->vertex(p);
+				for (int b = 0; b < 8; b++)
+					if (childOf[b] >= 0 && boxes[b].inside(v)) current->children[childOf[b]].points.push_back(p);
+			}
+		}
+
+		if (next == current->points.size())
+		{
+			next = 0;
+			if (counting)
+			{
+				int numChildren = 0;
+				for (int b = 0; b < 8; b++)
+					if (counts[b] > 0) numChildren++;
+				current->children.resize(numChildren);
+				numChildren = 0;
+				for (int b = 0; b < 8; b++)
+				{
+					childOf[b] = counts[b] > 0 ? numChildren++ : -1;
+					if (childOf[b] < 0) continue;
+					TreeNode & child = current->children[childOf[b]];
+					child.box = boxes[b];
+					child.points.reserve(counts[b]);
+				}
+				counting = false;
+			}
+			else
+			{
+				for (int i = (int)current->children.size() - 1; i >= 0; i--)
+					if (current->children[i].points.size() > 1)
+						stack.push_back({ &current->children[i], currentLevel + 1 });
+				current = NULL;
+			}
+		}
+
+		if (chrono::steady_clock::now() >= deadline) break;
+	}
+
+	double micros = chrono::duration<double, micro>(chrono::steady_clock::now() - t0).count();
+	calls++;
+	totalMicros += micros;
+	longestCallMicros = max(longestCallMicros, micros);
+	PerfCounters::add(CounterOctreeBuildMicros, (int64_t)micros);
+	return complete;
+}
+
+unique_ptr<Octree> OctreeBuilder::take()
+{
+	if (!complete) return unique_ptr<Octree>();
+	complete = false;
+	current = NULL;
+	return move(tree);
+}
+
+//  take() into tree, the tree it replaces goes to release()
+//
+bool OctreeBuilder::swap(unique_ptr<Octree> & tree)
+{
+	if (!complete) return false;
+	chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+	unique_ptr<Octree> old = move(tree);
+	tree = take();
+	release(move(old));
+
+	double micros = chrono::duration<double, micro>(chrono::steady_clock::now() - t0).count();
+	calls++;
+	totalMicros += micros;
+	longestCallMicros = max(longestCallMicros, micros);
+	PerfCounters::add(CounterOctreeBuildMicros, (int64_t)micros);
+	return true;
+}
+
+//  delete a tree nothing uses any more on a background thread.  Only one
+//  is freed at a time; a tree released while the last one is still going
+//  waits for it, which only happens for rebuilds a few frames apart.
+//
+void OctreeBuilder::release(unique_ptr<Octree> old)
+{
+	if (old == NULL) return;
+	if (releasing.valid()) releasing.wait();
+	Octree *t = old.release();
+	releasing = async(launch::async, [t]() { delete t; });
+}
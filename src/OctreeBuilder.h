@@ -0,0 +1,62 @@
+#pragma once
+#include "ofMain.h"
+#include "Octree.h"
+#include <future>
+
+//  Builds an Octree a slice at a time, so a rebuild can run on the main
+//  thread without stalling a frame:
+//
+//      builder.start(terrain.view, numLevels);
+//      ...
+//      if (builder.active() && builder.step(2000)) builder.swap(tree);
+//
+//  step() subdivides until its time budget (microseconds) is used up and
+//  returns true once the tree is complete.  The tree being built is private
+//  to the builder, queries keep using the old one until take() hands the
+//  new one over.  The result is the same tree Octree::create() builds.
+//
+//  Freeing the old tree's nodes takes as long as a big build's slowest
+//  frames (about 120 ms for a million vertices), so swap() puts the new
+//  tree in its place and release() deletes the old one on a background
+//  thread, leaving the frame a pointer move.  Whatever pointed into the
+//  old tree has to be given the new one before it runs again.  The swap
+//  counts as one more call in the timings.
+//
+class OctreeBuilder
+{
+public:
+	void start(const MeshView & view, int numLevels);
+	void start(const ofMesh & mesh, int numLevels);
+	bool step(int budgetMicros);
+	bool active() const { return tree != NULL; }
+	unique_ptr<Octree> take();
+	bool swap(unique_ptr<Octree> & tree);
+	void release(unique_ptr<Octree> old);
+
+	// the last (or current) build
+	//
+	int calls = 0;
+	double longestCallMicros = 0;
+	double totalMicros = 0;
+
+private:
+	void begin(int numLevels);
+
+	struct Task
+	{
+		TreeNode *node;
+		int level;
+	};
+
+	unique_ptr<Octree> tree;
+	vector<Task> stack;        // nodes waiting to be subdivided
+	TreeNode *current = NULL;  // node being subdivided, its children in progress
+	int currentLevel = 0;
+	vector<Box> boxes;
+	bool counting = false;     // first pass over current's points, see step()
+	int next = 0;              // next point of current to test
+	int counts[8];             // points in each box
+	int childOf[8];            // index in current->children of each box, -1 if empty
+	bool complete = false;
+	future<void> releasing;    // the last tree given to release()
+};
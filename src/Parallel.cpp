@@ -0,0 +1,34 @@
+#include "Parallel.h"
+#include <atomic>
+#include <thread>
+
+int Parallel::hardwareThreads()
+{
+	int n = (int)thread::hardware_concurrency();
+	return n > 0 ? n : 1;
+}
+
+void Parallel::forEach(int count, const function<void(int, int)> & body, int numThreads, int chunk)
+{
+	if (numThreads <= 0) numThreads = hardwareThreads();
+	numThreads = max(1, min(numThreads, (count + chunk - 1) / max(chunk, 1)));
+
+	atomic<int> next(0);
+	auto worker = [&](int thread) {
+		for (;;)
+		{
+			int begin = next.fetch_add(chunk);
+			if (begin >= count) break;
+			int end = min(begin + chunk, count);
+			for (int i = begin; i < end; i++)
+				body(i, thread);
+		}
+	};
+
+	vector<std::thread> threads;
+	for (int t = 1; t < numThreads; t++)
+		threads.push_back(std::thread(worker, t));
+	worker(0);
+	for (int t = 0; t < threads.size(); t++)
+		threads[t].join();
+}
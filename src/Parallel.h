@@ -0,0 +1,17 @@
+#pragma once
+#include "ofMain.h"
+
+//  Minimal fork/join helpers for the headless batch tools.  Work is handed
+//  out in chunks from a shared atomic counter so uneven items (episodes that
+//  end early, rays that miss) balance across threads.
+//
+class Parallel
+{
+public:
+	static int hardwareThreads();
+
+	// body(i, thread) for every i in [0, count), on numThreads threads
+	// (0 = one per core), the calling thread takes part as thread 0
+	//
+	static void forEach(int count, const function<void(int, int)> & body, int numThreads = 0, int chunk = 1);
+};
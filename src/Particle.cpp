@@ -17,24 +17,9 @@ Particle::Particle() {
 	color = ofColor::aquamarine;
 }
 
-void Particle::draw() {
-	ofSetColor(color);
-//	ofSetColor(ofMap(age(), 0, lifespan, 255, 10), 0, 0);
-	ofDrawSphere(position, radius);
-}
-
-// write your own integrator here.. (hint: it's only 3 lines of code)
+// integrate over a fixed interval (sec), independent of the app's frame rate
 //
-void Particle::integrate() {
-
-	// check for 0 framerate to avoid divide errors
-	//
-	float framerate = ofGetFrameRate();
-	if (framerate < 1.0) return;
-
-	// interval for this step
-	//
-	float dt = 1.0 / framerate;
+void Particle::integrate(float dt) {
 
 	// update position based on velocity
 	//
@@ -19,6 +19,7 @@ public:
 	float   radius;
 	float   birthtime;
 	void    integrate();
+	void    integrate(float dt);
 	void    draw();
 	float   age();        // sec
 	ofColor color;
@@ -2,6 +2,8 @@
 //  Kevin M. Smith - CS 134 SJSU
 
 #include "ParticleEmitter.h"
+#include "Profiler.h"
+#include "PerfCounters.h"
 
 ParticleEmitter::ParticleEmitter() 
 {
@@ -22,6 +24,20 @@ ParticleEmitter::ParticleEmitter(ParticleSystem *s)
 	init();
 }
 
+//  the world updates the particles, update() here only spawns them
+//
+ParticleEmitter::ParticleEmitter(ParticleWorld *world) 
+{
+	if (world == NULL)
+	{
+		cout << "fatal error: null particle world passed to ParticleEmitter()" << endl;
+		ofExit();
+	}
+	sys = world->createSystem();
+	createdSys = false;
+	init();
+}
+
 ParticleEmitter::~ParticleEmitter() {
 
 	// deallocate particle system if emitter created one internally
@@ -49,26 +65,11 @@ void ParticleEmitter::init()
 	damping = .99;
 	particleColor = ofColor::red;
 	position = ofVec3f(0, 0, 0);
+	random = &SimRandom::shared();
 }
 
 
 
-void ParticleEmitter::draw() {
-	if (visible) {
-		switch (type) {
-		case DirectionalEmitter:
-			ofDrawSphere(position, radius/10);  // just draw a small sphere for point emitters 
-			break;
-		case SphereEmitter:
-		case RadialEmitter:
-			ofDrawSphere(position, radius/10);  // just draw a small sphere as a placeholder
-			break;
-		default:
-			break;
-		}
-	}
-	sys->draw();  
-}
 void ParticleEmitter::start() {
 	if (started) return;
 	started = true;
@@ -79,7 +80,8 @@ void ParticleEmitter::stop() {
 	started = false;
 	fired = false;
 }
-void ParticleEmitter::update() {
+void ParticleEmitter::update(float dt) {
+	PROFILE_SCOPE("ParticleEmitter::update");
 
 	float time = ofGetElapsedTimeMillis();
 
@@ -108,7 +110,7 @@ void ParticleEmitter::update() {
 		lastSpawned = time;
 	}
 
-	sys->update();
+	sys->update(dt);
 }
 
 // spawn a single particle.  time is current time of birth
@@ -124,7 +126,7 @@ void ParticleEmitter::spawn(float time) {
 	{
 	case RadialEmitter:
 	{
-		ofVec3f dir = ofVec3f(ofRandom(-1, 1), ofRandom(-1, 1), ofRandom(-1, 1));
+		ofVec3f dir = ofVec3f(random->range(-1, 1), random->range(-1, 1), random->range(-1, 1));
 		float speed = velocity.length();
 		particle.velocity = dir.getNormalized() * speed;
 		particle.position = position;
@@ -142,7 +144,7 @@ void ParticleEmitter::spawn(float time) {
 	// other particle attributes
 	//
 	if (randomLife) {
-		particle.lifespan = ofRandom(lifeMinMax.x, lifeMinMax.y);
+		particle.lifespan = random->range(lifeMinMax.x, lifeMinMax.y);
 	}
 	else particle.lifespan = lifespan;
 	particle.birthtime = time;
@@ -154,4 +156,5 @@ void ParticleEmitter::spawn(float time) {
 	// add to system
 	//
 	sys->add(particle);
+	PerfCounters::add(CounterParticlesSpawned);
 }
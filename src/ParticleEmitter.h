@@ -3,6 +3,7 @@
 
 #include "TransformObject.h"
 #include "ParticleSystem.h"
+#include "ParticleWorld.h"
 
 typedef enum { DirectionalEmitter, RadialEmitter, SphereEmitter } EmitterType;
 
@@ -13,6 +14,7 @@ class ParticleEmitter : public TransformObject {
 public:
 	ParticleEmitter();
 	ParticleEmitter(ParticleSystem *s);
+	ParticleEmitter(ParticleWorld *world);   // spawns into a view the world owns
 	~ParticleEmitter();
 	void init();
 	void draw();
@@ -30,8 +32,10 @@ public:
 	void setMass(float m) { mass = m; }
 	void setDamping(float d) { damping = d; }
 	void update();
+	void update(float dt);     // spawn what's due, then step the system over dt
 	void spawn(float time);
 	ParticleSystem *sys;
+	SimRandom *random;  // spread and lifespans, SimRandom::shared() by default
 	float rate;         // per sec
 	bool oneShot;
 	bool fired;
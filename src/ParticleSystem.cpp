@@ -2,23 +2,48 @@
 // Kevin M.Smith - CS 134 SJSU
 
 #include "ParticleSystem.h"
+#include "ParticleWorld.h"
+#include "Profiler.h"
+#include "PerfCounters.h"
+#include "Parallel.h"
 
+// a view's particles are added to its world, they show up in its range
+// after the world's next update
+//
 void ParticleSystem::add(const Particle &p) {
-	particles.push_back(p);
+	if (world) world->spawn(tag, p);
+	else particles.push_back(p);
 }
 
 void ParticleSystem::addForce(ParticleForce *f) {
 	f->applied = false;
 	forces.push_back(f);
+	PerfCounters::add(CounterForcesAdded);
+}
+
+// same as adding an ImpulseForce of that size, without allocating one
+//
+void ParticleSystem::addImpulse(const glm::vec3 & force) {
+	impulses.push_back(force);
 }
 
 void ParticleSystem::remove(int i) {
-	particles.erase(particles.begin() + i);
+	if (world) world->remove(tag, i);
+	else particles.erase(particles.begin() + i);
+}
+
+int ParticleSystem::size() const {
+	return world ? world->ranges[tag].count : (int)particles.size();
+}
+
+Particle * ParticleSystem::data() {
+	return world ? world->particles.data() + world->ranges[tag].first : particles.data();
 }
 
 void ParticleSystem::setLifespan(float l) {
-	for (int i = 0; i < particles.size(); i++) {
-		particles[i].lifespan = l;
+	Particle *p = data();
+	for (int i = 0; i < size(); i++) {
+		p[i].lifespan = l;
 	}
 }
 
@@ -28,7 +53,15 @@ void ParticleSystem::reset() {
 	}
 }
 
-void ParticleSystem::update() {
+// same as update() but steps over a caller supplied interval (sec) so the
+// system can be run at a fixed rate without a window
+//
+void ParticleSystem::update(float dt) {
+	PROFILE_SCOPE("ParticleSystem::update");
+
+	// views are updated together by their world
+	if (world) return;
+
 	// check if empty and just return
 	if (particles.size() == 0) return;
 
@@ -43,6 +76,7 @@ void ParticleSystem::update() {
 		if (p->lifespan != -1 && p->age() > p->lifespan) {
 			tmp = particles.erase(p);
 			p = tmp;
+			PerfCounters::add(CounterParticlesExpired);
 		}
 		else p++;
 	}
@@ -54,7 +88,10 @@ void ParticleSystem::update() {
 			if (!forces[k]->applied)
 				forces[k]->updateForce( &particles[i] );
 		}
+		for (int k = 0; k < impulses.size(); k++)
+			particles[i].forces += impulses[k];
 	}
+	impulses.clear();
 
 	// update all forces only applied once to "applied"
 	// so they are not applied again.
@@ -66,38 +103,111 @@ void ParticleSystem::update() {
 			delete forces[i];
 			forces.erase(forces.begin() + i);
 			i--;
+			PerfCounters::add(CounterForcesDeleted);
 		}
 	}
 
 	// integrate all the particles in the store
 	//
 	for (int i = 0; i < particles.size(); i++)
-		particles[i].integrate();
+		particles[i].integrate(dt);
+
+	PerfCounters::add(CounterParticlesLive, particles.size());
+
+	if (sortMode != SortNone) sort();
+}
+
+// spread the low 10 bits of v out to every third bit
+//
+static uint32_t spreadBits(uint32_t v)
+{
+	v &= 0x3FF;
+	v = (v | (v << 16)) & 0x030000FF;
+	v = (v | (v << 8)) & 0x0300F00F;
+	v = (v | (v << 4)) & 0x030C30C3;
+	v = (v | (v << 2)) & 0x09249249;
+	return v;
+}
+
+// reorder the particles by sortMode with a radix sort of one 32 bit key
+// each (a 30 bit Morton code, or the depth as an order preserving integer)
+// and one gather of the particles into the new order (copied back into a
+// view's range)
+//
+void ParticleSystem::sort() {
+	PROFILE_SCOPE("ParticleSystem::sort");
+
+	int n = size();
+	if (n < 2 || sortMode == SortNone) return;
+	Particle *ps = data();
 
+	glm::vec3 lo = ps[0].position, hi = lo;
+	if (sortMode == SortMorton) {
+		for (int i = 1; i < n; i++) {
+			lo = glm::min(lo, ps[i].position);
+			hi = glm::max(hi, ps[i].position);
+		}
+	}
+	glm::vec3 scale = glm::vec3(1023, 1023, 1023) / glm::max(hi - lo, glm::vec3(1e-6, 1e-6, 1e-6));
+
+	const int chunk = 16384;
+	sortKeys.resize(n);
+	sortOrder.resize(n);
+	Parallel::forEach((n + chunk - 1) / chunk, [&](int c, int thread) {
+		int end = min(n, (c + 1) * chunk);
+		for (int i = c * chunk; i < end; i++) {
+			const glm::vec3 & p = ps[i].position;
+			uint32_t key;
+			if (sortMode == SortMorton) {
+				glm::vec3 q = (p - lo) * scale;
+				key = spreadBits((uint32_t)q.x) | (spreadBits((uint32_t)q.y) << 1) | (spreadBits((uint32_t)q.z) << 2);
+			}
+			else {
+				// float bits flipped so they order like the floats, then
+				// inverted for farthest first
+				//
+				float depth = glm::dot(p - sortEye, sortDir);
+				uint32_t bits;
+				memcpy(&bits, &depth, sizeof(bits));
+				bits = (bits & 0x80000000) ? ~bits : (bits | 0x80000000);
+				key = ~bits;
+			}
+			sortKeys[i] = key;
+			sortOrder[i] = i;
+		}
+	}, sortThreads);
+
+	radix.sort(sortKeys, sortOrder, sortThreads);
+
+	sortScratch.resize(n);
+	Parallel::forEach((n + chunk - 1) / chunk, [&](int c, int thread) {
+		int end = min(n, (c + 1) * chunk);
+		for (int i = c * chunk; i < end; i++)
+			sortScratch[i] = ps[sortOrder[i]];
+	}, sortThreads);
+	if (world) copy(sortScratch.begin(), sortScratch.begin() + n, ps);
+	else particles.swap(sortScratch);
 }
 
-void ParticleSystem::test(Particle* p)
+// apply the current forces to p and integrate it without touching the
+// system, so callers can see where a particle would be after the next step
+//
+void ParticleSystem::test(Particle* p, float dt)
 {
 	for (int k = 0; k < forces.size(); k++)
 	{
 		if (!forces[k]->applied)
 			forces[k]->updateForce(p);
 	}
-	p->integrate();
+	for (int k = 0; k < impulses.size(); k++)
+		p->forces += impulses[k];
+	p->integrate(dt);
 }
 
 // remove all particlies within "dist" of point (not implemented as yet)
 //
 int ParticleSystem::removeNear(const glm::vec3 & point, float dist) { return 0; }
 
-//  draw the particle cloud
-//
-void ParticleSystem::draw() {
-	for (int i = 0; i < particles.size(); i++) {
-		particles[i].draw();
-	}
-}
-
 
 // Gravity Force Field 
 //
@@ -124,9 +234,9 @@ void TurbulenceForce::updateForce(Particle * particle) {
 	// We are going to add a little "noise" to a particles
 	// forces to achieve a more natual look to the motion
 	//
-	particle->forces.x += ofRandom(tmin.x, tmax.x);
-	particle->forces.y += ofRandom(tmin.y, tmax.y);
-	particle->forces.z += ofRandom(tmin.z, tmax.z);
+	particle->forces.x += random->range(tmin.x, tmax.x);
+	particle->forces.y += random->range(tmin.y, tmax.y);
+	particle->forces.z += random->range(tmin.z, tmax.z);
 }
 
 // Impulse Radial Force - this is a "one shot" force that
@@ -157,7 +267,7 @@ void ImpulseRadialForce::updateForce(Particle * particle) {
 	// we basically create a random direction for each particle
 	// the force is only added once after it is triggered.
 	//
-	glm::vec3 dir = glm::vec3(ofRandom(-1, 1), ofRandom(-height/2.0, height/2.0), ofRandom(-1, 1));
+	glm::vec3 dir = glm::vec3(random->range(-1, 1), random->range(-height/2.0, height/2.0), random->range(-1, 1));
 	particle->forces += glm::normalize(dir) * magnitude;
 }
 
@@ -3,6 +3,8 @@
 
 #include "ofMain.h"
 #include "Particle.h"
+#include "RadixSort.h"
+#include "SimRandom.h"
 
 
 //  Pure Virtual Function Class - must be subclassed to create new forces.
@@ -10,25 +12,66 @@
 class ParticleForce {
 protected:
 public:
+	virtual ~ParticleForce() {}
 	bool applyOnce = false;
 	bool applied = false;
+	SimRandom *random = &SimRandom::shared();   // for forces with a random part
 	virtual void updateForce(Particle *) = 0;
 };
 
+//  Order update() leaves the particles in: as spawned, along a Morton curve
+//  over their bounds (neighbours in space are neighbours in memory), or by
+//  depth from a camera, farthest first for alpha blending.
+//
+typedef enum { SortNone, SortMorton, SortDepth } ParticleSortMode;
+
+class ParticleWorld;
+
+//  A system owns its particles in the particles vector, unless it was made
+//  by ParticleWorld::createSystem().  Then it is a view: its forces stay
+//  here, its particles are a range of the world's pool (size(), data(),
+//  operator[]) and the world's update() moves them.
+//
 class ParticleSystem {
 public:
 	void add(const Particle &);
 	void addForce(ParticleForce *);
+	void addImpulse(const glm::vec3 & force);
 	void removeForces() { forces.clear(); }
 	void remove(int);
 	void update();
+	void update(float dt);
 	void test(Particle* p);
+	void test(Particle* p, float dt);
 	void setLifespan(float);
 	void reset();
 	int removeNear(const glm::vec3 & point, float dist);
 	void draw();
-	vector<Particle> particles;
+	void sort();
+	void setSortCamera(const glm::vec3 & eye, const glm::vec3 & dir) { sortEye = eye; sortDir = dir; }
+	int size() const;
+	Particle * data();
+	Particle & operator[](int i) { return data()[i]; }
+	vector<Particle> particles;     // unused by views
+	ParticleWorld *world = NULL;    // set for views
+	int tag = -1;                   // index of a view in its world
 	vector<ParticleForce *> forces;
+
+	// one shot forces for the next update, applied to every particle after
+	// the forces above.  Kept in a vector that is cleared, not freed, so
+	// thrust input does no heap work once it has grown.
+	//
+	vector<glm::vec3> impulses;
+
+	ParticleSortMode sortMode = SortNone;
+	glm::vec3 sortEye = glm::vec3(0, 0, 0);
+	glm::vec3 sortDir = glm::vec3(0, 0, -1);
+	int sortThreads = 1;     // 0 = one per core
+
+private:
+	RadixSort radix;
+	vector<uint32_t> sortKeys, sortOrder;
+	vector<Particle> sortScratch;
 };
 
 
@@ -0,0 +1,199 @@
+#include "ParticleWorld.h"
+#include "Profiler.h"
+#include "PerfCounters.h"
+
+ParticleSystem * ParticleWorld::createSystem()
+{
+	ParticleSystem *sys = new ParticleSystem();
+	sys->world = this;
+	sys->tag = (int)systems.size();
+	systems.push_back(unique_ptr<ParticleSystem>(sys));
+	ranges.push_back(Range());
+	ranges.back().first = (int)particles.size();
+	return sys;
+}
+
+void ParticleWorld::spawn(int tag, const Particle & p)
+{
+	ranges[tag].spawned.push_back(p);
+}
+
+void ParticleWorld::remove(int tag, int i)
+{
+	Range & range = ranges[tag];
+	Particle *p = particles.data() + range.first;
+	copy(p + i + 1, p + range.count, p + i);
+	positions.erase(positions.begin() + range.offset + i);
+	range.count--;
+	for (int s = tag + 1; s < ranges.size(); s++)
+		ranges[s].offset--;
+}
+
+//  replace a system's particles (restoring a snapshot), call gather()
+//  once all systems are set
+//
+void ParticleWorld::setParticles(int tag, const Particle *p, int n)
+{
+	Range & range = ranges[tag];
+	range.count = 0;
+	if (n > range.capacity)
+	{
+		// layout() makes room for them as if they were spawned
+		vector<Particle> pending;
+		range.spawned.swap(pending);
+		range.spawned.assign(p, p + n);
+		layout();
+		range.spawned.swap(pending);
+	}
+	copy(p, p + n, particles.begin() + range.first);
+	range.count = n;
+}
+
+//  positions and offsets from the slots as they are
+//
+void ParticleWorld::gather()
+{
+	int live = 0;
+	for (int s = 0; s < ranges.size(); s++)
+		live += ranges[s].count;
+	positions.resize(live);
+	live = 0;
+	for (int s = 0; s < ranges.size(); s++)
+	{
+		Range & range = ranges[s];
+		range.offset = live;
+		for (int i = 0; i < range.count; i++)
+			positions[live++] = particles[range.first + i].position;
+	}
+}
+
+//  drop every particle, spawned or live, the systems and slots stay
+//
+void ParticleWorld::clear()
+{
+	for (int s = 0; s < ranges.size(); s++)
+	{
+		ranges[s].count = 0;
+		ranges[s].offset = 0;
+		ranges[s].spawned.clear();
+	}
+	positions.clear();
+}
+
+//  give every slot room for its particles and new ones, plus half again
+//
+void ParticleWorld::layout()
+{
+	PROFILE_SCOPE("ParticleWorld::layout");
+
+	int total = 0;
+	for (int s = 0; s < ranges.size(); s++)
+	{
+		int needed = ranges[s].count + (int)ranges[s].spawned.size();
+		total += max(ranges[s].capacity, needed + needed / 2);
+	}
+	scratch.resize(total);
+	int first = 0;
+	for (int s = 0; s < ranges.size(); s++)
+	{
+		Range & range = ranges[s];
+		int needed = range.count + (int)range.spawned.size();
+		copy(particles.begin() + range.first, particles.begin() + range.first + range.count, scratch.begin() + first);
+		range.first = first;
+		range.capacity = max(range.capacity, needed + needed / 2);
+		first += range.capacity;
+	}
+	particles.swap(scratch);
+	scratch.clear();
+}
+
+//  ParticleSystem::update for every view at once.  Each system's new
+//  particles go after its live ones, then one loop over the slot skips the
+//  expired ones, packing the rest to the front, and forces and integrates
+//  them.  Expiry is a skipped copy instead of an erase, and the clock is
+//  read once per update instead of once per particle.
+//
+void ParticleWorld::update(float dt)
+{
+	PROFILE_SCOPE("ParticleWorld::update");
+
+	int total = 0;
+	bool fits = true;
+	for (int s = 0; s < ranges.size(); s++)
+	{
+		int needed = ranges[s].count + (int)ranges[s].spawned.size();
+		total += needed;
+		if (needed > ranges[s].capacity) fits = false;
+	}
+	if (!fits) layout();
+	positions.resize(total);
+
+	uint64_t now = ofGetElapsedTimeMillis();
+	int expired = 0;
+	int live = 0;
+	for (int s = 0; s < systems.size(); s++)
+	{
+		ParticleSystem & sys = *systems[s];
+		Range & range = ranges[s];
+		vector<ParticleForce *> & forces = sys.forces;
+		vector<glm::vec3> & impulses = sys.impulses;
+
+		// the order a system of its own keeps them in, old then spawned
+		//
+		Particle *p = particles.data() + range.first;
+		copy(range.spawned.begin(), range.spawned.end(), p + range.count);
+		int n = range.count + (int)range.spawned.size();
+		range.spawned.clear();
+
+		range.offset = live;
+		int out = 0;
+		for (int i = 0; i < n; i++)
+		{
+			if (p[i].lifespan != -1 && (now - p[i].birthtime) / 1000.0 > p[i].lifespan)
+			{
+				expired++;
+				continue;
+			}
+			if (out != i) p[out] = p[i];
+			Particle & q = p[out++];
+			for (int k = 0; k < forces.size(); k++)
+			{
+				if (!forces[k]->applied)
+					forces[k]->updateForce(&q);
+			}
+			for (int k = 0; k < impulses.size(); k++)
+				q.forces += impulses[k];
+			q.integrate(dt);
+			positions[live++] = q.position;
+		}
+		range.count = out;
+		impulses.clear();
+
+		// one shot forces have been applied to every particle
+		//
+		for (int i = 0; i < forces.size(); i++)
+		{
+			if (forces[i]->applyOnce)
+			{
+				delete forces[i];
+				forces.erase(forces.begin() + i);
+				i--;
+				PerfCounters::add(CounterForcesDeleted);
+			}
+		}
+	}
+	positions.resize(live);
+	PerfCounters::add(CounterParticlesExpired, expired);
+	PerfCounters::add(CounterParticlesLive, live);
+
+	// sorted systems reorder their own slot, positions follow
+	//
+	for (int s = 0; s < systems.size(); s++)
+	{
+		Range & range = ranges[s];
+		if (systems[s]->sortMode == SortNone || range.count < 2) continue;
+		systems[s]->sort();
+		for (int i = 0; i < range.count; i++)
+			positions[range.offset + i] = particles[range.first + i].position;
+	}
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "ofMain.h"
+#include "ParticleSystem.h"
+
+//  One pool of particles for any number of systems.  createSystem() returns
+//  a view (see ParticleSystem.h) tagged with its index; its particles are
+//  the first count of a slot of capacity particles in the pool, the slots
+//  in the order the systems were made.  update() runs every system in one
+//  pass over the pool: it appends the particles spawned since the last
+//  update, drops expired ones by packing the rest in place, adds each
+//  system's forces and impulses and integrates, and writes the positions
+//  of all of them into positions, so every emitter uploads to one vbo.  A
+//  particle sees the same forces in the same order as in a system of its
+//  own.  Only when a system outgrows its slot are the slots laid out again,
+//  with half as much again to spare.
+//
+//      ParticleWorld world;
+//      ParticleEmitter smoke(&world), sparks(&world);
+//      ...
+//      smoke.update(); sparks.update();     // spawn
+//      world.update(dt);                    // move everything
+//
+class ParticleWorld
+{
+public:
+	ParticleWorld() {}
+	ParticleWorld(const ParticleWorld &) = delete;     // views point at it
+	ParticleWorld & operator=(const ParticleWorld &) = delete;
+
+	ParticleSystem * createSystem();
+	void update();
+	void update(float dt);
+	void spawn(int tag, const Particle & p);
+	void remove(int tag, int i);
+	void setParticles(int tag, const Particle *p, int n);
+	void gather();
+	void clear();
+	int size() const { return (int)positions.size(); }    // live particles
+
+	struct Range
+	{
+		int first = 0;
+		int count = 0;
+		int capacity = 0;
+		int offset = 0;               // of its particles in positions
+		vector<Particle> spawned;     // added since the last update
+	};
+
+	vector<unique_ptr<ParticleSystem> > systems;   // indexed by tag
+	vector<Range> ranges;
+	vector<Particle> particles;     // slots, unused past each count
+	vector<glm::vec3> positions;    // live particles, packed, for uploading
+
+private:
+	void layout();
+	vector<Particle> scratch;
+};
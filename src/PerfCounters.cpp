@@ -0,0 +1,68 @@
+#include "PerfCounters.h"
+
+thread_local int64_t PerfCounters::counts[NumPerfCounters] = {};
+int64_t PerfCounters::snapshot[NumPerfCounters] = {};
+uint64_t PerfCounters::frame = 0;
+ofstream PerfCounters::csv;
+
+const char* PerfCounters::name(PerfCounter c)
+{
+	static const char* names[NumPerfCounters] = {
+		"octree queries",
+		"octree nodes visited",
+		"octree leaf points tested",
+		"particles spawned",
+		"particles expired",
+		"particles live",
+		"forces added",
+		"forces deleted",
+		"vbo bytes uploaded",
+		"heap allocations",
+		"octree build us",
+	};
+	return names[c];
+}
+
+void PerfCounters::endFrame()
+{
+	for (int i = 0; i < NumPerfCounters; i++)
+	{
+		snapshot[i] = counts[i];
+		counts[i] = 0;
+	}
+	frame++;
+
+	if (csv.is_open())
+	{
+		csv << frame << "," << ofGetElapsedTimeMillis();
+		for (int i = 0; i < NumPerfCounters; i++)
+			csv << "," << snapshot[i];
+		csv << "\n";
+	}
+}
+
+bool PerfCounters::startCsv(const string & path)
+{
+	stopCsv();
+	csv.open(path);
+	if (!csv.is_open())
+	{
+		cout << "can't write counters to " << path << endl;
+		return false;
+	}
+	csv << "frame,time_ms";
+	for (int i = 0; i < NumPerfCounters; i++)
+	{
+		string column = name((PerfCounter)i);
+		replace(column.begin(), column.end(), ' ', '_');
+		csv << "," << column;
+	}
+	csv << "\n";
+	cout << "writing counters to " << path << endl;
+	return true;
+}
+
+void PerfCounters::stopCsv()
+{
+	if (csv.is_open()) csv.close();
+}
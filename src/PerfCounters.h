@@ -0,0 +1,55 @@
+#pragma once
+#include "ofMain.h"
+
+//  Per-frame performance counters.  Each thread increments its own copy of
+//  the counters (a thread_local add, no atomics), and the main thread calls
+//  endFrame() once per frame to snapshot and reset its counts.  Counts made
+//  on worker threads are not included in the frame snapshot.
+//
+//  Heap allocations are counted by the operator new in AllocCounter.cpp,
+//  which replaces the global one in debug and profiling builds, or when
+//  LANDER_COUNT_ALLOCS is defined.
+//
+#if defined(_DEBUG) || defined(LANDER_PROFILE) || defined(LANDER_COUNT_ALLOCS)
+#define LANDER_COUNT_ALLOCS_ENABLED 1
+#endif
+
+enum PerfCounter
+{
+	CounterOctreeQueries,           // top level Octree::intersect calls
+	CounterOctreeNodesVisited,
+	CounterOctreeLeafPointsTested,
+	CounterParticlesSpawned,
+	CounterParticlesExpired,
+	CounterParticlesLive,           // summed over every ParticleSystem::update
+	CounterForcesAdded,
+	CounterForcesDeleted,
+	CounterVboBytes,
+	CounterHeapAllocations,         // only counted with LANDER_COUNT_ALLOCS_ENABLED
+	CounterOctreeBuildMicros,       // time spent in OctreeBuilder::step
+	NumPerfCounters
+};
+
+class PerfCounters
+{
+public:
+	static void add(PerfCounter c, int64_t n = 1) { counts[c] += n; }
+	static const char* name(PerfCounter c);
+
+	// snapshot of the last completed frame
+	//
+	static void endFrame();
+	static int64_t lastFrame(PerfCounter c) { return snapshot[c]; }
+
+	// stream every frame snapshot to a CSV file
+	//
+	static bool startCsv(const string & path);
+	static void stopCsv();
+	static bool writingCsv() { return csv.is_open(); }
+
+private:
+	static thread_local int64_t counts[NumPerfCounters];
+	static int64_t snapshot[NumPerfCounters];
+	static uint64_t frame;
+	static ofstream csv;
+};
@@ -0,0 +1,136 @@
+#include "Profiler.h"
+#include <chrono>
+#include <iomanip>
+
+atomic<bool> Profiler::active(false);
+int Profiler::framesLeft = 0;
+string Profiler::capturePath;
+
+// every thread that records gets one ring, they live until exit so the
+// exporter can always drain them
+//
+static mutex ringsMutex;
+static vector<unique_ptr<ProfileRing> > rings;
+static thread_local ProfileRing* localRing = NULL;
+
+bool ProfileRing::push(const ProfileEvent & e)
+{
+	uint32_t h = head.load(memory_order_relaxed);
+	if (h - tail.load(memory_order_acquire) >= capacity)
+	{
+		dropped++;
+		return false;
+	}
+	events[h & (capacity - 1)] = e;
+	head.store(h + 1, memory_order_release);
+	return true;
+}
+
+void ProfileRing::drain(vector<ProfileEvent> & out)
+{
+	uint32_t t = tail.load(memory_order_relaxed);
+	uint32_t h = head.load(memory_order_acquire);
+	for (; t != h; t++)
+		out.push_back(events[t & (capacity - 1)]);
+	tail.store(t, memory_order_release);
+}
+
+uint64_t Profiler::now()
+{
+	static const chrono::steady_clock::time_point epoch = chrono::steady_clock::now();
+	return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - epoch).count();
+}
+
+ProfileRing* Profiler::threadRing()
+{
+	if (localRing == NULL)
+	{
+		lock_guard<mutex> lock(ringsMutex);
+		rings.push_back(unique_ptr<ProfileRing>(new ProfileRing()));
+		localRing = rings.back().get();
+		localRing->threadIndex = (int)rings.size();
+	}
+	return localRing;
+}
+
+void Profiler::record(const char* name, uint64_t start, uint64_t end)
+{
+	ProfileEvent e;
+	e.name = name;
+	e.start = start;
+	e.duration = end - start;
+	threadRing()->push(e);
+}
+
+void Profiler::beginCapture(int numFrames, const string & path)
+{
+	if (capturing()) return;
+
+	// throw away anything left over from an earlier capture
+	//
+	vector<ProfileEvent> stale;
+	{
+		lock_guard<mutex> lock(ringsMutex);
+		for (int i = 0; i < rings.size(); i++)
+			rings[i]->drain(stale);
+	}
+
+	framesLeft = numFrames;
+	capturePath = path;
+	active.store(true);
+	cout << "profiling " << numFrames << " frames" << endl;
+}
+
+//  call once per frame from the main thread
+//
+void Profiler::frameMark()
+{
+	if (!capturing()) return;
+	if (--framesLeft > 0) return;
+
+	active.store(false);
+	exportChromeTrace(capturePath);
+}
+
+//  write all buffered events in the Chrome trace event format, which both
+//  chrome://tracing and ui.perfetto.dev open
+//
+bool Profiler::exportChromeTrace(const string & path)
+{
+	ofstream out(path);
+	if (!out)
+	{
+		cout << "can't write profile to " << path << endl;
+		return false;
+	}
+
+	lock_guard<mutex> lock(ringsMutex);
+	out << fixed << setprecision(3);
+	out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [" << endl;
+	bool first = true;
+	int count = 0;
+	uint64_t dropped = 0;
+	vector<ProfileEvent> events;
+	for (int i = 0; i < rings.size(); i++)
+	{
+		events.clear();
+		rings[i]->drain(events);
+		dropped += rings[i]->dropped.exchange(0);
+
+		int tid = rings[i]->threadIndex;
+		out << (first ? "" : ",\n") << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << tid
+			<< ", \"args\": {\"name\": \"thread " << tid << "\"}}";
+		first = false;
+		for (int k = 0; k < events.size(); k++)
+		{
+			out << ",\n{\"name\": \"" << events[k].name << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << tid
+				<< ", \"ts\": " << events[k].start / 1000.0 << ", \"dur\": " << events[k].duration / 1000.0 << "}";
+		}
+		count += (int)events.size();
+	}
+	out << endl << "]}" << endl;
+	cout << "wrote " << count << " profile events to " << path;
+	if (dropped > 0) cout << " (" << dropped << " dropped, ring buffer full)";
+	cout << endl;
+	return true;
+}
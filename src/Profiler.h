@@ -0,0 +1,89 @@
+#pragma once
+#include "ofMain.h"
+#include <atomic>
+
+//  Lightweight hot-path profiler.  PROFILE_SCOPE("name") times the enclosing
+//  scope while a capture is running and pushes the event into a ring buffer
+//  owned by the calling thread, so recording never takes a lock.  When no
+//  capture is running a scope costs one relaxed atomic load.
+//
+//  Scopes are compiled in for debug builds, or for release builds when
+//  LANDER_PROFILE is defined; otherwise the macros expand to nothing.
+//
+#if defined(_DEBUG) || defined(LANDER_PROFILE)
+#define LANDER_PROFILE_ENABLED 1
+#endif
+
+struct ProfileEvent
+{
+	const char* name;   // must be a string literal (only the pointer is stored)
+	uint64_t start;     // ns since Profiler::now() epoch
+	uint64_t duration;  // ns
+};
+
+//  single producer (the owning thread), single consumer (the exporter)
+//
+class ProfileRing
+{
+public:
+	static const uint32_t capacity = 1 << 16;
+	bool push(const ProfileEvent & e);
+	void drain(vector<ProfileEvent> & out);
+
+	int threadIndex = 0;
+	atomic<uint64_t> dropped{ 0 };
+
+private:
+	ProfileEvent events[capacity];
+	atomic<uint32_t> head{ 0 };  // written by the producer
+	atomic<uint32_t> tail{ 0 };  // written by the consumer
+};
+
+class Profiler
+{
+public:
+	static uint64_t now();
+	static bool capturing() { return active.load(memory_order_relaxed); }
+	static void record(const char* name, uint64_t start, uint64_t end);
+
+	// capture the next numFrames frames (counted by frameMark) and write
+	// them to path as a Chrome trace / Perfetto JSON file
+	//
+	static void beginCapture(int numFrames, const string & path);
+	static void frameMark();
+	static bool exportChromeTrace(const string & path);
+
+private:
+	static ProfileRing* threadRing();
+	static atomic<bool> active;
+	static int framesLeft;
+	static string capturePath;
+};
+
+class ProfileScope
+{
+public:
+	ProfileScope(const char* name) : name(name), on(name != NULL && Profiler::capturing())
+	{
+		if (on) start = Profiler::now();
+	}
+	~ProfileScope()
+	{
+		if (on) Profiler::record(name, start, Profiler::now());
+	}
+
+private:
+	const char* name;
+	bool on;
+	uint64_t start = 0;
+};
+
+#ifdef LANDER_PROFILE_ENABLED
+#define PROFILE_CONCAT2(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT2(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_SCOPE_IF(cond, name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)((cond) ? (name) : NULL)
+#else
+#define PROFILE_SCOPE(name)
+#define PROFILE_SCOPE_IF(cond, name)
+#endif
@@ -0,0 +1,85 @@
+#include "RadixSort.h"
+#include "Parallel.h"
+
+void RadixSort::sort(vector<uint32_t> & keys, vector<uint32_t> & values, int numThreads)
+{
+	int n = (int)keys.size();
+	if (n < 2) return;
+	if (numThreads <= 0) numThreads = Parallel::hardwareThreads();
+
+	// a few blocks per thread so uneven threads still balance, but not so
+	// many that the counts outweigh the keys
+	//
+	const int minBlock = 16384;
+	int numBlocks = max(1, min(numThreads * 4, n / minBlock));
+	int blockSize = (n + numBlocks - 1) / numBlocks;
+	keyScratch.resize(n);
+	valueScratch.resize(n);
+	counts.resize(numBlocks * 256);
+
+	vector<uint32_t> *srcKeys = &keys, *srcValues = &values;
+	vector<uint32_t> *dstKeys = &keyScratch, *dstValues = &valueScratch;
+	for (int shift = 0; shift < 32; shift += 8)
+	{
+		Parallel::forEach(numBlocks, [&](int b, int thread) {
+			uint32_t *c = &counts[b * 256];
+			fill(c, c + 256, 0);
+			const uint32_t *k = srcKeys->data();
+			int end = min(n, (b + 1) * blockSize);
+			for (int i = b * blockSize; i < end; i++)
+				c[(k[i] >> shift) & 0xFF]++;
+		}, numThreads);
+
+		// the pass changes nothing if one digit has every key
+		//
+		bool oneDigit = false;
+		for (int d = 0; d < 256 && !oneDigit; d++)
+		{
+			uint32_t total = 0;
+			for (int b = 0; b < numBlocks; b++)
+				total += counts[b * 256 + d];
+			if (total == n) oneDigit = true;
+			else if (total > 0) break;
+		}
+		if (oneDigit) continue;
+
+		// counts become write offsets: digit major, then block
+		//
+		uint32_t offset = 0;
+		for (int d = 0; d < 256; d++)
+		{
+			for (int b = 0; b < numBlocks; b++)
+			{
+				uint32_t c = counts[b * 256 + d];
+				counts[b * 256 + d] = offset;
+				offset += c;
+			}
+		}
+
+		Parallel::forEach(numBlocks, [&](int b, int thread) {
+			uint32_t *o = &counts[b * 256];
+			const uint32_t *k = srcKeys->data();
+			const uint32_t *v = srcValues->data();
+			uint32_t *dk = dstKeys->data();
+			uint32_t *dv = dstValues->data();
+			int end = min(n, (b + 1) * blockSize);
+			for (int i = b * blockSize; i < end; i++)
+			{
+				uint32_t at = o[(k[i] >> shift) & 0xFF]++;
+				dk[at] = k[i];
+				dv[at] = v[i];
+			}
+		}, numThreads);
+
+		swap(srcKeys, dstKeys);
+		swap(srcValues, dstValues);
+	}
+
+	// an odd number of passes leaves the result in the scratch buffers
+	//
+	if (srcKeys != &keys)
+	{
+		keys.swap(keyScratch);
+		values.swap(valueScratch);
+	}
+}
@@ -0,0 +1,19 @@
+#pragma once
+#include "ofMain.h"
+
+//  Stable LSD radix sort of 32 bit keys carrying a 32 bit value each, one
+//  8 bit digit per pass.  Each pass splits the keys into blocks, counts
+//  digits per block, works out where every block writes each digit and
+//  scatters the blocks in parallel.  Passes where every key has the same
+//  digit are skipped, so keys that only use the low bits cost less.
+//  The scratch buffers are kept between calls.
+//
+class RadixSort
+{
+public:
+	void sort(vector<uint32_t> & keys, vector<uint32_t> & values, int numThreads = 1);
+
+private:
+	vector<uint32_t> keyScratch, valueScratch;
+	vector<uint32_t> counts;     // 256 per block
+};
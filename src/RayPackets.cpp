@@ -0,0 +1,315 @@
+#include "RayPackets.h"
+#include "Parallel.h"
+#include "PerfCounters.h"
+#include "Profiler.h"
+#ifdef RAY_PACKETS_SSE
+#include <xmmintrin.h>
+#endif
+
+//  min and max the way _mm_min_ps and _mm_max_ps pick (the second operand
+//  when either is NaN), so the scalar paths give the same t as the SSE one
+//
+static inline float minps(float a, float b) { return a < b ? a : b; }
+static inline float maxps(float a, float b) { return a > b ? a : b; }
+
+//  1 / d, with a zero component nudged off zero: an axis-parallel ray that
+//  starts on a box face would otherwise get 0 * inf = NaN for that slab
+//
+static inline float inverse(float d) { return 1 / (d != 0 ? d : 1e-30f); }
+
+struct RayPacket
+{
+	alignas(16) float ox[RayPackets::PacketSize];
+	alignas(16) float oy[RayPackets::PacketSize];
+	alignas(16) float oz[RayPackets::PacketSize];
+	alignas(16) float ix[RayPackets::PacketSize];    // 1 / dir
+	alignas(16) float iy[RayPackets::PacketSize];
+	alignas(16) float iz[RayPackets::PacketSize];
+	alignas(16) float best[RayPackets::PacketSize];  // t of the nearest leaf so far
+	const TreeNode *leaf[RayPackets::PacketSize];
+};
+
+//  slab test of one box against the active rays of a packet, entry t of
+//  each ray into tnear (clamped to 0), returns the rays that enter it
+//  before their best hit
+//
+static int testBox(const Box & box, const RayPacket & p, int active, float *tnear)
+{
+	int mask = 0;
+#ifdef RAY_PACKETS_SSE
+	const __m128 minX = _mm_set1_ps(box.parameters[0].x), maxX = _mm_set1_ps(box.parameters[1].x);
+	const __m128 minY = _mm_set1_ps(box.parameters[0].y), maxY = _mm_set1_ps(box.parameters[1].y);
+	const __m128 minZ = _mm_set1_ps(box.parameters[0].z), maxZ = _mm_set1_ps(box.parameters[1].z);
+	const __m128 zero = _mm_setzero_ps();
+	for (int g = 0; g < RayPackets::PacketSize; g += 4)
+	{
+		int lanes = (active >> g) & 0xF;
+		if (lanes == 0) continue;
+
+		__m128 o = _mm_load_ps(p.ox + g), inv = _mm_load_ps(p.ix + g);
+		__m128 t1 = _mm_mul_ps(_mm_sub_ps(minX, o), inv), t2 = _mm_mul_ps(_mm_sub_ps(maxX, o), inv);
+		__m128 tMin = _mm_min_ps(t1, t2), tMax = _mm_max_ps(t1, t2);
+
+		o = _mm_load_ps(p.oy + g);
+		inv = _mm_load_ps(p.iy + g);
+		t1 = _mm_mul_ps(_mm_sub_ps(minY, o), inv);
+		t2 = _mm_mul_ps(_mm_sub_ps(maxY, o), inv);
+		tMin = _mm_max_ps(tMin, _mm_min_ps(t1, t2));
+		tMax = _mm_min_ps(tMax, _mm_max_ps(t1, t2));
+
+		o = _mm_load_ps(p.oz + g);
+		inv = _mm_load_ps(p.iz + g);
+		t1 = _mm_mul_ps(_mm_sub_ps(minZ, o), inv);
+		t2 = _mm_mul_ps(_mm_sub_ps(maxZ, o), inv);
+		tMin = _mm_max_ps(tMin, _mm_min_ps(t1, t2));
+		tMax = _mm_min_ps(tMax, _mm_max_ps(t1, t2));
+
+		tMin = _mm_max_ps(tMin, zero);
+		__m128 hit = _mm_and_ps(_mm_cmple_ps(tMin, tMax), _mm_cmplt_ps(tMin, _mm_load_ps(p.best + g)));
+		_mm_store_ps(tnear + g, tMin);
+		mask |= (_mm_movemask_ps(hit) & lanes) << g;
+	}
+#else
+	for (int r = 0; r < RayPackets::PacketSize; r++)
+	{
+		if (((active >> r) & 1) == 0) continue;
+		float t1 = (box.parameters[0].x - p.ox[r]) * p.ix[r], t2 = (box.parameters[1].x - p.ox[r]) * p.ix[r];
+		float tMin = minps(t1, t2), tMax = maxps(t1, t2);
+		t1 = (box.parameters[0].y - p.oy[r]) * p.iy[r];
+		t2 = (box.parameters[1].y - p.oy[r]) * p.iy[r];
+		tMin = maxps(tMin, minps(t1, t2));
+		tMax = minps(tMax, maxps(t1, t2));
+		t1 = (box.parameters[0].z - p.oz[r]) * p.iz[r];
+		t2 = (box.parameters[1].z - p.oz[r]) * p.iz[r];
+		tMin = maxps(tMin, minps(t1, t2));
+		tMax = minps(tMax, maxps(t1, t2));
+		tMin = maxps(tMin, 0);
+		tnear[r] = tMin;
+		if (tMin <= tMax && tMin < p.best[r]) mask |= 1 << r;
+	}
+#endif
+	return mask;
+}
+
+//  scalar slab test with the packet's arithmetic
+//
+static bool enters(const Box & box, const glm::vec3 & o, const glm::vec3 & inv, float best, float & tNear)
+{
+	float t1 = (box.parameters[0].x - o.x) * inv.x, t2 = (box.parameters[1].x - o.x) * inv.x;
+	float tMin = minps(t1, t2), tMax = maxps(t1, t2);
+	t1 = (box.parameters[0].y - o.y) * inv.y;
+	t2 = (box.parameters[1].y - o.y) * inv.y;
+	tMin = maxps(tMin, minps(t1, t2));
+	tMax = minps(tMax, maxps(t1, t2));
+	t1 = (box.parameters[0].z - o.z) * inv.z;
+	t2 = (box.parameters[1].z - o.z) * inv.z;
+	tMin = maxps(tMin, minps(t1, t2));
+	tMax = minps(tMax, maxps(t1, t2));
+	tNear = maxps(tMin, 0);
+	return tNear <= tMax && tNear < best;
+}
+
+static void traverseSingle(const TreeNode & node, const glm::vec3 & o, const glm::vec3 & inv, float nodeNear,
+	float & best, const TreeNode *& leaf)
+{
+	PerfCounters::add(CounterOctreeNodesVisited);
+	if (node.children.empty())
+	{
+		if (nodeNear < best)
+		{
+			best = nodeNear;
+			leaf = &node;
+		}
+		return;
+	}
+
+	float t[8];
+	int order[8];
+	int n = 0;
+	for (int i = 0; i < node.children.size() && i < 8; i++)
+	{
+		if (!enters(node.children[i].box, o, inv, best, t[i])) continue;
+		int k = n++;
+		for (; k > 0 && t[order[k - 1]] > t[i]; k--)
+			order[k] = order[k - 1];
+		order[k] = i;
+	}
+	for (int k = 0; k < n; k++)
+		if (t[order[k]] < best) traverseSingle(node.children[order[k]], o, inv, t[order[k]], best, leaf);
+}
+
+//  the rays in active entered node at nodeNear; leaves keep the nearest,
+//  children are tested together and visited nearest entry first
+//
+static void traverse(const TreeNode & node, RayPacket & p, int active, const float *nodeNear)
+{
+	// a packet down to one ray goes on without the other lanes
+	//
+	if ((active & (active - 1)) == 0)
+	{
+		int r = 0;
+		while (((active >> r) & 1) == 0) r++;
+		glm::vec3 o(p.ox[r], p.oy[r], p.oz[r]), inv(p.ix[r], p.iy[r], p.iz[r]);
+		traverseSingle(node, o, inv, nodeNear[r], p.best[r], p.leaf[r]);
+		return;
+	}
+
+	PerfCounters::add(CounterOctreeNodesVisited);
+	if (node.children.empty())
+	{
+		for (int r = 0; r < RayPackets::PacketSize; r++)
+		{
+			if (((active >> r) & 1) && nodeNear[r] < p.best[r])
+			{
+				p.best[r] = nodeNear[r];
+				p.leaf[r] = &node;
+			}
+		}
+		return;
+	}
+
+	alignas(16) float t[8][RayPackets::PacketSize];
+	int masks[8], order[8];
+	float nearest[8];
+	int n = 0;
+	for (int i = 0; i < node.children.size() && i < 8; i++)
+	{
+		int mask = testBox(node.children[i].box, p, active, t[i]);
+		masks[i] = mask;
+		if (mask == 0) continue;
+		nearest[i] = FLT_MAX;
+		for (int r = 0; r < RayPackets::PacketSize; r++)
+			if ((mask >> r) & 1) nearest[i] = min(nearest[i], t[i][r]);
+
+		int k = n++;
+		for (; k > 0 && nearest[order[k - 1]] > nearest[i]; k--)
+			order[k] = order[k - 1];
+		order[k] = i;
+	}
+
+	for (int k = 0; k < n; k++)
+	{
+		int i = order[k];
+		int mask = masks[i];
+		for (int r = 0; r < RayPackets::PacketSize; r++)
+			if (((mask >> r) & 1) && !(t[i][r] < p.best[r])) mask &= ~(1 << r);
+		if (mask) traverse(node.children[i], p, mask, t[i]);
+	}
+}
+
+//  vertex of the leaf nearest the hit
+//
+static void finish(const Octree & tree, const glm::vec3 & origin, const glm::vec3 & dir, const TreeNode *leaf, float t, RayHit & hit)
+{
+	hit = RayHit();
+	if (!leaf) return;
+	hit.t = t;
+	hit.leaf = leaf;
+	hit.position = origin + dir * t;
+	float best = FLT_MAX;
+	for (int i = 0; i < leaf->points.size(); i++)
+	{
+		glm::vec3 d = tree.vertex(leaf->points[i]) - hit.position;
+		float d2 = glm::dot(d, d);
+		if (d2 < best)
+		{
+			best = d2;
+			hit.vertex = leaf->points[i];
+		}
+	}
+}
+
+//  up to PacketSize rays, origins[i * originStride]
+//
+static void tracePacket(const Octree & tree, const glm::vec3 *origins, int originStride, const glm::vec3 *dirs,
+	int count, RayHit *hits, float maxT)
+{
+	RayPacket p;
+	int active = 0;
+	for (int r = 0; r < RayPackets::PacketSize; r++)
+	{
+		// unused lanes repeat the first ray and stay inactive
+		int i = r < count ? r : 0;
+		const glm::vec3 & o = origins[i * originStride];
+		p.ox[r] = o.x;
+		p.oy[r] = o.y;
+		p.oz[r] = o.z;
+		p.ix[r] = inverse(dirs[i].x);
+		p.iy[r] = inverse(dirs[i].y);
+		p.iz[r] = inverse(dirs[i].z);
+		p.best[r] = maxT;
+		p.leaf[r] = NULL;
+		if (r < count) active |= 1 << r;
+	}
+	PerfCounters::add(CounterOctreeQueries, count);
+
+	alignas(16) float tnear[RayPackets::PacketSize];
+	active = testBox(tree.root.box, p, active, tnear);
+	if (active) traverse(tree.root, p, active, tnear);
+
+	for (int r = 0; r < count; r++)
+		finish(tree, origins[r * originStride], dirs[r], p.leaf[r], p.best[r], hits[r]);
+}
+
+static void tracePackets(const Octree & tree, const glm::vec3 *origins, int originStride, const glm::vec3 *dirs,
+	int n, RayHit *hits, float maxT, int numThreads)
+{
+	PROFILE_SCOPE("RayPackets::trace");
+	int numPackets = (n + RayPackets::PacketSize - 1) / RayPackets::PacketSize;
+	Parallel::forEach(numPackets, [&](int i, int thread) {
+		int first = i * RayPackets::PacketSize;
+		tracePacket(tree, origins + first * originStride, originStride, dirs + first,
+			min((int)RayPackets::PacketSize, n - first), hits + first, maxT);
+	}, numThreads, 4);
+}
+
+RayHit RayPackets::trace(const Octree & tree, const glm::vec3 & origin, const glm::vec3 & dir, float maxT)
+{
+	RayHit hit;
+	tracePacket(tree, &origin, 0, &dir, 1, &hit, maxT);
+	return hit;
+}
+
+void RayPackets::trace(const Octree & tree, const glm::vec3 *origins, const glm::vec3 *dirs, int n, RayHit *hits,
+	float maxT, int numThreads)
+{
+	tracePackets(tree, origins, 1, dirs, n, hits, maxT, numThreads);
+}
+
+void RayPackets::trace(const Octree & tree, const glm::vec3 & origin, const glm::vec3 *dirs, int n, RayHit *hits,
+	float maxT, int numThreads)
+{
+	tracePackets(tree, &origin, 0, dirs, n, hits, maxT, numThreads);
+}
+
+RayHit RayPackets::traceSingle(const Octree & tree, const glm::vec3 & origin, const glm::vec3 & dir, float maxT)
+{
+	glm::vec3 inv(inverse(dir.x), inverse(dir.y), inverse(dir.z));
+	float best = maxT, tNear;
+	const TreeNode *leaf = NULL;
+	if (enters(tree.root.box, origin, inv, best, tNear))
+		traverseSingle(tree.root, origin, inv, tNear, best, leaf);
+	RayHit hit;
+	finish(tree, origin, dir, leaf, best, hit);
+	return hit;
+}
+
+void RayPackets::cone(const glm::vec3 & axis, float halfAngle, int rows, int cols, vector<glm::vec3> & dirs)
+{
+	glm::vec3 w = glm::normalize(axis);
+	glm::vec3 side = fabs(w.y) < .9f ? glm::vec3(0, 1, 0) : glm::vec3(1, 0, 0);
+	glm::vec3 u = glm::normalize(glm::cross(side, w));
+	glm::vec3 v = glm::cross(w, u);
+	float spread = tan(ofDegToRad(halfAngle));
+
+	dirs.clear();
+	for (int tileRow = 0; tileRow < rows; tileRow += 4)
+		for (int tileCol = 0; tileCol < cols; tileCol += 4)
+			for (int row = tileRow; row < min(tileRow + 4, rows); row++)
+				for (int col = tileCol; col < min(tileCol + 4, cols); col++)
+				{
+					float a = ((col + .5f) / cols * 2 - 1) * spread;
+					float b = ((row + .5f) / rows * 2 - 1) * spread;
+					dirs.push_back(glm::normalize(w + u * a + v * b));
+				}
+}
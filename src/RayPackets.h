@@ -0,0 +1,57 @@
+#pragma once
+#include "ofMain.h"
+#include "Octree.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RAY_PACKETS_SSE 1
+#endif
+
+//  First leaf box of the terrain octree a ray enters.
+//
+struct RayHit
+{
+	float t = -1;                   // distance along dir (dir's length is the unit), -1 for a miss
+	glm::vec3 position;             // origin + dir * t
+	int vertex = -1;                // vertex of the leaf nearest position
+	const TreeNode *leaf = NULL;
+
+	bool hit() const { return leaf != NULL; }
+};
+
+//  Rays traced through an Octree in packets of 16.  A packet walks the
+//  tree once: every node's box is tested against all its rays with SSE,
+//  four rays per slab test, and only the rays that enter the box before
+//  their best hit so far go on into it.  Children are visited nearest
+//  first, so the rays of a coherent packet (a tile of a radar sweep, a
+//  bundle from one eye) stop at their first leaf and skip the rest.  A
+//  ray starting inside a leaf box hits it at t = 0.
+//
+//  trace() with arrays takes the rays in order, 16 at a time, so rays
+//  meant to travel together should be next to each other; cone() lays
+//  out a sweep that way.  The packets can be split over threads.
+//
+//      vector<glm::vec3> dirs;
+//      RayPackets::cone(glm::vec3(0, -1, 0), 30, 32, 32, dirs);
+//      RayPackets::trace(tree, position, &dirs[0], dirs.size(), &hits[0]);
+//
+class RayPackets
+{
+public:
+	enum { PacketSize = 16 };
+
+	static RayHit trace(const Octree & tree, const glm::vec3 & origin, const glm::vec3 & dir, float maxT = 1e30f);
+	static void trace(const Octree & tree, const glm::vec3 *origins, const glm::vec3 *dirs, int n, RayHit *hits,
+		float maxT = 1e30f, int numThreads = 1);
+	static void trace(const Octree & tree, const glm::vec3 & origin, const glm::vec3 *dirs, int n, RayHit *hits,
+		float maxT = 1e30f, int numThreads = 1);
+
+	// the same first hit, one ray at a time without packets or SSE, to
+	// check the packets against
+	//
+	static RayHit traceSingle(const Octree & tree, const glm::vec3 & origin, const glm::vec3 & dir, float maxT = 1e30f);
+
+	// rows x cols unit directions within halfAngle degrees of axis, in 4x4
+	// tiles so that each packet of 16 is one tile
+	//
+	static void cone(const glm::vec3 & axis, float halfAngle, int rows, int cols, vector<glm::vec3> & dirs);
+};
@@ -0,0 +1,132 @@
+#include "Octree.h"
+#include "ParticleSystem.h"
+#include "ParticleWorld.h"
+#include "ParticleEmitter.h"
+
+//  The parts of the simulation classes that need the app's window: drawing,
+//  and the update()s that step by its frame rate.  They are built into the
+//  app only, the landersim library (CMakeLists.txt) leaves this file out so
+//  it links without a window, GL or audio.  Headless code steps with an
+//  explicit dt.
+//
+
+// draw Octree (recursively)
+//
+void Octree::draw(TreeNode & node, int numLevels, int level) {
+	if (level >= numLevels) return;
+	drawBox(node.box);
+	level++;
+	for (int i = 0; i < node.children.size(); i++) {
+		draw(node.children[i], numLevels, level);
+	}
+}
+
+// draw only leaf Nodes
+//
+void Octree::drawLeafNodes(TreeNode & node) 
+{
+	if (node.children.size() == 0)
+		drawBox(node.box);
+	else
+		for (int i = 0; i < node.children.size(); i++)
+			drawLeafNodes(node.children[i]);
+}
+
+
+//draw a box from a "Box" class  
+//
+void Octree::drawBox(const Box &box) {
+	glm::vec3 min = box.parameters[0];
+	glm::vec3 max = box.parameters[1];
+	glm::vec3 size = max - min;
+	glm::vec3 center = size / 2 + min;
+	ofVec3f p = ofVec3f(center.x, center.y, center.z);
+	float w = size.x;
+	float h = size.y;
+	float d = size.z;
+	ofDrawBox(p, w, h, d);
+}
+
+void Particle::draw() {
+	ofSetColor(color);
+//	ofSetColor(ofMap(age(), 0, lifespan, 255, 10), 0, 0);
+	ofDrawSphere(position, radius);
+}
+
+// write your own integrator here.. (hint: it's only 3 lines of code)
+//
+void Particle::integrate() {
+
+	// check for 0 framerate to avoid divide errors
+	//
+	float framerate = ofGetFrameRate();
+	if (framerate < 1.0) return;
+
+	// interval for this step
+	//
+	integrate(1.0 / framerate);
+}
+
+void ParticleSystem::update() {
+
+	// check for 0 framerate to avoid divide errors
+	//
+	float framerate = ofGetFrameRate();
+	if (framerate < 1.0) return;
+
+	update(1.0 / framerate);
+}
+
+void ParticleSystem::test(Particle* p)
+{
+	float framerate = ofGetFrameRate();
+	if (framerate < 1.0) return;
+
+	test(p, 1.0 / framerate);
+}
+
+//  draw the particle cloud
+//
+void ParticleSystem::draw() {
+	Particle *p = data();
+	for (int i = 0; i < size(); i++) {
+		p[i].draw();
+	}
+}
+
+void ParticleWorld::update()
+{
+	// check for 0 framerate to avoid divide errors
+	//
+	float framerate = ofGetFrameRate();
+	if (framerate < 1.0) return;
+
+	update(1.0 / framerate);
+}
+
+void ParticleEmitter::draw() {
+	if (visible) {
+		switch (type) {
+		case DirectionalEmitter:
+			ofDrawSphere(position, radius/10);  // just draw a small sphere for point emitters 
+			break;
+		case SphereEmitter:
+		case RadialEmitter:
+			ofDrawSphere(position, radius/10);  // just draw a small sphere as a placeholder
+			break;
+		default:
+			break;
+		}
+	}
+	sys->draw();  
+}
+
+void ParticleEmitter::update() {
+
+	// check for 0 framerate to avoid divide errors
+	//
+	float framerate = ofGetFrameRate();
+	if (framerate < 1.0) return;
+
+	update(1.0 / framerate);
+}
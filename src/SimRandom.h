@@ -0,0 +1,43 @@
+#pragma once
+#include "ofMain.h"
+
+//  Random numbers for the simulation (turbulence, emitter spread), drawn
+//  from a generator the simulation owns instead of ofRandom's, which the
+//  rest of the app shares and whose state can't be read back.  The whole
+//  state is one 64 bit word, so a snapshot saves and restores it and a
+//  rewound run draws the same numbers again.
+//
+//  SplitMix64: the state steps by a constant and each output is a mix of
+//  it, so every state is valid.
+//
+class SimRandom
+{
+public:
+	explicit SimRandom(uint64_t seed = 0x853C49E6748FEA9Bull) : state(seed) {}
+
+	uint64_t next()
+	{
+		uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		return z ^ (z >> 31);
+	}
+
+	// uniform in [lo, hi), as ofRandom(lo, hi)
+	//
+	float range(float lo, float hi)
+	{
+		float unit = (float)(next() >> 40) * (1.0f / 16777216);
+		return lo + (hi - lo) * unit;
+	}
+
+	// for forces and emitters that aren't given a simulation's generator
+	//
+	static SimRandom & shared()
+	{
+		static SimRandom random;
+		return random;
+	}
+
+	uint64_t state;
+};
@@ -0,0 +1,526 @@
+#include "SimSnapshot.h"
+#include "Profiler.h"
+#include <type_traits>
+
+static_assert(is_trivially_copyable<Particle>::value, "snapshots copy particles as bytes");
+
+static const char snapshotMagic[4] = { 'L', 'L', 'S', 'S' };
+static const uint32_t snapshotVersion = 3;
+
+template <class T> static void put(vector<uint8_t> & out, const T & v)
+{
+	const uint8_t *p = (const uint8_t *)&v;
+	out.insert(out.end(), p, p + sizeof(T));
+}
+
+//  the count, then the elements aligned for T from the start of the
+//  snapshot, so they can be read where they are
+//
+template <class T> static void putArray(vector<uint8_t> & out, const T *v, size_t n)
+{
+	put(out, (uint32_t)n);
+	while (out.size() % alignof(T)) out.push_back(0);
+	const uint8_t *p = (const uint8_t *)v;
+	out.insert(out.end(), p, p + n * sizeof(T));
+}
+
+//  Particles with their birth time (an ofGetElapsedTimeMillis value) as
+//  their age at the save, ms, so a restore gives them back that age
+//
+static void putParticles(vector<uint8_t> & out, const Particle *p, size_t n, double now)
+{
+	putArray(out, p, n);
+	uint8_t *q = out.data() + out.size() - n * sizeof(Particle) + offsetof(Particle, birthtime);
+	for (size_t i = 0; i < n; i++)
+	{
+		float age = (float)(now - p[i].birthtime);
+		memcpy(q + i * sizeof(Particle), &age, sizeof(age));
+	}
+}
+
+//  birth times from the ages putParticles wrote
+//
+static void rebase(Particle *p, size_t n, double now)
+{
+	for (size_t i = 0; i < n; i++)
+		p[i].birthtime = (float)(now - p[i].birthtime);
+}
+
+//  reads what the put functions wrote, ok turns false at the first read
+//  past the end and stays false
+//
+struct SnapshotReader
+{
+	const uint8_t *begin;
+	const uint8_t *p;
+	const uint8_t *end;
+	bool ok = true;
+
+	template <class T> void get(T & v)
+	{
+		if (!ok || end - p < (ptrdiff_t)sizeof(T)) { ok = false; return; }
+		memcpy(&v, p, sizeof(T));
+		p += sizeof(T);
+	}
+
+	// n elements follow, returns where, or NULL
+	//
+	template <class T> const T * array(uint32_t & n)
+	{
+		n = 0;
+		get(n);
+		while (ok && (p - begin) % alignof(T))
+		{
+			if (p == end) ok = false;
+			else p++;
+		}
+		if (!ok || (size_t)(end - p) / sizeof(T) < n) { ok = false; return NULL; }
+		const T *v = (const T *)p;
+		p += n * sizeof(T);
+		return v;
+	}
+
+	template <class T> void getVector(vector<T> & v, bool apply)
+	{
+		uint32_t n;
+		const T *data = array<T>(n);
+		if (ok && apply) v.assign(data, data + n);
+	}
+};
+
+//  what a system carries from one update to the next besides its
+//  particles: impulses and which forces have been applied
+//
+static void putSystem(vector<uint8_t> & out, const ParticleSystem & sys)
+{
+	putArray(out, sys.impulses.data(), sys.impulses.size());
+	put(out, (uint32_t)sys.forces.size());
+	for (int i = 0; i < sys.forces.size(); i++)
+		put(out, (uint8_t)sys.forces[i]->applied);
+}
+
+static bool getSystem(SnapshotReader & in, ParticleSystem & sys, bool apply)
+{
+	in.getVector(sys.impulses, apply);
+	uint32_t n;
+	const uint8_t *applied = in.array<uint8_t>(n);
+	if (!in.ok) return false;
+	if (n != sys.forces.size())
+	{
+		cout << "snapshot has " << n << " forces on a system that has " << sys.forces.size() << endl;
+		return false;
+	}
+	if (apply)
+	{
+		for (uint32_t i = 0; i < n; i++)
+			sys.forces[i]->applied = applied[i] != 0;
+	}
+	return true;
+}
+
+void SimSnapshot::save(vector<uint8_t> & out) const
+{
+	PROFILE_SCOPE("SimSnapshot::save");
+
+	out.clear();
+	for (int i = 0; i < 4; i++)
+		out.push_back((uint8_t)snapshotMagic[i]);
+	put(out, snapshotVersion);
+
+	double now = (double)clock();
+
+	put(out, (uint8_t)(sim != NULL));
+	if (sim)
+	{
+		put(out, sim->gravity);
+		put(out, sim->magnitude);
+		put(out, sim->restitution);
+		put(out, sim->crashSpeed);
+		put(out, (uint8_t)sim->continuous);
+		put(out, sim->startingPosition);
+		put(out, (int32_t)sim->status);
+		put(out, (int32_t)sim->bounces);
+		put(out, (uint8_t)sim->bEnded);
+		put(out, (int32_t)sim->score);
+		put(out, sim->dist);
+		put(out, sim->random.state);
+		putArray(out, sim->message.data(), sim->message.size());
+		putArray(out, sim->padFeet.data(), sim->padFeet.size());
+		putParticles(out, sim->landerSystem.particles.data(), sim->landerSystem.particles.size(), now);
+		putSystem(out, sim->landerSystem);
+	}
+
+	put(out, (uint32_t)(world ? world->systems.size() : 0));
+	if (world)
+	{
+		for (int s = 0; s < world->systems.size(); s++)
+		{
+			ParticleSystem & sys = *world->systems[s];
+			putParticles(out, sys.data(), sys.size(), now);
+			putParticles(out, world->ranges[s].spawned.data(), world->ranges[s].spawned.size(), now);
+			putSystem(out, sys);
+		}
+	}
+
+	put(out, (uint32_t)emitters.size());
+	for (int e = 0; e < emitters.size(); e++)
+	{
+		const ParticleEmitter & emitter = *emitters[e];
+		put(out, (uint8_t)emitter.started);
+		put(out, (uint8_t)emitter.fired);
+		put(out, (float)(now - emitter.lastSpawned));
+		if (!emitter.sys->world)
+		{
+			putParticles(out, emitter.sys->particles.data(), emitter.sys->particles.size(), now);
+			putSystem(out, *emitter.sys);
+		}
+	}
+}
+
+//  Read the snapshot twice, first only checking that it fits the objects
+//  it is restored into, then for real, so a bad one changes nothing.
+//
+bool SimSnapshot::restore(const vector<uint8_t> & data)
+{
+	PROFILE_SCOPE("SimSnapshot::restore");
+
+	double now = (double)clock();
+	for (int pass = 0; pass < 2; pass++)
+	{
+		bool apply = pass == 1;
+		SnapshotReader in = { data.data(), data.data(), data.data() + data.size() };
+
+		char magic[4] = { 0, 0, 0, 0 };
+		uint32_t version = 0;
+		for (int i = 0; i < 4; i++) in.get(magic[i]);
+		in.get(version);
+		if (!in.ok || memcmp(magic, snapshotMagic, 4) != 0 || version != snapshotVersion)
+		{
+			cout << "not a snapshot, or from another version" << endl;
+			return false;
+		}
+
+		uint8_t hasSim = 0;
+		in.get(hasSim);
+		if (hasSim != (sim != NULL))
+		{
+			cout << "snapshot " << (hasSim ? "has" : "has no") << " lander" << endl;
+			return false;
+		}
+		if (sim)
+		{
+			float gravity = 0, magnitude = 0, restitution = 0, crashSpeed = 0, dist = 0;
+			uint8_t continuous = 0, ended = 0;
+			int32_t status = 0, bounces = 0, score = 0;
+			uint64_t random = 0;
+			glm::vec3 startingPosition;
+			in.get(gravity);
+			in.get(magnitude);
+			in.get(restitution);
+			in.get(crashSpeed);
+			in.get(continuous);
+			in.get(startingPosition);
+			in.get(status);
+			in.get(bounces);
+			in.get(ended);
+			in.get(score);
+			in.get(dist);
+			in.get(random);
+			uint32_t messageLength, numPads, numLanders;
+			const char *message = in.array<char>(messageLength);
+			const int *padFeet = in.array<int>(numPads);
+			const Particle *lander = in.array<Particle>(numLanders);
+			if (in.ok && numLanders != 1)
+			{
+				cout << "snapshot has " << numLanders << " lander particles" << endl;
+				return false;
+			}
+			if (!getSystem(in, sim->landerSystem, apply)) return false;
+			if (apply)
+			{
+				sim->gravity = gravity;
+				sim->magnitude = magnitude;
+				sim->restitution = restitution;
+				sim->crashSpeed = crashSpeed;
+				sim->continuous = continuous != 0;
+				sim->startingPosition = startingPosition;
+				sim->status = (LanderStatus)status;
+				sim->bounces = bounces;
+				sim->bEnded = ended != 0;
+				sim->score = score;
+				sim->dist = dist;
+				sim->random.state = random;
+				sim->message.assign(message, messageLength);
+				sim->padFeet.assign(padFeet, padFeet + numPads);
+				sim->lander() = lander[0];
+				rebase(&sim->lander(), 1, now);
+				sim->footCursors[0] = OctreeCursor();
+				sim->footCursors[1] = OctreeCursor();
+			}
+		}
+
+		uint32_t numSystems = 0;
+		in.get(numSystems);
+		if (in.ok && numSystems != (world ? world->systems.size() : 0))
+		{
+			cout << "snapshot has " << numSystems << " particle systems, the world has " << (world ? world->systems.size() : 0) << endl;
+			return false;
+		}
+		for (uint32_t s = 0; s < numSystems && in.ok; s++)
+		{
+			uint32_t n;
+			const Particle *particles = in.array<Particle>(n);
+			if (in.ok && apply)
+			{
+				world->setParticles(s, particles, n);
+				rebase(world->systems[s]->data(), n, now);
+			}
+			in.getVector(world->ranges[s].spawned, apply);
+			if (in.ok && apply) rebase(world->ranges[s].spawned.data(), world->ranges[s].spawned.size(), now);
+			if (!getSystem(in, *world->systems[s], apply)) return false;
+		}
+		if (in.ok && apply && world) world->gather();
+
+		uint32_t numEmitters = 0;
+		in.get(numEmitters);
+		if (in.ok && numEmitters != emitters.size())
+		{
+			cout << "snapshot has " << numEmitters << " emitters, restoring into " << emitters.size() << endl;
+			return false;
+		}
+		for (uint32_t e = 0; e < numEmitters && in.ok; e++)
+		{
+			ParticleEmitter & emitter = *emitters[e];
+			uint8_t started = 0, fired = 0;
+			float sinceSpawned = 0;
+			in.get(started);
+			in.get(fired);
+			in.get(sinceSpawned);
+			if (in.ok && apply)
+			{
+				emitter.started = started != 0;
+				emitter.fired = fired != 0;
+				emitter.lastSpawned = (float)(now - sinceSpawned);
+			}
+			if (!emitter.sys->world)
+			{
+				in.getVector(emitter.sys->particles, apply);
+				if (in.ok && apply) rebase(emitter.sys->particles.data(), emitter.sys->particles.size(), now);
+				if (!getSystem(in, *emitter.sys, apply)) return false;
+			}
+		}
+
+		if (!in.ok || in.p != in.end)
+		{
+			cout << "snapshot is truncated or doesn't match what it is restored into" << endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+//  unsigned LEB128
+//
+static void putVarint(vector<uint8_t> & out, size_t v)
+{
+	while (v >= 0x80)
+	{
+		out.push_back((uint8_t)(v | 0x80));
+		v >>= 7;
+	}
+	out.push_back((uint8_t)v);
+}
+
+static bool getVarint(const uint8_t *& p, const uint8_t *end, size_t & v)
+{
+	v = 0;
+	for (int shift = 0; p < end && shift < 64; shift += 7)
+	{
+		uint8_t b = *p++;
+		v |= (size_t)(b & 0x7F) << shift;
+		if (!(b & 0x80)) return true;
+	}
+	return false;
+}
+
+void RewindBuffer::setCapacity(int ticks, int keyframeInterval)
+{
+	ring.assign(max(ticks, 1), Entry());
+	this->keyframeInterval = max(keyframeInterval, 1);
+	head = 0;
+	count = 0;
+	sinceKeyframe = 0;
+}
+
+void RewindBuffer::clear()
+{
+	head = 0;
+	count = 0;
+	sinceKeyframe = 0;
+}
+
+//  The snapshot XOR the keyframe (bytes past the keyframe's end XOR 0), as
+//  the snapshot's size, then pairs of a run of zero bytes to skip and a
+//  run of bytes to XOR back in, both lengths as varints.  A literal run
+//  only ends at 3 or more zeros, shorter gaps cost less written out.
+//  Unchanged stretches are skipped 8 bytes at a time.
+//
+void RewindBuffer::encode(const vector<uint8_t> & key, const vector<uint8_t> & snapshot, vector<uint8_t> & delta)
+{
+	delta.clear();
+	size_t n = snapshot.size();
+	size_t m = min(n, key.size());
+	const uint8_t *a = snapshot.data(), *b = key.data();
+	putVarint(delta, n);
+
+	size_t i = 0;
+	while (i < n)
+	{
+		size_t start = i;
+		uint64_t wa, wb;
+		while (i + 8 <= m && (memcpy(&wa, a + i, 8), memcpy(&wb, b + i, 8), wa == wb)) i += 8;
+		while (i < m && a[i] == b[i]) i++;
+		if (i >= m)
+		{
+			while (i < n && a[i] == 0) i++;
+		}
+		size_t zeros = i - start;
+
+		size_t end = i;
+		int run = 0;
+		while (end < n)
+		{
+			// 8 bytes that all changed can't hold the end of the run
+			//
+			if (end + 8 <= m)
+			{
+				memcpy(&wa, a + end, 8);
+				memcpy(&wb, b + end, 8);
+				uint64_t x = wa ^ wb;
+				if (((x - 0x0101010101010101ull) & ~x & 0x8080808080808080ull) == 0)
+				{
+					end += 8;
+					run = 0;
+					continue;
+				}
+			}
+			bool same = end < m ? a[end] == b[end] : a[end] == 0;
+			run = same ? run + 1 : 0;
+			end++;
+			if (run == 3) break;
+		}
+		end -= run;
+
+		putVarint(delta, zeros);
+		putVarint(delta, end - i);
+		size_t at = delta.size();
+		delta.resize(at + end - i);
+		uint8_t *out = delta.data() + at;
+		size_t k = i;
+		for (; k < min(end, m); k++) *out++ = a[k] ^ b[k];
+		for (; k < end; k++) *out++ = a[k];
+		i = end;
+	}
+}
+
+bool RewindBuffer::decode(const vector<uint8_t> & key, const vector<uint8_t> & delta, vector<uint8_t> & snapshot)
+{
+	const uint8_t *p = delta.data(), *end = p + delta.size();
+	size_t n;
+	if (!getVarint(p, end, n)) return false;
+	snapshot.resize(n);
+	size_t m = min(n, key.size());
+	uint8_t *out = snapshot.data();
+	const uint8_t *b = key.data();
+
+	size_t i = 0;
+	while (i < n)
+	{
+		size_t zeros, literal;
+		if (!getVarint(p, end, zeros) || !getVarint(p, end, literal)) return false;
+		if (zeros > n - i || literal > n - i - zeros || (size_t)(end - p) < literal) return false;
+		size_t stop = i + zeros;
+		if (i < m) memcpy(out + i, b + i, min(stop, m) - i);
+		if (stop > m) memset(out + max(i, m), 0, stop - max(i, m));
+		i = stop;
+		stop = i + literal;
+		for (; i < min(stop, m); i++) out[i] = *p++ ^ b[i];
+		for (; i < stop; i++) out[i] = *p++;
+	}
+	return p == end;
+}
+
+void RewindBuffer::push(const vector<uint8_t> & snapshot)
+{
+	PROFILE_SCOPE("RewindBuffer::push");
+	if (ring.empty()) setCapacity(600);
+
+	// the keyframe this one would refer to, unless it is about to be
+	// overwritten
+	//
+	int key = count > 0 ? slot(sinceKeyframe) : -1;
+	Entry & e = ring[head];
+	if (key < 0 || key == head || sinceKeyframe + 1 >= keyframeInterval)
+	{
+		e.keyframe = true;
+		e.key = head;
+		e.data = snapshot;
+		sinceKeyframe = 0;
+	}
+	else
+	{
+		e.keyframe = false;
+		e.key = key;
+		encode(ring[key].data, snapshot, e.data);
+		sinceKeyframe++;
+	}
+	head = (head + 1) % ring.size();
+	count = min(count + 1, (int)ring.size());
+}
+
+int RewindBuffer::available() const
+{
+	for (int back = count - 1; back >= 0; back--)
+	{
+		if (ring[slot(back)].keyframe) return back;
+	}
+	return -1;
+}
+
+bool RewindBuffer::get(int ticksBack, vector<uint8_t> & snapshot) const
+{
+	if (ticksBack < 0 || ticksBack > available()) return false;
+	const Entry & e = ring[slot(ticksBack)];
+	if (e.keyframe)
+	{
+		snapshot = e.data;
+		return true;
+	}
+	return decode(ring[e.key].data, e.data, snapshot);
+}
+
+//  forget the n newest ticks, after rewinding over them
+//
+void RewindBuffer::dropNewest(int n)
+{
+	n = min(max(n, 0), count);
+	head = (head - n + (int)ring.size()) % ring.size();
+	count -= n;
+	sinceKeyframe = 0;
+	for (int back = 0; back < count; back++)
+	{
+		if (ring[slot(back)].keyframe)
+		{
+			sinceKeyframe = back;
+			break;
+		}
+	}
+}
+
+size_t RewindBuffer::bytes() const
+{
+	size_t total = 0;
+	for (int back = 0; back < count; back++)
+		total += ring[slot(back)].data.size();
+	return total;
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include "ofMain.h"
+#include "LanderSim.h"
+#include "ParticleWorld.h"
+#include "ParticleEmitter.h"
+
+//  Whole simulation state as bytes, for rewinding: the lander and its
+//  system, the tunables and game flags, every particle of a ParticleWorld
+//  with its systems' pending spawns, impulses and force flags, the
+//  emitters' spawn timing, and the sim's random generator.  Particles and
+//  vectors are copied as they are in memory, so a snapshot is only read
+//  back by the same build, like the mesh cache.
+//
+//  Forces and emitters draw from LanderSim::random when they are pointed
+//  at it, and then a restored run draws the same numbers again.  Ones left
+//  on SimRandom::shared() aren't part of the snapshot.
+//
+//  Particle birth times and the emitters' last spawn are wall clock times,
+//  kept as ages at the save, so restored particles are as old as they were
+//  then and don't expire at once after a rewind.  clock is
+//  ofGetElapsedTimeMillis unless a test steps its own.
+//
+//  Force objects are setup, not state: a snapshot restores only into the
+//  same systems with the same number of forces, and says so if not.
+//
+class SimSnapshot
+{
+public:
+	void save(vector<uint8_t> & out) const;
+	bool restore(const vector<uint8_t> & data);
+
+	LanderSim *sim = NULL;
+	ParticleWorld *world = NULL;
+	vector<ParticleEmitter *> emitters;
+	function<uint64_t()> clock = ofGetElapsedTimeMillis;
+};
+
+//  The last capacity snapshots, one per tick.  Every keyframeInterval-th
+//  one is kept whole, the others as their XOR with that keyframe with the
+//  runs of zero bytes (what didn't change) left out.  Getting any tick back
+//  is one decode against its keyframe.  When the ring drops a keyframe the
+//  ticks after it go with it, so between capacity - keyframeInterval + 1
+//  and capacity ticks can be rewound.
+//
+//  Buffers are reused as the ring wraps, so once it is full a push makes
+//  no heap allocations unless a snapshot grew.
+//
+class RewindBuffer
+{
+public:
+	void setCapacity(int ticks, int keyframeInterval = 60);
+	void push(const vector<uint8_t> & snapshot);
+	bool get(int ticksBack, vector<uint8_t> & snapshot) const;
+	void dropNewest(int n);
+	void clear();
+	int available() const;      // ticks back, 0 = the last push
+	size_t bytes() const;       // stored, without the ring's own overhead
+
+	static void encode(const vector<uint8_t> & key, const vector<uint8_t> & snapshot, vector<uint8_t> & delta);
+	static bool decode(const vector<uint8_t> & key, const vector<uint8_t> & delta, vector<uint8_t> & snapshot);
+
+	int keyframeInterval = 60;
+
+private:
+	struct Entry
+	{
+		bool keyframe = false;
+		int key = -1;           // slot of its keyframe
+		vector<uint8_t> data;
+	};
+
+	int slot(int ticksBack) const { return (head - 1 - ticksBack + 2 * (int)ring.size()) % (int)ring.size(); }
+
+	vector<Entry> ring;
+	int head = 0;               // next slot to write
+	int count = 0;
+	int sinceKeyframe = 0;
+};
@@ -0,0 +1,442 @@
+#pragma once
+#include "ofMain.h"
+#include "Arena.h"
+
+//  Point accessors for SpatialTree: size() and coordinate a of point i.
+//
+struct VertexPoints
+{
+	VertexPoints(const glm::vec3 *vertices = NULL, int n = 0) : vertices(vertices), n(n) {}
+	int size() const { return n; }
+	float operator()(int i, int a) const { return vertices[i][a]; }
+
+	const glm::vec3 *vertices;
+	int n;
+};
+
+//  x and z of each vertex, for a quadtree over a height field or the pads
+//
+struct XZPoints
+{
+	XZPoints(const glm::vec3 *vertices = NULL, int n = 0) : vertices(vertices), n(n) {}
+	int size() const { return n; }
+	float operator()(int i, int a) const { return a == 0 ? vertices[i].x : vertices[i].z; }
+
+	const glm::vec3 *vertices;
+	int n;
+};
+
+//  Dim floats per point, stride floats apart, e.g. particle positions in a
+//  flat array
+//
+template <int Dim>
+struct FloatPoints
+{
+	FloatPoints(const float *data = NULL, int n = 0, int stride = Dim) : data(data), n(n), stride(stride) {}
+	int size() const { return n; }
+	float operator()(int i, int a) const { return data[(size_t)i * stride + a]; }
+
+	const float *data;
+	int n;
+	int stride;
+};
+
+//  Which half of each axis child c of a node covers: bit a of c, 1 for the
+//  upper half.  Built at compile time.
+//
+template <int Dim>
+struct ChildOffsets
+{
+	enum { Count = 1 << Dim };
+	int upper[Count][Dim];
+
+	constexpr ChildOffsets() : upper()
+	{
+		for (int c = 0; c < Count; c++)
+			for (int a = 0; a < Dim; a++)
+				upper[c][a] = (c >> a) & 1;
+	}
+};
+
+//  f(0) ... f(N - 1) written out by the compiler, stopping at the first
+//  call that returns true
+//
+template <int N>
+struct Unroll
+{
+	template <class F> static bool run(F && f) { return Unroll<N - 1>::run(f) || f(N - 1); }
+};
+
+template <>
+struct Unroll<0>
+{
+	template <class F> static bool run(F &&) { return false; }
+};
+
+//  A 2^Dim-ary tree over points, with everything that shapes it fixed at
+//  compile time: the dimension, how points are read (Points, see above),
+//  the most points a leaf holds and the deepest a node can be.  A node
+//  splits its box in half along every axis and each point goes to exactly
+//  one child, the upper half only if it is strictly above the center.
+//  Nodes live in one array, 12 bytes each; the children of a node are
+//  contiguous and only the non-empty ones are stored, found through a bit
+//  mask.  Boxes are not stored but halved on the way down.  Leaves are
+//  ranges of one index array, so a tree costs about 4 bytes per point
+//  plus its nodes.
+//
+//      TerrainOctree tree;
+//      tree.build(VertexPoints(&mesh.getVertices()[0], n));
+//      int v = tree.nearestInLeaf(&p.x);
+//
+template <int Dim, class Points, int LeafSize, int MaxDepth>
+class SpatialTree
+{
+public:
+	enum { NumChildren = 1 << Dim };
+	static_assert(Dim >= 1 && Dim <= 4, "SpatialTree supports 1 to 4 dimensions");
+	static_assert(LeafSize >= 1, "a leaf holds at least one point");
+
+	struct Node
+	{
+		int first;    // first child in nodes, or first point in indices for a leaf
+		int count;    // points below this node
+		int mask;     // bit c set if child c exists, 0 for a leaf
+	};
+
+	void build(const Points & points);
+	void build(const Points & points, const float *boundsMin, const float *boundsMax);
+
+	int leafAt(const float *p) const;
+	int nearestInLeaf(const float *p) const;
+	int nearest(const float *p) const;
+	template <class F> void forEachInBox(const float *boxMin, const float *boxMax, F f) const;
+
+	size_t bytes() const { return nodes.size() * sizeof(Node) + indices.size() * sizeof(int); }
+
+	Points points;
+	float min[Dim], max[Dim];
+	vector<Node> nodes;
+	vector<int> indices;   // point indices, each leaf a range
+
+	static constexpr ChildOffsets<Dim> offsets = ChildOffsets<Dim>();
+
+private:
+	void split(int index, int first, int n, const float *lo, const float *hi, int depth, Arena & arena);
+	void nearest(int index, const float *p, const float *lo, const float *hi, int & best, float & bestD2) const;
+	template <class F> void forEachInBox(int index, const float *lo, const float *hi, const float *boxMin, const float *boxMax, F & f) const;
+
+	float distance2(int i, const float *p) const
+	{
+		float d2 = 0;
+		for (int a = 0; a < Dim; a++)
+		{
+			float d = points(i, a) - p[a];
+			d2 += d * d;
+		}
+		return d2;
+	}
+
+	static void childBox(int c, const float *lo, const float *hi, const float *center, float *childLo, float *childHi)
+	{
+		for (int a = 0; a < Dim; a++)
+		{
+			childLo[a] = offsets.upper[c][a] ? center[a] : lo[a];
+			childHi[a] = offsets.upper[c][a] ? hi[a] : center[a];
+		}
+	}
+
+	static int bitCount(unsigned int v)
+	{
+		v = v - ((v >> 1) & 0x55555555);
+		v = (v & 0x33333333) + ((v >> 2) & 0x33333333);
+		return (int)((((v + (v >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24);
+	}
+};
+
+template <int Dim, class Points, int LeafSize, int MaxDepth>
+constexpr ChildOffsets<Dim> SpatialTree<Dim, Points, LeafSize, MaxDepth>::offsets;
+
+//  the terrain's vertices, split down to single points like Octree at 13
+//  levels, and a quadtree over their x and z for the ground below a point
+//
+typedef SpatialTree<3, VertexPoints, 1, 12> TerrainOctree;
+typedef SpatialTree<2, XZPoints, 16, 16> TerrainQuadtree;
+
+template <int Dim, class Points, int LeafSize, int MaxDepth>
+void SpatialTree<Dim, Points, LeafSize, MaxDepth>::build(const Points & points)
+{
+	float lo[Dim], hi[Dim];
+	for (int a = 0; a < Dim; a++)
+	{
+		lo[a] = points.size() > 0 ? points(0, a) : 0;
+		hi[a] = lo[a];
+	}
+	for (int i = 1; i < points.size(); i++)
+	{
+		for (int a = 0; a < Dim; a++)
+		{
+			float v = points(i, a);
+			if (v < lo[a]) lo[a] = v;
+			if (v > hi[a]) hi[a] = v;
+		}
+	}
+	build(points, lo, hi);
+}
+
+template <int Dim, class Points, int LeafSize, int MaxDepth>
+void SpatialTree<Dim, Points, LeafSize, MaxDepth>::build(const Points & points, const float *boundsMin, const float *boundsMax)
+{
+	this->points = points;
+	int n = points.size();
+	for (int a = 0; a < Dim; a++)
+	{
+		min[a] = boundsMin[a];
+		max[a] = boundsMax[a];
+	}
+	indices.resize(n);
+	for (int i = 0; i < n; i++)
+		indices[i] = i;
+	nodes.clear();
+	nodes.push_back(Node());
+
+	// the octant of each point and a copy to scatter from, for one node at
+	// a time
+	//
+	Arena arena(n * (sizeof(int) + 1) + 64 * 1024);
+	split(0, 0, n, min, max, 0, arena);
+}
+
+//  Sort the node's range of indices by child, stable so every leaf keeps
+//  its points in index order, then split each child the same way.
+//
+template <int Dim, class Points, int LeafSize, int MaxDepth>
+void SpatialTree<Dim, Points, LeafSize, MaxDepth>::split(int index, int first, int n, const float *lo, const float *hi, int depth, Arena & arena)
+{
+	if (n <= LeafSize || depth >= MaxDepth)
+	{
+		Node & leaf = nodes[index];
+		leaf.first = first;
+		leaf.count = n;
+		leaf.mask = 0;
+		return;
+	}
+
+	float center[Dim];
+	for (int a = 0; a < Dim; a++)
+		center[a] = lo[a] + (hi[a] - lo[a]) * .5f;
+
+	Arena::Marker start = arena.mark();
+	unsigned char *octant = arena.allocate<unsigned char>(n);
+	int *scratch = arena.allocate<int>(n);
+	int *range = &indices[first];
+	int counts[NumChildren] = {};
+	for (int i = 0; i < n; i++)
+	{
+		int c = 0;
+		for (int a = 0; a < Dim; a++)
+			c |= (points(range[i], a) > center[a]) << a;
+		octant[i] = (unsigned char)c;
+		counts[c]++;
+	}
+
+	int offset[NumChildren];
+	int running = 0, mask = 0, numChildren = 0;
+	Unroll<NumChildren>::run([&](int c) {
+		offset[c] = running;
+		running += counts[c];
+		if (counts[c] > 0)
+		{
+			mask |= 1 << c;
+			numChildren++;
+		}
+		return false;
+	});
+	for (int i = 0; i < n; i++)
+		scratch[offset[octant[i]]++] = range[i];
+	memcpy(range, scratch, n * sizeof(int));
+	arena.release(start);
+
+	int child = (int)nodes.size();
+	nodes.resize(child + numChildren);
+	nodes[index].first = child;
+	nodes[index].count = n;
+	nodes[index].mask = mask;
+
+	int begin = first;
+	Unroll<NumChildren>::run([&](int c) {
+		if (counts[c] == 0) return false;
+		float childLo[Dim], childHi[Dim];
+		childBox(c, lo, hi, center, childLo, childHi);
+		split(child++, begin, counts[c], childLo, childHi, depth + 1, arena);
+		begin += counts[c];
+		return false;
+	});
+}
+
+//  the leaf whose box holds p, -1 if p is outside the tree or falls in an
+//  empty child
+//
+template <int Dim, class Points, int LeafSize, int MaxDepth>
+int SpatialTree<Dim, Points, LeafSize, MaxDepth>::leafAt(const float *p) const
+{
+	if (nodes.empty()) return -1;
+	float lo[Dim], hi[Dim];
+	for (int a = 0; a < Dim; a++)
+	{
+		if (p[a] < min[a] || p[a] > max[a]) return -1;
+		lo[a] = min[a];
+		hi[a] = max[a];
+	}
+
+	int index = 0;
+	while (nodes[index].mask)
+	{
+		const Node & node = nodes[index];
+		int c = 0;
+		for (int a = 0; a < Dim; a++)
+		{
+			float center = lo[a] + (hi[a] - lo[a]) * .5f;
+			if (p[a] > center)
+			{
+				c |= 1 << a;
+				lo[a] = center;
+			}
+			else hi[a] = center;
+		}
+		if ((node.mask & (1 << c)) == 0) return -1;
+		index = node.first + bitCount(node.mask & ((1 << c) - 1));
+	}
+	return index;
+}
+
+//  the point of leafAt(p) nearest p, -1 if there is no leaf; the cheap
+//  answer Octree::intersect(point) gives
+//
+template <int Dim, class Points, int LeafSize, int MaxDepth>
+int SpatialTree<Dim, Points, LeafSize, MaxDepth>::nearestInLeaf(const float *p) const
+{
+	int leaf = leafAt(p);
+	if (leaf < 0) return -1;
+	int best = -1;
+	float bestD2 = numeric_limits<float>::max();
+	const Node & node = nodes[leaf];
+	for (int i = node.first; i < node.first + node.count; i++)
+	{
+		float d2 = distance2(indices[i], p);
+		if (d2 < bestD2)
+		{
+			best = indices[i];
+			bestD2 = d2;
+		}
+	}
+	return best;
+}
+
+//  the nearest point to p, the lowest index on a tie, -1 for an empty tree
+//
+template <int Dim, class Points, int LeafSize, int MaxDepth>
+int SpatialTree<Dim, Points, LeafSize, MaxDepth>::nearest(const float *p) const
+{
+	int best = -1;
+	float bestD2 = numeric_limits<float>::max();
+	if (!nodes.empty()) nearest(0, p, min, max, best, bestD2);
+	return best;
+}
+
+//  children are visited starting with the one p falls in, and skipped when
+//  their box is farther than the best point so far
+//
+template <int Dim, class Points, int LeafSize, int MaxDepth>
+void SpatialTree<Dim, Points, LeafSize, MaxDepth>::nearest(int index, const float *p, const float *lo, const float *hi, int & best, float & bestD2) const
+{
+	const Node & node = nodes[index];
+	if (node.mask == 0)
+	{
+		for (int i = node.first; i < node.first + node.count; i++)
+		{
+			float d2 = distance2(indices[i], p);
+			if (d2 < bestD2 || (d2 == bestD2 && indices[i] < best))
+			{
+				best = indices[i];
+				bestD2 = d2;
+			}
+		}
+		return;
+	}
+
+	float center[Dim];
+	int home = 0;
+	for (int a = 0; a < Dim; a++)
+	{
+		center[a] = lo[a] + (hi[a] - lo[a]) * .5f;
+		home |= (p[a] > center[a]) << a;
+	}
+	int slot[NumChildren];
+	int next = node.first;
+	Unroll<NumChildren>::run([&](int c) {
+		slot[c] = (node.mask & (1 << c)) ? next++ : -1;
+		return false;
+	});
+
+	Unroll<NumChildren>::run([&](int k) {
+		int c = k ^ home;
+		if (slot[c] < 0) return false;
+		float childLo[Dim], childHi[Dim];
+		childBox(c, lo, hi, center, childLo, childHi);
+		float d2 = 0;
+		for (int a = 0; a < Dim; a++)
+		{
+			float d = p[a] < childLo[a] ? childLo[a] - p[a] : (p[a] > childHi[a] ? p[a] - childHi[a] : 0);
+			d2 += d * d;
+		}
+		if (d2 <= bestD2) nearest(slot[c], p, childLo, childHi, best, bestD2);
+		return false;
+	});
+}
+
+//  f(index) for every point inside the box, bounds included
+//
+template <int Dim, class Points, int LeafSize, int MaxDepth>
+template <class F>
+void SpatialTree<Dim, Points, LeafSize, MaxDepth>::forEachInBox(const float *boxMin, const float *boxMax, F f) const
+{
+	if (!nodes.empty()) forEachInBox(0, min, max, boxMin, boxMax, f);
+}
+
+template <int Dim, class Points, int LeafSize, int MaxDepth>
+template <class F>
+void SpatialTree<Dim, Points, LeafSize, MaxDepth>::forEachInBox(int index, const float *lo, const float *hi,
+	const float *boxMin, const float *boxMax, F & f) const
+{
+	const Node & node = nodes[index];
+	if (node.mask == 0)
+	{
+		for (int i = node.first; i < node.first + node.count; i++)
+		{
+			bool inside = true;
+			for (int a = 0; a < Dim; a++)
+			{
+				float v = points(indices[i], a);
+				inside = inside && v >= boxMin[a] && v <= boxMax[a];
+			}
+			if (inside) f(indices[i]);
+		}
+		return;
+	}
+
+	float center[Dim];
+	for (int a = 0; a < Dim; a++)
+		center[a] = lo[a] + (hi[a] - lo[a]) * .5f;
+	int child = node.first;
+	Unroll<NumChildren>::run([&](int c) {
+		if ((node.mask & (1 << c)) == 0) return false;
+		float childLo[Dim], childHi[Dim];
+		childBox(c, lo, hi, center, childLo, childHi);
+		bool overlaps = true;
+		for (int a = 0; a < Dim; a++)
+			overlaps = overlaps && childLo[a] <= boxMax[a] && childHi[a] >= boxMin[a];
+		if (overlaps) forEachInBox(child, childLo, childHi, boxMin, boxMax, f);
+		child++;
+		return false;
+	});
+}
@@ -0,0 +1,541 @@
+#include "TiledTerrain.h"
+#include "Octree.h"
+#include "Profiler.h"
+#include <chrono>
+#include <iomanip>
+#include <thread>
+
+static double msSince(chrono::steady_clock::time_point t0)
+{
+	return chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+}
+
+//  seeded value in [-.5, .5) for a vertex of the world grid, the same for
+//  the two tiles sharing it
+//
+static float gridNoise(int x, int z, unsigned int seed)
+{
+	uint32_t h = (uint32_t)x * 0x8da6b343u ^ (uint32_t)z * 0xd8163841u ^ seed * 0xcb1ab31fu;
+	h ^= h >> 13;
+	h *= 0x5bd1e995u;
+	h ^= h >> 15;
+	return (h & 0xFFFFFF) / 16777216.0f - .5f;
+}
+
+//  Benchmark::makeTerrain's hills on a world wide swell
+//
+static float gridHeight(float x, float z, int gx, int gz, unsigned int seed)
+{
+	return 40 * sin(x * .004) * cos(z * .0035) + 12 * sin(x * .03) * cos(z * .025) + 4 * sin(x * .11 + z * .07)
+		+ gridNoise(gx, gz, seed);
+}
+
+string TiledTerrain::tilePath(const string & dir, int x, int z, const char *ext)
+{
+	return dir + "/tile_" + to_string(x) + "_" + to_string(z) + ext;
+}
+
+bool TiledTerrain::generate(const string & dir, int tilesX, int tilesZ, int verticesPerSide, float tileSize,
+	int numLevels, unsigned int seed)
+{
+	PROFILE_SCOPE("TiledTerrain::generate");
+
+	ofDirectory::createDirectory(dir, false, true);
+	ofstream manifest(dir + "/tiles.txt");
+	if (!manifest)
+	{
+		cout << "can't write " << dir << "/tiles.txt" << endl;
+		return false;
+	}
+	manifest << setprecision(9);
+	manifest << "# tilesX tilesZ tileSize verticesPerSide levels seed" << endl;
+	manifest << tilesX << " " << tilesZ << " " << tileSize << " " << verticesPerSide << " " << numLevels << " " << seed << endl;
+	manifest << "# x z minY maxY" << endl;
+
+	int side = verticesPerSide;
+	float step = tileSize / (side - 1);
+	glm::vec2 origin(-tilesX * tileSize / 2, -tilesZ * tileSize / 2);
+	vector<float> height((side + 2) * (side + 2));
+	for (int tz = 0; tz < tilesZ; tz++)
+	{
+		for (int tx = 0; tx < tilesX; tx++)
+		{
+			// heights with a one vertex border for the normals, in world
+			// grid coordinates so the edges match the neighbours'
+			//
+			int gx0 = tx * (side - 1) - 1;
+			int gz0 = tz * (side - 1) - 1;
+			for (int z = 0; z < side + 2; z++)
+			{
+				for (int x = 0; x < side + 2; x++)
+				{
+					int gx = gx0 + x, gz = gz0 + z;
+					height[z * (side + 2) + x] = gridHeight(origin.x + gx * step, origin.y + gz * step, gx, gz, seed);
+				}
+			}
+
+			ofMesh mesh;
+			mesh.getVertices().reserve(side * side);
+			mesh.getNormals().reserve(side * side);
+			for (int z = 0; z < side; z++)
+			{
+				for (int x = 0; x < side; x++)
+				{
+					const float *h = &height[(z + 1) * (side + 2) + x + 1];
+					mesh.addVertex(glm::vec3(origin.x + (gx0 + 1 + x) * step, h[0], origin.y + (gz0 + 1 + z) * step));
+					mesh.addNormal(glm::normalize(glm::vec3(h[-1] - h[1], 2 * step, h[-(side + 2)] - h[side + 2])));
+				}
+			}
+			mesh.getIndices().reserve((side - 1) * (side - 1) * 6);
+			for (int z = 0; z + 1 < side; z++)
+			{
+				for (int x = 0; x + 1 < side; x++)
+				{
+					int i = z * side + x;
+					mesh.addIndex(i);
+					mesh.addIndex(i + side);
+					mesh.addIndex(i + 1);
+					mesh.addIndex(i + 1);
+					mesh.addIndex(i + side);
+					mesh.addIndex(i + side + 1);
+				}
+			}
+
+			CompactOctree index;
+			index.create(mesh, numLevels);
+			if (!MeshCache::write(tilePath(dir, tx, tz, ".llmesh"), mesh) || !index.write(tilePath(dir, tx, tz, ".lloct")))
+				return false;
+			manifest << tx << " " << tz << " " << index.box.min().y << " " << index.box.max().y << endl;
+		}
+	}
+	return manifest.good();
+}
+
+bool TiledTerrain::open(const string & path)
+{
+	close();
+
+	ifstream in(path + "/tiles.txt");
+	if (!in) return false;
+	string line;
+	int lineNumber = 0;
+	bool haveGrid = false;
+	while (getline(in, line))
+	{
+		lineNumber++;
+		size_t start = line.find_first_not_of(" \t\r");
+		if (start == string::npos || line[start] == '#') continue;
+
+		istringstream fields(line);
+		if (!haveGrid)
+		{
+			if (!(fields >> tilesX >> tilesZ >> tileSize >> verticesPerSide >> levels >> seed) || tilesX <= 0 || tilesZ <= 0)
+			{
+				cout << "TiledTerrain: " << path << "/tiles.txt line " << lineNumber << ": expected tilesX tilesZ tileSize verticesPerSide levels seed" << endl;
+				return false;
+			}
+			haveGrid = true;
+			origin = glm::vec2(-tilesX * tileSize / 2, -tilesZ * tileSize / 2);
+			slots = vector<Slot>(tilesX * tilesZ);
+			continue;
+		}
+
+		int x, z;
+		float minY, maxY;
+		if (!(fields >> x >> z >> minY >> maxY) || x < 0 || x >= tilesX || z < 0 || z >= tilesZ)
+		{
+			cout << "TiledTerrain: " << path << "/tiles.txt line " << lineNumber << ": expected x z minY maxY" << endl;
+			slots.clear();
+			return false;
+		}
+
+		// the same floats CompactOctree::create worked out for the tile's
+		// box, so the bounds test here agrees with the tile's own
+		//
+		Slot & s = slots[z * tilesX + x];
+		float step = tileSize / (verticesPerSide - 1);
+		int gx = x * (verticesPerSide - 1), gz = z * (verticesPerSide - 1);
+		s.bounds = Box(glm::vec3(origin.x + gx * step, minY, origin.y + gz * step),
+			glm::vec3(origin.x + (gx + verticesPerSide - 1) * step, maxY, origin.y + (gz + verticesPerSide - 1) * step));
+		s.fileBytes = ofFile(tilePath(path, x, z, ".llmesh")).getSize() + ofFile(tilePath(path, x, z, ".lloct")).getSize();
+	}
+	dir = path;
+	stats = Stats();
+	return haveGrid;
+}
+
+void TiledTerrain::close()
+{
+	for (int i = 0; i < inFlight.size(); i++)
+		slots[inFlight[i]].loading.wait();
+	slots.clear();
+	lru.clear();
+	inFlight.clear();
+	inFlightBytes = 0;
+	stats.residentBytes = 0;
+	stats.residentTiles = 0;
+	dir.clear();
+}
+
+//  on a loading thread: map the mesh, read the index and touch the vertex
+//  pages, so the first queries don't fault them in on the main thread
+//
+static unique_ptr<TerrainTile> loadTile(const string & meshPath, const string & indexPath)
+{
+	unique_ptr<TerrainTile> tile(new TerrainTile);
+	if (!tile->mesh.open(meshPath) || !tile->index.read(indexPath, tile->mesh.view))
+	{
+		cout << "TiledTerrain: can't load " << meshPath << endl;
+		return unique_ptr<TerrainTile>();
+	}
+	const MeshView & v = tile->mesh.view;
+	const char *pages[2] = { (const char*)v.vertices, (const char*)v.normals };
+	size_t bytes = v.numVertices * sizeof(glm::vec3);
+	unsigned int sum = 0;
+	for (int k = 0; k < 2; k++)
+		for (size_t b = 0; pages[k] && b < bytes; b += 4096)
+			sum += pages[k][b];
+	volatile unsigned int sink = sum;
+	(void)sink;
+	return tile;
+}
+
+void TiledTerrain::install(int i, unique_ptr<TerrainTile> tile)
+{
+	Slot & s = slots[i];
+	if (!tile)
+	{
+		s.failed = true;
+		return;
+	}
+	s.tile = move(tile);
+	lru.push_front(i);
+	s.lru = lru.begin();
+	stats.loaded++;
+	stats.residentTiles++;
+	stats.residentBytes += s.tile->bytes();
+	stats.peakResidentTiles = max(stats.peakResidentTiles, stats.residentTiles);
+	stats.peakResidentBytes = max(stats.peakResidentBytes, stats.residentBytes);
+}
+
+void TiledTerrain::evict(int i)
+{
+	Slot & s = slots[i];
+	stats.evicted++;
+	stats.residentTiles--;
+	stats.residentBytes -= s.tile->bytes();
+	lru.erase(s.lru);
+	s.tile.reset();
+}
+
+//  the tile for a query, waiting for it if it isn't in memory
+//
+TerrainTile* TiledTerrain::acquire(int i)
+{
+	Slot & s = slots[i];
+	if (s.tile)
+	{
+		lru.splice(lru.begin(), lru, s.lru);
+		return s.tile.get();
+	}
+	if (s.failed) return NULL;
+
+	chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+	if (s.loading.valid())
+	{
+		install(i, s.loading.get());
+		inFlight.erase(find(inFlight.begin(), inFlight.end(), i));
+		inFlightBytes -= s.fileBytes;
+	}
+	else install(i, loadTile(tilePath(dir, i % tilesX, i / tilesX, ".llmesh"), tilePath(dir, i % tilesX, i / tilesX, ".lloct")));
+	double ms = msSince(t0);
+	stats.stalls++;
+	stats.stallMs += ms;
+	stats.longestStallMs = max(stats.longestStallMs, ms);
+	return s.tile.get();
+}
+
+void TiledTerrain::update(const glm::vec3 & position)
+{
+	PROFILE_SCOPE("TiledTerrain::update");
+	chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+
+	// finished loads
+	//
+	for (int k = 0; k < inFlight.size(); )
+	{
+		Slot & s = slots[inFlight[k]];
+		if (s.loading.wait_for(chrono::seconds(0)) != future_status::ready)
+		{
+			k++;
+			continue;
+		}
+		inFlightBytes -= s.fileBytes;
+		install(inFlight[k], s.loading.get());
+		inFlight.erase(inFlight.begin() + k);
+	}
+
+	// tiles within radius, nearest first, move to the front of the lru
+	//
+	vector<pair<float, int> > wanted;
+	for (int i = 0; i < slots.size(); i++)
+		slots[i].wanted = false;
+	int x0 = max(0, (int)floor((position.x - radius - origin.x) / tileSize));
+	int x1 = min(tilesX - 1, (int)floor((position.x + radius - origin.x) / tileSize));
+	int z0 = max(0, (int)floor((position.z - radius - origin.y) / tileSize));
+	int z1 = min(tilesZ - 1, (int)floor((position.z + radius - origin.y) / tileSize));
+	for (int z = z0; z <= z1; z++)
+	{
+		for (int x = x0; x <= x1; x++)
+		{
+			Slot & s = slots[z * tilesX + x];
+			float dx = max(max(s.bounds.min().x - position.x, position.x - s.bounds.max().x), 0.0f);
+			float dz = max(max(s.bounds.min().z - position.z, position.z - s.bounds.max().z), 0.0f);
+			float d = sqrt(dx * dx + dz * dz);
+			if (d > radius) continue;
+			s.wanted = true;
+			wanted.push_back(make_pair(d, z * tilesX + x));
+		}
+	}
+	sort(wanted.begin(), wanted.end());
+	for (int k = (int)wanted.size() - 1; k >= 0; k--)
+	{
+		Slot & s = slots[wanted[k].second];
+		if (s.tile) lru.splice(lru.begin(), lru, s.lru);
+	}
+
+	// drop the least recently used tiles outside radius while over budget
+	//
+	list<int>::iterator it = lru.end();
+	while (it != lru.begin() && stats.residentBytes + inFlightBytes > budget)
+	{
+		--it;
+		if (slots[*it].wanted) continue;
+		int i = *it;
+		++it;
+		evict(i);
+	}
+
+	// start loading the nearest missing ones
+	//
+	for (int k = 0; k < wanted.size() && inFlight.size() < maxLoads; k++)
+	{
+		int i = wanted[k].second;
+		Slot & s = slots[i];
+		if (s.tile || s.loading.valid() || s.failed) continue;
+		s.loading = async(launch::async, loadTile, tilePath(dir, i % tilesX, i / tilesX, ".llmesh"),
+			tilePath(dir, i % tilesX, i / tilesX, ".lloct"));
+		inFlight.push_back(i);
+		inFlightBytes += s.fileBytes;
+	}
+
+	stats.longestUpdateMs = max(stats.longestUpdateMs, msSince(t0));
+}
+
+//  every tile whose box holds the point, up to four on a corner; the norm
+//  keeps the nearest of their answers.  The edges of the boxes are rounded
+//  off the grid lines, so the neighbours on both sides are tested.
+//
+bool TiledTerrain::intersect(const glm::vec3 & point, glm::vec3 *norm)
+{
+	int x = (int)floor((point.x - origin.x) / tileSize);
+	int z = (int)floor((point.z - origin.y) / tileSize);
+	bool hit = false;
+	for (int tz = max(z - 1, 0); tz <= min(z + 1, tilesZ - 1); tz++)
+	{
+		for (int tx = max(x - 1, 0); tx <= min(x + 1, tilesX - 1); tx++)
+		{
+			int i = tz * tilesX + tx;
+			if (!slots[i].bounds.inside(point)) continue;
+			TerrainTile *tile = acquire(i);
+			if (tile && tile->index.intersect(point, norm)) hit = true;
+		}
+	}
+	return hit;
+}
+
+//  walks the tiles under the ray in the order it crosses them (a 2D DDA
+//  over the grid), querying those it passes through between their minY
+//  and maxY.  Each tile is queried from where the ray enters it, which
+//  keeps far tiles within the query range of Box::intersect.
+//
+bool TiledTerrain::intersect(const glm::vec3 & point, const glm::vec3 & dir, Box & leafRtn)
+{
+	if (slots.empty()) return false;
+
+	// where the ray is over the world's footprint
+	//
+	float t0 = 0, t1 = 1e30f;
+	float lo[2] = { origin.x, origin.y };
+	float hi[2] = { origin.x + tilesX * tileSize, origin.y + tilesZ * tileSize };
+	float p[2] = { point.x, point.z };
+	float d[2] = { dir.x, dir.z };
+	for (int a = 0; a < 2; a++)
+	{
+		if (d[a] == 0)
+		{
+			if (p[a] < lo[a] || p[a] > hi[a]) return false;
+			continue;
+		}
+		float ta = (lo[a] - p[a]) / d[a];
+		float tb = (hi[a] - p[a]) / d[a];
+		t0 = max(t0, min(ta, tb));
+		t1 = min(t1, max(ta, tb));
+	}
+	if (t0 > t1) return false;
+
+	int cell[2], step[2], count[2] = { tilesX, tilesZ };
+	float next[2], delta[2];
+	for (int a = 0; a < 2; a++)
+	{
+		float c = p[a] + d[a] * t0;
+		cell[a] = min(max((int)floor((c - lo[a]) / tileSize), 0), count[a] - 1);
+		step[a] = d[a] > 0 ? 1 : -1;
+		next[a] = d[a] != 0 ? (lo[a] + (cell[a] + (d[a] > 0)) * tileSize - p[a]) / d[a] : 1e30f;
+		delta[a] = d[a] != 0 ? tileSize / fabs(d[a]) : 1e30f;
+	}
+
+	float enter = t0;
+	for (;;)
+	{
+		float exit = min(min(next[0], next[1]), t1);
+		int i = cell[1] * tilesX + cell[0];
+		const Box & b = slots[i].bounds;
+		float y0 = point.y + dir.y * enter, y1 = point.y + dir.y * exit;
+		if (max(y0, y1) >= b.min().y && min(y0, y1) <= b.max().y)
+		{
+			TerrainTile *tile = acquire(i);
+			if (tile && tile->index.intersect(point + dir * enter, dir, leafRtn)) return true;
+		}
+		if (exit >= t1) return false;
+
+		int a = next[0] < next[1] ? 0 : 1;
+		cell[a] += step[a];
+		if (cell[a] < 0 || cell[a] >= count[a]) return false;
+		enter = next[a];
+		next[a] += delta[a];
+	}
+}
+
+Box TiledTerrain::bounds() const
+{
+	float minY = 1e30f, maxY = -1e30f;
+	for (int i = 0; i < slots.size(); i++)
+	{
+		minY = min(minY, slots[i].bounds.min().y);
+		maxY = max(maxY, slots[i].bounds.max().y);
+	}
+	return Box(glm::vec3(origin.x, minY, origin.y), glm::vec3(origin.x + tilesX * tileSize, maxY, origin.y + tilesZ * tileSize));
+}
+
+bool TiledTerrain::isResident(int x, int z) const
+{
+	return slots[z * tilesX + x].tile != NULL;
+}
+
+size_t TiledTerrain::totalBytes() const
+{
+	size_t n = 0;
+	for (int i = 0; i < slots.size(); i++)
+		n += slots[i].fileBytes;
+	return n;
+}
+
+//  a figure of eight over the world at a constant speed and a fixed height
+//  above its highest point, measuring the ground below every frame with a
+//  ray and a point query where the ray hit.  Some rays pass between the
+//  leaf boxes, as they do through a single CompactOctree; a point query
+//  that misses means a tile was lost.
+//
+int TiledTerrain::main(const vector<string> & args)
+{
+	string path = "tiles";
+	int first = 1;
+	if (args.size() > 1 && args[1].compare(0, 2, "--") != 0)
+	{
+		path = args[1];
+		first = 2;
+	}
+	int grid = 16, numVertices = 10000, numLevels = 10, fps = 60;
+	float budgetMB = 24, radius = 600, speed = 150, seconds = 40, tileSize = 400;
+	for (int i = first; i + 1 < args.size(); i += 2)
+	{
+		if (args[i] == "--grid") grid = ofToInt(args[i + 1]);
+		else if (args[i] == "--tile-vertices") numVertices = ofToInt(args[i + 1]);
+		else if (args[i] == "--levels") numLevels = ofToInt(args[i + 1]);
+		else if (args[i] == "--budget") budgetMB = ofToFloat(args[i + 1]);
+		else if (args[i] == "--radius") radius = ofToFloat(args[i + 1]);
+		else if (args[i] == "--speed") speed = ofToFloat(args[i + 1]);
+		else if (args[i] == "--seconds") seconds = ofToFloat(args[i + 1]);
+		else if (args[i] == "--fps") fps = ofToInt(args[i + 1]);
+		else
+		{
+			cout << "usage: --tiles [data/tiles] [--grid 16] [--tile-vertices 10000] [--levels 10] [--budget MB] "
+				"[--radius 600] [--speed 150] [--seconds 40] [--fps 60, 0: unpaced]" << endl;
+			return 2;
+		}
+	}
+	path = ofToDataPath(path);
+	int side = max(2, (int)ceil(sqrt((double)numVertices)));
+
+	TiledTerrain world;
+	if (!world.open(path) || world.tilesX != grid || world.tilesZ != grid || world.verticesPerSide != side ||
+		world.levels != numLevels || world.tileSize != tileSize)
+	{
+		cout << "generating " << grid << "x" << grid << " tiles of " << side * side << " vertices in " << path << endl;
+		chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+		if (!generate(path, grid, grid, side, tileSize, numLevels) || !world.open(path)) return 2;
+		cout << "generated in " << fixed << setprecision(1) << msSince(t0) / 1000 << " s" << defaultfloat << endl;
+	}
+	world.budget = (size_t)(budgetMB * 1048576);
+	world.radius = radius;
+
+	MeshCache::resetPeakMemory();
+	size_t baseline, peak;
+	MeshCache::memoryUsage(baseline, peak);
+
+	Box b = world.bounds();
+	glm::vec3 center = (b.min() + b.max()) / 2;
+	float rx = .4 * (b.max().x - b.min().x), rz = .4 * (b.max().z - b.min().z);
+	float altitude = b.max().y + 20;
+	float dt = 1.0 / 60;
+	int frames = (int)(seconds / dt);
+	float u = 0, distance = 0;
+	int rayHits = 0, pointMisses = 0;
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	for (int f = 0; f < frames; f++)
+	{
+		glm::vec3 position(center.x + rx * sin(u), altitude, center.z + rz * sin(2 * u));
+		world.update(position);
+
+		Box leaf(glm::vec3(1e9, 1e9, 1e9), glm::vec3(1e9, 1e9, 1e9));
+		glm::vec3 norm(10000, 10000, 10000);
+		if (world.intersect(position, glm::vec3(0, -1, 0), leaf))
+		{
+			rayHits++;
+			if (!world.intersect(leaf.center(), &norm)) pointMisses++;
+		}
+
+		float rate = sqrt(rx * cos(u) * rx * cos(u) + 4 * rz * cos(2 * u) * rz * cos(2 * u));
+		u += speed * dt / rate;
+		distance += speed * dt;
+		if (fps > 0)
+			this_thread::sleep_until(start + chrono::microseconds((long long)((f + 1) * 1e6 / fps)));
+	}
+	size_t current;
+	MeshCache::memoryUsage(current, peak);
+
+	const Stats & s = world.stats;
+	cout << fixed << setprecision(1);
+	cout << "tiled flight: " << grid << "x" << grid << " tiles of " << side * side << " vertices, "
+		<< world.totalBytes() / 1048576.0 << " MB on disk, budget " << budgetMB << " MB, radius " << radius << endl;
+	cout << "  " << frames << " frames " << (fps > 0 ? "at " + to_string(fps) + " fps" : string("unpaced"))
+		<< ", " << distance << " units flown, ground found under " << rayHits << ", " << pointMisses << " point misses" << endl;
+	cout << "  loaded " << s.loaded << " tiles, evicted " << s.evicted << ", resident high-water "
+		<< s.peakResidentBytes / 1048576.0 << " MB in " << s.peakResidentTiles << " tiles" << endl;
+	cout << "  stalls " << s.stalls << " (" << setprecision(2) << s.stallMs << " ms, longest " << s.longestStallMs
+		<< " ms), longest update " << s.longestUpdateMs << " ms" << endl;
+	cout << "  process peak +" << setprecision(1) << (peak > baseline ? peak - baseline : 0) / 1048576.0 << " MB" << endl;
+	cout << defaultfloat;
+	return pointMisses > 0 ? 1 : 0;
+}
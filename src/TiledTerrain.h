@@ -0,0 +1,127 @@
+#pragma once
+#include "ofMain.h"
+#include "box.h"
+#include "MeshCache.h"
+#include "CompactOctree.h"
+#include <future>
+
+//  One tile of a TiledTerrain while it is in memory: its mesh mapped from
+//  tile_x_z.llmesh and the CompactOctree over it read from tile_x_z.lloct.
+//
+struct TerrainTile
+{
+	MeshCache mesh;
+	CompactOctree index;
+
+	size_t bytes() const { return mesh.bytes() + index.bytes(); }
+};
+
+//  Terrain made of a grid of square tiles, each with its own mesh and
+//  prebuilt collision index on disk, listed with their bounds in tiles.txt:
+//
+//      # tilesX tilesZ tileSize verticesPerSide levels seed
+//      16 16 400 100 10 1
+//      # x z minY maxY
+//      0 0 -53.1 49.8
+//
+//  update() is called once a frame with the lander's position.  Tiles
+//  within radius of it are loaded on background threads (nearest first, at
+//  most maxLoads at a time) and kept; the others stay in memory in least
+//  recently used order and are dropped from the old end once everything
+//  resident or loading adds up to more than budget bytes.  The tiles in
+//  radius are never dropped, so budget should hold at least those.
+//
+//  Queries take a world position and go to whichever tiles it falls in, so
+//  they don't see the seams: a point on a tile edge is tested against the
+//  tiles on both sides and a ray walks the tiles it crosses in order.
+//  Tiles are skipped by the bounds in tiles.txt without being loaded.  A
+//  query that needs a tile which isn't in memory yet waits for it, and
+//  that wait is counted as a stall.  Everything is called from the main
+//  thread, only the loading runs on other threads.
+//
+//      --tiles [data/tiles] [--grid 16] [--tile-vertices 10000] [--budget 24]
+//
+//  flies a scripted loop over a generated world and reports the memory
+//  high-water mark and the paging stalls along it.
+//
+class TiledTerrain
+{
+public:
+	struct Stats
+	{
+		int loaded = 0;                 // tiles read from disk
+		int evicted = 0;
+		int stalls = 0;                 // queries that waited for a tile
+		double stallMs = 0;
+		double longestStallMs = 0;
+		double longestUpdateMs = 0;
+		size_t residentBytes = 0;
+		size_t peakResidentBytes = 0;
+		int residentTiles = 0;
+		int peakResidentTiles = 0;
+	};
+
+	TiledTerrain() {}
+	~TiledTerrain() { close(); }
+	TiledTerrain(const TiledTerrain &) = delete;
+	TiledTerrain & operator=(const TiledTerrain &) = delete;
+
+	static int main(const vector<string> & args);
+
+	// writes a world of tilesX x tilesZ tiles of tileSize units, each a
+	// height field of verticesPerSide^2 vertices with its CompactOctree.
+	// Neighbouring tiles share the vertices of their common edge.
+	//
+	static bool generate(const string & dir, int tilesX, int tilesZ, int verticesPerSide, float tileSize,
+		int numLevels, unsigned int seed = 1);
+
+	bool open(const string & dir);
+	void close();
+	void update(const glm::vec3 & position);
+
+	// the same queries and results as CompactOctree's within a tile; for
+	// the ray leafRtn starts out far away, as there
+	//
+	bool intersect(const glm::vec3 & point, glm::vec3 *norm);
+	bool intersect(const glm::vec3 & point, const glm::vec3 & dir, Box & leafRtn);
+
+	Box bounds() const;
+	bool isResident(int x, int z) const;
+	size_t totalBytes() const;      // of every tile on disk, what holding the whole world would take
+
+	size_t budget = 32 * 1048576;
+	float radius = 600;
+	int maxLoads = 2;
+	Stats stats;
+
+	int tilesX = 0;
+	int tilesZ = 0;
+	float tileSize = 0;
+	int verticesPerSide = 0;
+	int levels = 0;
+	unsigned int seed = 0;
+	glm::vec2 origin;               // x and z of the world's min corner
+
+private:
+	struct Slot
+	{
+		Box bounds;
+		size_t fileBytes = 0;       // expected size once loaded
+		unique_ptr<TerrainTile> tile;
+		future<unique_ptr<TerrainTile> > loading;
+		list<int>::iterator lru;    // while resident
+		bool wanted = false;        // within radius at the last update
+		bool failed = false;
+	};
+
+	static string tilePath(const string & dir, int x, int z, const char *ext);
+	TerrainTile* acquire(int i);
+	void install(int i, unique_ptr<TerrainTile> tile);
+	void evict(int i);
+
+	string dir;
+	vector<Slot> slots;             // z * tilesX + x
+	list<int> lru;                  // resident tiles, most recently used first
+	vector<int> inFlight;
+	size_t inFlightBytes = 0;
+};
@@ -1,8 +1,16 @@
 #include "ofMain.h"
 #include "ofApp.h"
+#include "HeadlessTools.h"
 
 //========================================================================
-int main( ){
+int main(int argc, char *argv[]){
+
+	// headless modes, these never open a window
+	//
+	vector<string> args(argv + 1, argv + argc);
+	if (HeadlessTools::handles(args))
+		return HeadlessTools::main(args);
+
 	ofSetupOpenGL(1024,768,OF_WINDOW);			// <-------- setup the GL context
 
 	// this kicks off the running of my app
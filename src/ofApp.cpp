@@ -1,24 +1,40 @@
 #include "ofApp.h"
 #include <stdlib.h>     /* srand, rand */
+#include "Profiler.h"
+#include "PerfCounters.h"
+#include "Arena.h"
+
+//main thread loading steps in updateLoading(), and all the work the
+//progress bar counts (the steps, two images and the octree)
+static const int numLoadSteps = 4;
+static const int numLoadItems = numLoadSteps + 3;
 
 //--------------------------------------------------------------
 void ofApp::setup()
 {
-	bg.loadImage("images/space.jpg");
+	//decode the images off the main thread, the textures are made from
+	//them in updateLoading()
+	bgPixels = async(launch::async, []() { ofPixels p; ofLoadImage(p, "images/space.jpg"); return p; });
+	dotPixels = async(launch::async, []() { ofPixels p; ofLoadImage(p, "images/dot.png"); return p; });
+
 	//(Zijian Li)setup camera
 	cam.setDistance(50);
 	cam.setNearClip(.1);
 	cam.setFov(65.5);
 
+	//landing pads, the built in three if the data file is missing
+	if (sites.load(ofToDataPath("landing_sites.txt")))
+		sim.setSites(&sites);
+
 	trackCam.setGlobalPosition(glm::vec3(20, 20, 20));
-	trackCam.lookAt(startingPosition);
+	trackCam.lookAt(sim.startingPosition);
 	trackCam.setNearClip(.1);
 
-	frontCam.setPosition(startingPosition);
+	frontCam.setPosition(sim.startingPosition);
 	frontCam.lookAt(frontCam.getPosition() + glm::vec3(0, 0, -1));
 	frontCam.setNearClip(.1);
 
-	bottomCam.setPosition(startingPosition);
+	bottomCam.setPosition(sim.startingPosition);
 	bottomCam.lookAt(glm::vec3(0, 0, 0));
 	bottomCam.setNearClip(.01);
 
@@ -29,234 +45,323 @@ void ofApp::setup()
 	ofBackground(ofColor::black);
 	ofDisableArbTex();
 
-	//(Jiaxian guo)
-			//Load the shader
-	if (!ofLoadImage(particleTex, "images/dot.png")) {
-		cout << "Particle Texture File: images/dot.png not found" << endl;
-		ofExit();
-	}
-
-#ifdef TARGET_OPENGLES
-	shader.load("shaders_gles/shader");
-#else
-	shader.load("shaders/shader");
-#endif
-	//Set up landing area
-	landingPositionGreen = glm::vec3(-20, 1,20);
-	landingPositionYellow = glm::vec3(120, 33, -73);
-	landingPositionOrange = glm::vec3(40, -6, -10);
-
 	//(Zijian Li)
 	//setup GUI
 	gui.setup("sliders");
 	gui.add(gravitySlider.setup("Gravity", 2.5, .1, 10));
 	gui.add(magnitude.setup("Magnitude", 5, 1, 200));
 	gui.add(restitution.setup("Restitution", .5, .1, 1));
-
-	//(Jiaxiang Guo)
-	//Creating Octree
-	mars.loadModel("geo/Moon500.obj");
-	mars.setScaleNormalization(false);
-	mars.setRotation(1, 180, 0, 0, 1);
-	tree.create(mars.getMesh(0), numLevels);
-
-	lander.loadModel("geo/lander.obj");
-	lander.setScaleNormalization(false);
-	lander.setScale(1, 1, 1);
-	lander.setRotation(1, 180, 0, 0, 1);
-	bRoverLoaded = true;
+	for (int i = 0; i < NumPerfCounters; i++)
+		gui.add(counterLabels[i].setup(PerfCounters::name((PerfCounter)i), "0"));
 
 	//Particle system
     //(Jiaxiang Guo)
-	Particle p;
-	p.lifespan = -1;
-	p.damping = .9999;
-	p.position = startingPosition;
-
-	gravity = new GravityForce(glm::vec3(0, -1 * gravitySlider, 0));
-
-	landerSystem.add(p);
-	landerSystem.addForce(gravity);
-
 	Emitter.velocity = glm::vec3(0, -15, 0);
 	Emitter.rate = 30;
-	Emitter.sys->addForce(new TurbulenceForce(glm::vec3(-90, -90, -90), glm::vec3(90, 90, 90)));
+	TurbulenceForce *turbulence = new TurbulenceForce(glm::vec3(-90, -90, -90), glm::vec3(90, 90, 90));
+	turbulence->random = &sim.random;
+	Emitter.sys->addForce(turbulence);
+	Emitter.random = &sim.random;
 	Emitter.lifespan = .25;
 	Emitter.particleColor = ofColor::white;
 
-	EmitterPlayer.load("sounds/sound.wav");
-	EmitterPlayer.setLoop(true);
-	bgm.load("sounds/bgm.mp3");
-	bgm.play();
+	lander.setPosition(sim.lander().position.x, sim.lander().position.y, sim.lander().position.z);
+	Emitter.setPosition(sim.lander().position);
 
-	lander.setPosition(landerSystem.particles[0].position.x, landerSystem.particles[0].position.y, landerSystem.particles[0].position.z);
-	Emitter.setPosition(landerSystem.particles[0].position);
+	snapshot.sim = &sim;
+	snapshot.world = &particleWorld;
+	snapshot.emitters.push_back(&Emitter);
+	rewind.setCapacity(10 * 60, 60);
 }
 
-void ofApp::loadVbo()
+//  one loading step per frame, models, shader and sounds need the GL context
+//  (or the sound system) and are loaded here on the main thread; finished
+//  background work is picked up as it completes
+//
+void ofApp::updateLoading()
 {
-	if (Emitter.sys->particles.size() < 1) return;
+	//get the progress screen up before anything blocks
+	if (bFirstFrame) return;
 
-	vector<ofVec3f> sizes;
-	vector<ofVec3f> points;
-	for (int i = 0; i < Emitter.sys->particles.size(); i++)
+	uint64_t t0 = ofGetElapsedTimeMillis();
+	string step;
+	switch (loadStep)
 	{
-		points.push_back(Emitter.sys->particles[i].position);
-		sizes.push_back(ofVec3f(20));
+	case 0:
+		//(Jiaxiang Guo)
+		//terrain model, the octree is built from it in the background
+		step = "terrain model";
+		if (!terrain.openObj(ofToDataPath("geo/Moon500.obj")))
+		{
+			cout << "Terrain File: geo/Moon500.obj not found" << endl;
+			ofExit();
+			return;
+		}
+		terrainVbo.setVertexData(terrain.view.vertices, terrain.view.numVertices, GL_STATIC_DRAW);
+		if (terrain.view.normals)
+			terrainVbo.setNormalData(terrain.view.normals, terrain.view.numVertices, GL_STATIC_DRAW);
+		terrainVbo.setIndexData((const ofIndexType*)terrain.view.indices, terrain.view.numIndices, GL_STATIC_DRAW);
+		startTreeBuild();
+		loadMessage = "Building terrain collision";
+		break;
+	case 1:
+		step = "lander model";
+		lander.loadModel("geo/lander.obj");
+		lander.setScaleNormalization(false);
+		lander.setScale(1, 1, 1);
+		lander.setRotation(1, 180, 0, 0, 1);
+		bRoverLoaded = true;
+		break;
+	case 2:
+		//(Jiaxian guo)
+		//Load the shader
+		step = "shader";
+#ifdef TARGET_OPENGLES
+		shader.load("shaders_gles/shader");
+#else
+		shader.load("shaders/shader");
+#endif
+		break;
+	case 3:
+		step = "sounds";
+		EmitterPlayer.load("sounds/sound.wav");
+		EmitterPlayer.setLoop(true);
+		bgm.load("sounds/bgm.mp3");
+		bgm.play();
+		break;
 	}
-	
-	int total = (int)points.size();
-	vbo.clear();
-	vbo.setVertexData(&points[0], total, GL_STATIC_DRAW);
-	vbo.setNormalData(&sizes[0], total, GL_STATIC_DRAW);
+	if (!step.empty())
+	{
+		cout << "loaded " << step << " in " << ofGetElapsedTimeMillis() - t0 << " ms" << endl;
+		loadStep++;
+		loadDone++;
+	}
+
+	if (bgPixels.valid() && bgPixels.wait_for(chrono::seconds(0)) == future_status::ready)
+	{
+		bg.setFromPixels(bgPixels.get());
+		loadDone++;
+	}
+	if (dotPixels.valid() && dotPixels.wait_for(chrono::seconds(0)) == future_status::ready)
+	{
+		ofPixels pixels = dotPixels.get();
+		if (!pixels.isAllocated()) {
+			cout << "Particle Texture File: images/dot.png not found" << endl;
+			ofExit();
+		}
+		particleTex.loadData(pixels);
+		loadDone++;
+	}
+
+	//the game can start once everything it draws and collides with is in,
+	//the sounds may still be loading
+	if (!bPlayable && loadStep >= 3 && tree && !dotPixels.valid() && !bgPixels.valid())
+	{
+		bPlayable = true;
+		loadMessage = "";
+		cout << "playable after " << ofGetElapsedTimeMillis() << " ms" << endl;
+	}
+}
+
+void ofApp::drawLoading()
+{
+	float w = ofGetWindowWidth() / 2;
+	float x = ofGetWindowWidth() / 4;
+	float y = ofGetHeight() / 2;
+
+	ofSetColor(ofColor::white);
+	ofDrawBitmapString(loadMessage.empty() ? "Loading" : loadMessage, x, y - 10);
+	ofNoFill();
+	ofDrawRectangle(x, y, w, 12);
+	ofFill();
+	ofDrawRectangle(x, y, w * min(loadDone, numLoadItems) / numLoadItems, 12);
+}
+
+//  build a new octree over the mapped terrain on a background thread, the
+//  current one stays in use until update() swaps the new one in
+//
+void ofApp::startTreeBuild()
+{
+	if (treeBuild.valid()) return;
+	MeshView view = terrain.view;
+	int levels = numLevels;
+	treeBuild = async(launch::async, [view, levels]() {
+		unique_ptr<Octree> t(new Octree());
+		t->create(view, levels);
+		return t;
+	});
+}
+
+void ofApp::loadVbo()
+{
+	PROFILE_SCOPE("ofApp::loadVbo");
+
+	//positions of every emitter's particles, gathered by the world's update
+	int total = particleWorld.size();
+	if (total < 1) return;
+
+	//point sizes from the frame arena; the vbo keeps its buffers and only
+	//uploads new data
+	const vector<glm::vec3> & points = particleWorld.positions;
+	ArenaVector<ofVec3f> sizes(total, ofVec3f(20), Arena::frame());
+	vbo.setVertexData(&points[0], total, GL_DYNAMIC_DRAW);
+	vbo.setNormalData(&sizes[0], total, GL_DYNAMIC_DRAW);
+	PerfCounters::add(CounterVboBytes, total * (sizeof(points[0]) + sizeof(sizes[0])));
 }
 
 //--------------------------------------------------------------
 void ofApp::update()
 {
-	if (bStarted && !bEnded)
+	PROFILE_SCOPE("ofApp::update");
+
+	//counters from the last complete frame
+	if (bShowGui)
+	{
+		for (int i = 0; i < NumPerfCounters; i++)
+			counterLabels[i] = ofToString(PerfCounters::lastFrame((PerfCounter)i));
+	}
+
+	//swap in a finished octree between simulation steps
+	//(the old tree is freed on a background thread)
+	if (treeBuild.valid() && treeBuild.wait_for(chrono::seconds(0)) == future_status::ready)
 	{
-		//(Zijian Li)gravity
-		gravity->set(glm::vec3(glm::vec3(0, -1 * gravitySlider, 0)));
-
-		//(Zijian Li)add forces control
-		if (bSpacePressed)
-			landerSystem.addForce(new ImpulseForce(magnitude, glm::vec3(0, 5, 0)));
-		if (bUpPressed)
-			landerSystem.addForce(new ImpulseForce(magnitude, glm::vec3(0, 0, -1)));
-		if (bLeftPressed)
-			landerSystem.addForce(new ImpulseForce(magnitude, glm::vec3(-1, 0, 0)));
-		if (bDownPressed)
-			landerSystem.addForce(new ImpulseForce(magnitude, glm::vec3(0, 0, 1)));
-		if (bRightPressed)
-			landerSystem.addForce(new ImpulseForce(magnitude, glm::vec3(1, 0, 0)));
-
-		//(Zijian Li)
-//get the location the lander particle would be at if updated
-		Particle p = landerSystem.particles[0];
-		landerSystem.test(&p);
-
-		//(Zijian Li)
-//check if any of the lander's feet hit the landing area
-		glm::vec3 collDist = glm::vec3(10000, 10000, 10000);
-
-		if (tree.intersect(p.position + glm::vec3(2.8, 0, 0), tree.root, &collDist) ||
-			tree.intersect(p.position + glm::vec3(2.8, 0, 0), tree.root, &collDist) ||
-			tree.intersect(p.position + glm::vec3(0, 0, 2.8), tree.root, &collDist) ||
-			tree.intersect(p.position + glm::vec3(0, 0, 2.8), tree.root, &collDist))
+		unique_ptr<Octree> old = move(tree);
+		tree = treeBuild.get();
+		sim.setTerrain(tree.get());
+		treeBuilder.release(move(old));
+		if (!bPlayable) loadDone++;
+	}
+	if (treeBuilder.active() && treeBuilder.step(buildBudgetMicros))
+	{
+		treeBuilder.swap(tree);
+		sim.setTerrain(tree.get());
+		cout << "Octree rebuilt over " << treeBuilder.calls << " frames, longest slice "
+			<< treeBuilder.longestCallMicros << " us" << endl;
+	}
+
+	if (loadStep < numLoadSteps || !bPlayable) updateLoading();
+	if (!bPlayable) return;
+
+	if (bStarted && !sim.bEnded)
+	{
+		//run as many fixed steps as the frame time covers
+		simAccumulator += ofGetLastFrameTime();
+		int steps = 0;
+		bool moved = false;
+		while (simAccumulator >= simDt && steps < maxStepsPerFrame && !sim.bEnded && !(replay.active && replay.done()))
 		{
-			if (glm::length(landerSystem.particles[0].velocity) > 15)
+			LanderInput input;
+			if (replay.active)
 			{
-				bEnded = true;
-				message = "Your ship is broken. Be careful!";
-				score = 0;
+				replay.next(input, sim);
 			}
 			else
 			{
-				//if any are, check if they are inside the landing area
-				int feetCount = 0;
-				if (glm::length(p.position + glm::vec3(2.8, -1, 0) - landingPositionGreen) < Radius)
-					feetCount++;
-				if (glm::length(p.position + glm::vec3(-2.8, -1, 0) - landingPositionGreen) < Radius)
-					feetCount++;
-				if (glm::length(p.position + glm::vec3(0, -1, 2.8) - landingPositionGreen) < Radius)
-					feetCount++;
-				if (glm::length(p.position + glm::vec3(0, -1, -2.8) - landingPositionGreen) < Radius)
-					feetCount++;
-				if (glm::length(p.position + glm::vec3(2.8, -1, 0) - landingPositionYellow) < Radius)
-					feetCount++;
-				if (glm::length(p.position + glm::vec3(-2.8, -1, 0) - landingPositionYellow) < Radius)
-					feetCount++;
-				if (glm::length(p.position + glm::vec3(0, -1, 2.8) - landingPositionYellow) < Radius)
-					feetCount++;
-				if (glm::length(p.position + glm::vec3(0, -1, -2.8) - landingPositionYellow) < Radius)
-					feetCount++;
-				if (glm::length(p.position + glm::vec3(2.8, -1, 0) - landingPositionOrange) < Radius)
-					feetCount++;
-				if (glm::length(p.position + glm::vec3(-2.8, -1, 0) - landingPositionOrange) < Radius)
-					feetCount++;
-				if (glm::length(p.position + glm::vec3(0, -1, 2.8) - landingPositionOrange) < Radius)
-					feetCount++;
-				if (glm::length(p.position + glm::vec3(0, 0, -2.8) - landingPositionOrange) < Radius)
-					feetCount++;
-
-				//(Zijian Li)
-//Getting points with feets landing 
-				if (feetCount > 0)
-				{
-					score += feetCount;
-					switch (feetCount)
-					{
-					case 1:
-						bEnded = true;
-						message = "Emm, try harder!";
-						break;
-					case 2:
-						bEnded = true;
-						message = "Not bad!";
-						break;
-					case 3:
-						bEnded = true;
-						message = "Almost Pecfect, Keep Working!";
-						break;
-					case 4:
-						bEnded = true;
-						message = "Perfect Landing!";
-						break;
-					}
-				}
-				else
-				{
-					//(Zijian Li)
-//if none of the feet are in the landing zone, either bounce the lander or end the game
-
-					glm::vec3 n = glm::normalize(collDist);
-					glm::vec3 impulse = (restitution) * (glm::dot(-1 * landerSystem.particles[0].velocity, n)) * n;
-
-					landerSystem.particles[0].velocity = impulse;
-				}
+				//(Zijian Li)copy the sliders and the keys into the simulation
+				sim.gravity = gravitySlider;
+				sim.magnitude = magnitude;
+				sim.restitution = restitution;
+
+				input.thrust = bSpacePressed;
+				input.forward = bUpPressed;
+				input.left = bLeftPressed;
+				input.back = bDownPressed;
+				input.right = bRightPressed;
+				recorder.record(input, sim);
 			}
+
+			if (sim.step(input, simDt)) moved = true;
+			snapshot.save(tickState);
+			rewind.push(tickState);
+			simAccumulator -= simDt;
+			steps++;
 		}
-		else
+		//too far behind (slow frame or a stall), drop the backlog
+		if (steps == maxStepsPerFrame) simAccumulator = 0;
+		if (sim.bEnded) recorder.stop(sim);
+
+		if (replay.active && (replay.done() || sim.bEnded))
+		{
+			replay.active = false;
+			replay.check(sim);
+			if (!sim.bEnded)
+			{
+				sim.bEnded = true;
+				sim.message = "Replay finished";
+			}
+		}
+
+		//(Jiaxiang Guo)
+//update the emitter and move everything to the lander particle
+		if (moved)
 		{
-			//(Jiaxiang Guo)
-//update the particle position and the emitter
-			landerSystem.update();
 			Emitter.update();
+			particleWorld.update();
+		}
 
-			//(Jiaxiang Guo)
-//setup the lander position to the particle postition
-			lander.setPosition(landerSystem.particles[0].position.x, landerSystem.particles[0].position.y, landerSystem.particles[0].position.z);
+		glm::vec3 position = sim.lander().position;
+		lander.setPosition(position.x, position.y, position.z);
+		Emitter.setPosition(position);
 
-			TreeNode node;
-			node.box = Box(glm::vec3(-1000, -1000, -1000), glm::vec3(-1000, -1000, -1000));
-			if (tree.intersect(lander.getPosition(), glm::vec3(0, -1, 0), tree.root, &node))
-				dist = glm::length(glm::vec3(lander.getPosition().x, lander.getPosition().y, lander.getPosition().z) - node.box.center());
-			else
-				dist = 99999;
-			Emitter.setPosition(landerSystem.particles[0].position);
+		trackCam.lookAt(position);
+		frontCam.setPosition(position);
+		bottomCam.setPosition(position);
 
-			trackCam.lookAt(landerSystem.particles[0].position);
-			frontCam.setPosition(landerSystem.particles[0].position);
-			bottomCam.setPosition(landerSystem.particles[0].position);
-		}
+		if (bRadar && tree) updateRadar();
+	}
+}
+
+//--------------------------------------------------------------
+//  a cone of rays straight down from the lander, traced in packets; the
+//  hits are drawn as points with the terrain's rotation and the nearest
+//  one shows in the HUD
+//
+void ofApp::updateRadar()
+{
+	PROFILE_SCOPE("ofApp::updateRadar");
+
+	if (radarDirs.empty())
+		RayPackets::cone(glm::vec3(0, -1, 0), radarHalfAngle, radarRows, radarCols, radarDirs);
+	radarHits.resize(radarDirs.size());
+	RayPackets::trace(*tree, sim.lander().position, &radarDirs[0], (int)radarDirs.size(), &radarHits[0]);
+
+	radarPoints.clear();
+	radarPoints.setMode(OF_PRIMITIVE_POINTS);
+	radarNearest = -1;
+	for (int i = 0; i < radarHits.size(); i++)
+	{
+		if (!radarHits[i].hit()) continue;
+		radarPoints.addVertex(radarHits[i].position);
+		if (radarNearest < 0 || radarHits[i].t < radarNearest) radarNearest = radarHits[i].t;
 	}
 }
 
 //--------------------------------------------------------------
 void ofApp::draw()
 {
+	PROFILE_SCOPE("ofApp::draw");
+
+	if (bFirstFrame)
+	{
+		bFirstFrame = false;
+		cout << "first frame after " << ofGetElapsedTimeMillis() << " ms" << endl;
+	}
+
 	//(Jiaxiang Guo)
-	if (!bStarted)
+	if (!bPlayable)
+	{
+		drawLoading();
+	}
+	else if (!bStarted)
 	{
 		bg.draw(0, 100);
 		ofDrawBitmapString("Arrow key to move, Good luck", ofGetWindowWidth() / 2 , ofGetHeight() / 2 );
 	
 	}
-	else if (bEnded)
+	else if (sim.bEnded)
 	{
 		ofSetColor(ofColor::red);
-		ofDrawBitmapString(message, ofGetWindowWidth() / 2 - ((message.length() * 8) / 2), ofGetHeight() / 2);
+		ofDrawBitmapString(sim.message, ofGetWindowWidth() / 2 - ((sim.message.length() * 8) / 2), ofGetHeight() / 2);
 		ofDrawBitmapString("Press r to reset", ofGetWindowWidth() / 2 - 72, ofGetHeight() / 2 + 11);
 	}
 	else
@@ -269,13 +374,23 @@ void ofApp::draw()
 		theCam->begin();
 		ofPushMatrix();
 
-		mars.drawFaces();
-		ofSetColor(ofColor(300, 250, 300, 200));
-		ofDrawCylinder(landingPositionGreen, Radius, 0.75);
-		ofSetColor(ofColor(150, 200, 100, 200));
-		ofDrawCylinder(landingPositionYellow, Radius, 0.75);
-		ofSetColor(ofColor(200, 100, 50, 200));
-		ofDrawCylinder(landingPositionOrange, Radius, 0.75);
+		//the terrain model has always been drawn turned 180 degrees about z,
+		//the radar hits are in the octree's frame and turn with it
+		ofPushMatrix();
+		ofRotateDeg(180, 0, 0, 1);
+		terrainVbo.drawElements(GL_TRIANGLES, terrain.view.numIndices);
+		if (bRadar)
+		{
+			ofSetColor(ofColor::green);
+			radarPoints.draw();
+		}
+		ofPopMatrix();
+		for (int i = 0; i < sim.sites->numPads(); i++)
+		{
+			const LandingPad & pad = sim.sites->pads[i];
+			ofSetColor(pad.color);
+			ofDrawCylinder(pad.position, pad.radius, 0.75);
+		}
 
 		if (bRoverLoaded)
 		{
@@ -283,14 +398,18 @@ void ofApp::draw()
 			if (!bTerrainSelected) drawAxis(lander.getPosition());
 		}
 		if (bTerrainSelected) drawAxis(ofVec3f(0, 0, 0));
-
-		if (bDrawTree)
+		if (pick.hit())
+		{
+			ofSetColor(ofColor::yellow);
+			ofDrawSphere(pick.position, 0.5);
+		}
+		if (bDrawTree && tree)
 		{
 			ofColor current = ofGetGLRenderer()->getStyle().color;
 			bool fill = ofGetFill();
 			ofNoFill();
 			ofSetColor(ofColor::blue);
-			tree.drawLeafNodes(tree.root);
+			tree->drawLeafNodes(tree->root);
 			if (fill)
 				ofFill();
 			ofSetColor(current);
@@ -308,7 +427,7 @@ void ofApp::draw()
 
 		// draw particle emitter
 		particleTex.bind();
-		vbo.draw(GL_POINTS, 0, (int)Emitter.sys->particles.size());
+		vbo.draw(GL_POINTS, 0, particleWorld.size());
 		particleTex.unbind();
 
 		//  stop the camera
@@ -326,14 +445,30 @@ void ofApp::draw()
 		ofDisableLighting();
 
 		string str;
-		str += "Height: " + std::to_string(dist);
+		str += "Height: " + std::to_string(sim.dist);
 		ofSetColor(ofColor::white);
 		ofDrawBitmapString(str, ofGetWindowWidth() - 170, 15);
-		str = "Point: " + std::to_string(score);
+		str = "Point: " + std::to_string(sim.score);
 		ofDrawBitmapString(str, ofGetWindowWidth() - 170, 30);
+		if (bRadar)
+		{
+			str = radarNearest < 0 ? "Radar: no ground" : "Radar: " + std::to_string(radarNearest);
+			ofDrawBitmapString(str, ofGetWindowWidth() - 170, 45);
+		}
 
 
 	}
+
+	if (bShowGui)
+	{
+		ofDisableDepthTest();
+		ofDisableLighting();
+		gui.draw();
+	}
+
+	Profiler::frameMark();
+	PerfCounters::endFrame();
+	Arena::frame().reset();
 }
 
 //--------------------------------------------------------------
@@ -343,7 +478,7 @@ void ofApp::keyPressed(int key)
 	switch (key)
 	{
 	case ' ':
-		if (!bStarted)
+		if (!bStarted && bPlayable)
 			bStarted = true;
 		bSpacePressed = true;
 		Emitter.started = true;
@@ -364,9 +499,7 @@ void ofApp::keyPressed(int key)
 		break;
 	case 'R':
 	case 'r':
-		bEnded = true;
-		if (bEnded)
-			restart();
+		if (bPlayable) restart();
 		break;
 	case OF_KEY_F1:
 		theCam = &cam;
@@ -380,6 +513,40 @@ void ofApp::keyPressed(int key)
 	case OF_KEY_F4:
 		theCam = &bottomCam;
 		break;
+	case OF_KEY_F5:
+		//start recording from a fresh run, or stop the current recording
+		if (!bPlayable)
+			break;
+		if (recorder.recording())
+			recorder.stop(sim);
+		else
+		{
+			restart();
+			recorder.start(ofToDataPath(recordingPath), sim, simDt, numLevels, *tree);
+		}
+		break;
+	case OF_KEY_BACKSPACE:
+		//rewind, not while recording or replaying (the recording would
+		//no longer match the run)
+		if (bPlayable && bStarted && !recorder.recording() && !replay.active)
+		{
+			int back = min((int)(rewindSeconds / simDt), rewind.available());
+			if (back > 0 && rewind.get(back, tickState) && snapshot.restore(tickState))
+			{
+				rewind.dropNewest(back);
+				simAccumulator = 0;
+			}
+		}
+		break;
+	case OF_KEY_F6:
+		//replay the last recording at normal speed
+		if (bPlayable && replay.load(ofToDataPath(recordingPath)))
+		{
+			restart();
+			replay.begin(sim);
+			replay.active = true;
+		}
+		break;
 	}
 }
 
@@ -409,9 +576,25 @@ void ofApp::keyReleased(int key)
 	case '`':
 		bShowGui = !bShowGui;
 		break;
+	case 'g':
+	case 'G':
+		bRadar = !bRadar;
+		break;
 	case 'b':
 	case'B':
-		tree.create(mars.getMesh(0), numLevels);
+		//rebuild a slice per frame, the old tree is used until it's done
+		if (bPlayable && !treeBuilder.active()) treeBuilder.start(terrain.view, numLevels);
+		break;
+	case 'p':
+	case 'P':
+		Profiler::beginCapture(profileFrames, ofToDataPath("profile_" + ofGetTimestampString() + ".json"));
+		break;
+	case 'c':
+	case 'C':
+		if (PerfCounters::writingCsv())
+			PerfCounters::stopCsv();
+		else
+			PerfCounters::startCsv(ofToDataPath("counters_" + ofGetTimestampString() + ".csv"));
 		break;
 	default:
 		break;
@@ -444,6 +627,20 @@ void ofApp::mouseReleased(int x, int y, int button)
 	{
 		bDragging = false;
 		glm::vec3 dir = glm::normalize(cam.screenToWorld(glm::vec3(ofGetMouseX(), ofGetMouseY(), 0)) - cam.getPosition());
+
+		//the terrain is drawn turned 180 degrees about z from the octree,
+		//turn the ray into the octree's frame and the hit back out
+		if (tree)
+		{
+			glm::vec3 flip(-1, -1, 1);
+			pick = RayPackets::trace(*tree, cam.getPosition() * flip, dir * flip);
+			if (pick.hit())
+			{
+				pick.position = pick.position * flip;
+				cout << "picked terrain vertex " << pick.vertex << " at " << pick.position.x << ", "
+					<< pick.position.y << ", " << pick.position.z << endl;
+			}
+		}
 	}
 }
 
@@ -535,10 +732,14 @@ void ofApp::initLightingAndMaterials() {
 void ofApp::restart()
 {
 	//(Jiaxiang Guo)
-	landerSystem.particles[0].position = startingPosition;
-	landerSystem.particles[0].velocity = glm::vec3(0, 0, 0);
-	landerSystem.particles[0].forces = glm::vec3(0, 0, 0);
+	//a restart ends any recording or replay in progress
+	recorder.stop(sim);
+	replay.active = false;
 
+	sim.reset();
+	simAccumulator = 0;
+	particleWorld.clear();
+	rewind.clear();
 
 	theCam = &cam;
 
@@ -548,8 +749,5 @@ void ofApp::restart()
 	bLeftPressed = false;
 	bRightPressed = false;
 
-	string message = "";
-
 	bStarted = true;
-	bEnded = false;
 }
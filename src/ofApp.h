@@ -4,7 +4,14 @@
 #include "ofxGui.h"
 #include "ofxAssimpModelLoader.h"
 #include "Octree.h"
+#include "OctreeBuilder.h"
 #include "ParticleEmitter.h"
+#include "LanderSim.h"
+#include "PerfCounters.h"
+#include "InputRecorder.h"
+#include "SimSnapshot.h"
+#include "RayPackets.h"
+#include <future>
 
 
 class ofApp : public ofBaseApp{
@@ -30,6 +37,10 @@ class ofApp : public ofBaseApp{
 		void drawAxis(glm::vec3 location);
 		void initLightingAndMaterials();
 		void restart();
+		void updateLoading();
+		void drawLoading();
+		void startTreeBuild();
+		void updateRadar();
 
 		//cameras
 		ofEasyCam cam;
@@ -38,18 +49,55 @@ class ofApp : public ofBaseApp{
 		ofCamera bottomCam;
 		ofCamera* theCam = &cam;
 
-		ofxAssimpModelLoader mars, lander;
+		ofxAssimpModelLoader lander;
 		ofLight light;
-		Octree tree;
 
-		//lander Particle System stuff
-		glm::vec3 startingPosition = glm::vec3(0, 20, 0);
-		ParticleSystem landerSystem;
+		//terrain, mapped from the binary mesh cache (made from the OBJ on
+		//the first run) and drawn from a VBO
+		MeshCache terrain;
+		ofVbo terrainVbo;
+
+		//terrain collision, replaced as a whole when a background build
+		//finishes so the simulation never sees a half built tree
+		unique_ptr<Octree> tree;
+		future<unique_ptr<Octree> > treeBuild;
+
+		//rebuilds on the main thread, a slice of at most buildBudgetMicros
+		//per frame
+		OctreeBuilder treeBuilder;
+		int buildBudgetMicros = 2000;
+
+		//lander simulation (physics, collision and scoring), stepped at a
+		//fixed rate so recorded input replays exactly
+		LanderSim sim;
+		LandingSites sites;
+		float simDt = 1.0 / 60;
+		float simAccumulator = 0;
+		int maxStepsPerFrame = 8;
+
+		//input recording (F5) and replay (F6)
+		InputRecorder recorder;
+		InputReplay replay;
+		string recordingPath = "input.rec";
+
+		//every tick's state, backspace rewinds rewindSeconds
+		SimSnapshot snapshot;
+		RewindBuffer rewind;
+		vector<uint8_t> tickState;
+		float rewindSeconds = 3;
+
+		//terrain picked by the last click, and the radar sweep below the
+		//lander (g toggles it), both traced with RayPackets
+		RayHit pick;
+		bool bRadar = false;
+		int radarRows = 32;
+		int radarCols = 32;
+		float radarHalfAngle = 35;
+		vector<glm::vec3> radarDirs;
+		vector<RayHit> radarHits;
+		ofMesh radarPoints;
+		float radarNearest = -1;
 
-		GravityForce* gravity;
-
-		float dist = 0;
-		int score = 0;
 		//bgI
 		ofImage bg;
 
@@ -58,9 +106,13 @@ class ofApp : public ofBaseApp{
 		ofxFloatSlider gravitySlider;
 		ofxFloatSlider magnitude;
 		ofxFloatSlider restitution;
+		ofxLabel counterLabels[NumPerfCounters];
 		
 		//shader
-		ParticleEmitter Emitter;
+		//every emitter's particles live in one world, updated and
+		//uploaded together once a frame
+		ParticleWorld particleWorld;
+		ParticleEmitter Emitter{ &particleWorld };
 		ofSoundPlayer EmitterPlayer;
 		ofSoundPlayer bgm;
 
@@ -68,19 +120,24 @@ class ofApp : public ofBaseApp{
 		ofVbo vbo;
 		ofShader shader;
 
-		//landing area
-		glm::vec3 landingPositionGreen;
-		glm::vec3 landingPositionYellow;
-		glm::vec3 landingPositionOrange;
-		float Radius = 6;
-
-
 #if _DEBUG
 		int numLevels = 8;
 #else
 		int numLevels = 13;
 #endif
 
+		//startup loading, one main thread step per frame behind a progress
+		//screen while images decode and the octree builds in the background
+		future<ofPixels> bgPixels, dotPixels;
+		int loadStep = 0;
+		int loadDone = 0;
+		string loadMessage;
+		bool bFirstFrame = true;
+		bool bPlayable = false;
+
+		//frames written to disk by the profiler hotkey ('p')
+		int profileFrames = 120;
+
 		//booleans to track state of game
 		bool bSpacePressed = false;
 		bool bUpPressed = false;
@@ -89,12 +146,9 @@ class ofApp : public ofBaseApp{
 		bool bRightPressed = false;
 
 		bool bStarted = false;
-		bool bEnded = false;
 		bool bDragging = false;
 		bool bRoverLoaded = false;
 		bool bTerrainSelected = false;
 		bool bDrawTree = false;
 		bool bShowGui = false;
-		
-		string message = "";
 };
@@ -0,0 +1,9 @@
+#include "HeadlessTools.h"
+
+//  landertools: the app's headless modes without the app, see CMakeLists.txt
+//
+int main(int argc, char *argv[])
+{
+	vector<string> args(argv + 1, argv + argc);
+	return HeadlessTools::main(args);
+}